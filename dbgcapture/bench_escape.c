@@ -0,0 +1,158 @@
+/*
+ * bench_escape.c - Micro-benchmark for JsonEscape
+ *
+ * Compares the vectorized JsonEscape fast path against the scalar reference
+ * loop on a corpus of realistic debug output lines, after checking that both
+ * produce byte-identical output.
+ *
+ * Usage: bench_escape.exe [iterations]
+ */
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "jsonescape.h"
+
+#define OUTPUT_SIZE (4096 * 2)
+#define DEFAULT_ITERATIONS 200000
+
+// Mix modeled on real OutputDebugString traffic: mostly plain ASCII, some
+// quotes, Windows paths and line endings, and the occasional long line
+static const char* g_Lines[] = {
+    "[APP:Main] Starting application v1.0.0",
+    "[HTTP:Request] GET /api/users/123 HTTP/1.1 @12:34:56.789",
+    "[HTTP:Response] 200 OK (45ms)\r\n",
+    "[DB:Query] INSERT INTO logs (msg) VALUES ('test') duration=0.42ms rows=1",
+    "[PERF] Frame time: 16.7ms (60 FPS) gpu=8.1ms cpu=6.2ms present=0.4ms",
+    "[SECURITY] Authentication successful for user \"admin\"",
+    "[CACHE] Loaded C:\\ProgramData\\MyApp\\cache\\index.bin (2048 entries)",
+    "D3D11 WARNING: ID3D11DeviceContext::DrawIndexed: The Pixel Shader unit expects a Sampler to be set at Slot 0 [ EXECUTION WARNING #352: DEVICE_DRAW_SAMPLER_NOT_SET]\n",
+    "onecoreuap\\shell\\windows\\moderncore\\inputhost\\lib\\inputhostmanager.cpp(1093)\\InputHost.dll!00007FFB2A1C22C4: (caller: 00007FFB2A1C1F0A) ReturnHr(1) tid(3a4c) 80070490 Element not found.\r\n",
+    "ThreadPool worker 7 idle",
+    "[ERROR] NullReferenceException in ProcessData()\tat MyApp.Worker.Run() in C:\\src\\Worker.cs:line 212",
+    "[TRACE] entering ComputeLayout width=1920 height=1080 dpi=144 scale=1.5 flags=0x0000001f",
+};
+
+#define LINE_COUNT (sizeof(g_Lines) / sizeof(g_Lines[0]))
+
+typedef size_t (*ESCAPE_FN)(const char*, size_t, char*, size_t);
+
+static double NowSeconds(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static double Run(ESCAPE_FN escape, const size_t* lengths, long iterations, size_t* checksum) {
+    static char output[OUTPUT_SIZE];
+    size_t total = 0;
+    double start = NowSeconds();
+
+    for (long n = 0; n < iterations; n++) {
+        for (size_t k = 0; k < LINE_COUNT; k++) {
+            total += escape(g_Lines[k], lengths[k], output, sizeof(output));
+        }
+    }
+
+    *checksum = total;
+    return NowSeconds() - start;
+}
+
+static int Verify(void) {
+    static char expected[OUTPUT_SIZE];
+    static char actual[OUTPUT_SIZE];
+    static char input[4096];
+    size_t sizes[] = { OUTPUT_SIZE, 64, 33, 20, 19, 18, 5, 3 };
+
+    // Every byte value at every offset, across output limits near the
+    // SIMD/scalar handoff points
+    for (int c = 1; c < 256; c++) {
+        for (size_t len = 1; len < 80; len++) {
+            memset(input, 'a', len);
+            input[len / 2] = (char)c;
+            input[len - 1] = (char)((c * 7) & 0xFF ? (c * 7) & 0xFF : 'z');
+            for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+                size_t n1 = JsonEscapeScalar(input, len, expected, sizes[s]);
+                size_t n2 = JsonEscape(input, len, actual, sizes[s]);
+                if (n1 != n2 || memcmp(expected, actual, n1 + 1) != 0) {
+                    printf("MISMATCH: byte 0x%02x len %zu output size %zu\n", c, len, sizes[s]);
+                    return 0;
+                }
+            }
+        }
+    }
+
+    // Runs of escapes near a small output limit, where the SIMD loop hands
+    // the scalar tail only a few bytes of room. Bytes past the limit must
+    // stay untouched.
+    for (int pattern = 0; pattern < 4; pattern++) {
+        for (size_t len = 1; len < 160; len++) {
+            for (size_t k = 0; k < len; k++) {
+                static const char mix[] = { 'a', '\x01', '"', '\n', 'b', '\x1f', '\\', 'c' };
+                input[k] = pattern == 0 ? '\x01' : mix[(k * (pattern + 1)) % sizeof(mix)];
+            }
+            for (size_t size = 1; size < 64; size++) {
+                memset(expected, '#', size + 16);
+                memset(actual, '#', size + 16);
+                size_t n1 = JsonEscapeScalar(input, len, expected, size);
+                size_t n2 = JsonEscape(input, len, actual, size);
+                if (n1 != n2 || n1 >= size || memcmp(expected, actual, size + 16) != 0
+                        || expected[size] != '#' || actual[size] != '#') {
+                    printf("MISMATCH: pattern %d len %zu output size %zu\n", pattern, len, size);
+                    return 0;
+                }
+            }
+        }
+    }
+
+    // Embedded NUL ends the string in both implementations
+    memcpy(input, "0123456789abcdef0123456789abcdef\0tail", 37);
+    if (JsonEscape(input, 37, actual, OUTPUT_SIZE) != 32) {
+        printf("MISMATCH: embedded NUL\n");
+        return 0;
+    }
+    return 1;
+}
+
+int main(int argc, char* argv[]) {
+    long iterations = argc > 1 ? atol(argv[1]) : DEFAULT_ITERATIONS;
+    size_t lengths[LINE_COUNT];
+    size_t inputBytes = 0;
+    size_t scalarSum, fastSum;
+    double scalarTime, fastTime;
+
+    for (size_t k = 0; k < LINE_COUNT; k++) {
+        lengths[k] = strlen(g_Lines[k]);
+        inputBytes += lengths[k];
+    }
+
+    if (!Verify()) {
+        return 1;
+    }
+
+    // Warm up caches and branch predictors
+    Run(JsonEscapeScalar, lengths, iterations / 10 + 1, &scalarSum);
+    Run(JsonEscape, lengths, iterations / 10 + 1, &fastSum);
+
+    scalarTime = Run(JsonEscapeScalar, lengths, iterations, &scalarSum);
+    fastTime = Run(JsonEscape, lengths, iterations, &fastSum);
+
+    if (scalarSum != fastSum) {
+        printf("MISMATCH: output length checksum\n");
+        return 1;
+    }
+
+    printf("lines: %zu x %ld iterations, %.1f MB input\n",
+           LINE_COUNT, iterations, (double)inputBytes * iterations / 1e6);
+    printf("scalar: %8.3f s  %8.1f MB/s  %6.1f ns/line\n",
+           scalarTime, (double)inputBytes * iterations / scalarTime / 1e6,
+           scalarTime * 1e9 / ((double)LINE_COUNT * iterations));
+    printf("simd:   %8.3f s  %8.1f MB/s  %6.1f ns/line\n",
+           fastTime, (double)inputBytes * iterations / fastTime / 1e6,
+           fastTime * 1e9 / ((double)LINE_COUNT * iterations));
+    printf("speedup: %.2fx\n", scalarTime / fastTime);
+    return 0;
+}
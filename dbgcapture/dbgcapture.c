@@ -4,9 +4,45 @@
  * Captures OutputDebugString output and writes JSON lines to stdout.
  * Based on DebugView by Mark Russinovich.
  * 
- * Usage: dbgcapture.exe [--global]
- *   --global: Capture from all sessions (requires admin)
- *   Default: Capture from current session only
+ * Usage: dbgcapture.exe [--global] [--local] [--async] [--ring-slots N]
+ *                       [--flush-ms N] [--flush-bytes N] [--binary] [--etw]
+ *                       [--control] [--names] [--mono]
+ *                       [--overflow block|drop-oldest|drop-newest] [--stats-ms N]
+ *                       [--collapse-ms N] [--serve NAME]
+ *   --global: Capture from the Global\ objects, i.e. session 0 services and
+ *             all sessions (requires admin)
+ *   --local: Capture from the current session's objects; with --global,
+ *            both channels are served by one thread with one sequence
+ *   --async: Hand messages to a writer thread through a lock-free ring so
+ *            DBWIN_BUFFER is released before any stdout I/O happens
+ *   --ring-slots: Number of ring slots in async mode (power of two)
+ *   --overflow: What async mode does when the ring is full: wait for the
+ *               writer thread (block, the default, which stalls every
+ *               OutputDebugString caller), overwrite the oldest queued
+ *               message, or discard the new one
+ *   --stats-ms: Interval of {"stats": ...} records on stderr with loss
+ *               counters and throughput/latency timings (default 1000,
+ *               0 = off, which also skips the timing calls)
+ *   --flush-ms: Longest time a formatted record may wait in the output buffer
+ *   --flush-bytes: Output buffer size that triggers an immediate flush
+ *   --binary: Write length-prefixed binary frames instead of JSON lines
+ *   --etw: Also capture kernel DbgPrint output through a real-time ETW
+ *          session (requires admin, implies --async)
+ *   --control: Read filter commands from stdin (see filter.h) and drop
+ *              records no session wants before they are formatted
+ *   --names: Include the writer's process image name in every record
+ *   --mono: Include a monotonic timestamp (100 ns units since startup, from
+ *           QueryPerformanceCounter) in every record, for ordering bursts
+ *           and measuring latency independent of wall clock adjustments
+ *   --collapse-ms: Hold back messages identical to the previous one from
+ *                  the same process and write each run of them as one
+ *                  record with a repeat count, at most N ms after its
+ *                  first held-back copy (0 = off, the default)
+ *   --serve: Write output to every reader of the named pipe \\.\pipe\NAME
+ *            instead of stdout, so several servers share one capture.
+ *            Exits when the last reader disconnects; not combinable with
+ *            --control, since readers filter for themselves
+ *   Default: Capture from current session only, write synchronously
  */
 
 #define WIN32_LEAN_AND_MEAN
@@ -19,62 +55,308 @@
 #include <sddl.h>
 #include <io.h>
 #include <fcntl.h>
+#include <evntrace.h>
+#include <evntcons.h>
+#include "filter.h"
+#include "jsonescape.h"
+#include "procname.h"
 
 #define BUFFER_SIZE 4096
 #define MAX_OUTPUT_LEN 4096
+#define MAX_TEXT_LEN (BUFFER_SIZE - sizeof(DWORD))
+#define DEFAULT_RING_SLOTS 1024
+#define DEFAULT_FLUSH_MS 10
+#define DEFAULT_FLUSH_BYTES (64 * 1024)
+#define DEFAULT_STATS_MS 1000
+// Escaped text of a JSON record, which may have been expanded to UTF-8
+#define MAX_JSON_TEXT (MAX_OUTPUT_LEN * 3)
+#define MAX_RECORD_LEN (MAX_JSON_TEXT + MAX_PATH * 2 + 128)
+#define MAX_CONTROL_LINE 1024
 
-// Shared memory objects for Win32 debug capture
-static HANDLE hDBWIN_BUFFER = NULL;
-static HANDLE hDBWIN_DATA_READY = NULL;
-static HANDLE hDBWIN_BUFFER_READY = NULL;
-static HANDLE hDBWIN_MUTEX = NULL;
-static char* pDebugBuffer = NULL;
+// Binary output frame (--binary). Little-endian header followed by len raw
+// text bytes, no terminator. The top byte of len is reserved for FRAME_FLAG_*
+// bits describing optional fields; readers must mask with FRAME_LEN_MASK.
+#pragma pack(push, 1)
+typedef struct {
+    ULONGLONG seq;
+    ULONGLONG time;     // FILETIME
+    DWORD pid;
+    DWORD len;
+} FRAME_HEADER;
+#pragma pack(pop)
+
+#define FRAME_LEN_MASK 0x00FFFFFF
+#define FRAME_FLAGS_SHIFT 24
+
+// Payload starts with a one-byte name length and the process name
+#define FRAME_FLAG_NAME 0x01
+#define MAX_FRAME_NAME 255
+
+// Text is valid UTF-8 with non-ASCII bytes (e.g. from a process whose
+// active code page is UTF-8); without it the text is in the ANSI code page
+#define FRAME_FLAG_UTF8 0x02
+
+// Payload starts with the 8-byte monotonic timestamp, before any name
+#define FRAME_FLAG_MONO 0x04
+
+// The record stands for a run of identical messages (--collapse-ms): after
+// any monotonic timestamp, the payload has a 4-byte count of messages in
+// the run and the 8-byte FILETIME of the first. The header has the last.
+#define FRAME_FLAG_REPEAT 0x08
+
+// Kernel DbgPrint events (EVENT_TRACE_FLAG_DBGPRINT). Classic MOF event
+// with type 32 and payload { ULONG Component; ULONG Level; CHAR Message[]; }
+static const GUID DbgPrintGuid =
+    { 0x13976d09, 0xa327, 0x438c, { 0x95, 0x0b, 0x7f, 0x03, 0x19, 0x28, 0x15, 0xc7 } };
+#define DBGPRINT_EVENT_TYPE 32
+#define ETW_SESSION_NAME "dbgcapture-dbgprint"
+
+// Shared memory objects for one instance of the DBWIN protocol, either the
+// session-local or the Global\ set
+typedef struct {
+    BOOL global;
+    HANDLE hMutex;
+    HANDLE hBuffer;
+    HANDLE hDataReady;
+    HANDLE hBufferReady;
+    char* pBuffer;
+} DBWIN_CHANNEL;
+
+#define MAX_CHANNELS 2
+static DBWIN_CHANNEL g_Channels[MAX_CHANNELS];
+static DWORD g_ChannelCount = 0;
 
 static volatile BOOL g_Running = TRUE;
 static ULONGLONG g_Sequence = 0;
 
+// Single-producer/single-consumer ring used in async mode. The capture
+// thread owns g_RingHead, the writer thread owns g_RingTail; each side only
+// publishes its index after it is done with the slot.
+typedef struct {
+    ULONGLONG seq;
+    ULONGLONG time;
+    ULONGLONG mono;
+    DWORD pid;
+    DWORD len;
+    char text[MAX_TEXT_LEN];
+} RING_SLOT;
+
+static RING_SLOT* g_Ring = NULL;
+static LONG64 g_RingSlots = 0;
+static volatile LONG64 g_RingHead = 0;
+static volatile LONG64 g_RingTail = 0;
+static volatile LONG g_WriterIdle = 0;
+static volatile LONG g_CaptureBlocked = 0;
+static HANDLE hRingNotEmpty = NULL;
+static HANDLE hRingNotFull = NULL;
+
+// Load shedding once the ring is full (--overflow). With OVERFLOW_DROP_OLDEST
+// the producer may advance g_RingTail too, so both sides move it with
+// compare-exchange and the writer copies a slot out before claiming it.
+typedef enum {
+    OVERFLOW_BLOCK,
+    OVERFLOW_DROP_OLDEST,
+    OVERFLOW_DROP_NEWEST
+} OVERFLOW_POLICY;
+
+static OVERFLOW_POLICY g_Overflow = OVERFLOW_BLOCK;
+static const char* const g_OverflowNames[] = { "block", "drop-oldest", "drop-newest" };
+
+// Counters reported by the {"stats": ...} records. Updated by producers
+// (under g_ProducerLock when there are several), read racily for reporting.
+static volatile ULONGLONG g_Dropped = 0;
+static volatile ULONGLONG g_Blocked = 0;
+static volatile ULONGLONG g_BlockedMs = 0;
+static DWORD g_StatsMs = DEFAULT_STATS_MS;
+static ULONGLONG g_StatsDeadline = 0;
+static ULONGLONG g_StartTick = 0;
+
+// Timings for the stats records, in QueryPerformanceCounter ticks and only
+// taken while stats are on. The handoff is from waking on DATA_READY to
+// setting BUFFER_READY, i.e. how long OutputDebugString callers are held,
+// measured on the capture thread. Format and write times are measured on
+// the thread that emits records.
+static volatile ULONGLONG g_CapturedBytes = 0;
+static volatile ULONGLONG g_Handoffs = 0;
+static volatile ULONGLONG g_HandoffTicks = 0;
+static volatile ULONGLONG g_HandoffMaxTicks = 0;  // Since the last stats record
+static volatile ULONGLONG g_FormatTicks = 0;
+static volatile ULONGLONG g_Formatted = 0;  // Records g_FormatTicks covers
+static volatile ULONGLONG g_Writes = 0;
+static volatile ULONGLONG g_WriteBytes = 0;
+static volatile ULONGLONG g_WriteTicks = 0;
+
+// Producers serialize on this only when more than one thread pushes (the
+// ETW consumer alongside the DBWIN capture thread), so both share one
+// ordered sequence.
+static BOOL g_MultiProducer = FALSE;
+static CRITICAL_SECTION g_ProducerLock;
+
+// Real-time ETW session for kernel DbgPrint output
+static TRACEHANDLE g_EtwSession = 0;
+static TRACEHANDLE g_EtwTrace = INVALID_PROCESSTRACE_HANDLE;
+static HANDLE hEtwThread = NULL;
+
+// Reads filter commands from stdin (--control)
+static HANDLE hControlThread = NULL;
+
+// Block-buffered stdout. Records are formatted straight into g_OutBuf and
+// written with one WriteFile once g_FlushBytes accumulate or the oldest
+// pending record is g_FlushMs old. Only the thread that emits records
+// touches these.
+static HANDLE hStdout = NULL;
+static char* g_OutBuf = NULL;
+static size_t g_OutLen = 0;
+static size_t g_FlushBytes = DEFAULT_FLUSH_BYTES;
+static DWORD g_FlushMs = DEFAULT_FLUSH_MS;
+static ULONGLONG g_FlushDeadline = 0;
+static BOOL g_Binary = FALSE;
+static BOOL g_Names = FALSE;
+
+// ANSI text converted to UTF-8 for a JSON record (up to 3 bytes per char)
+static char g_Utf8Text[MAX_OUTPUT_LEN * 3];
+
+// Monotonic clock (--mono): QueryPerformanceCounter ticks since startup
+static BOOL g_Mono = FALSE;
+static LARGE_INTEGER g_QpcStart;
+static LARGE_INTEGER g_QpcFrequency;
+
+// Repeat collapsing (--collapse-ms), all on the thread that formats
+// records. Each process's last written message is kept in a small
+// direct-mapped table; a copy of it is counted into the pending run
+// instead of being written. The run is written as one FRAME_FLAG_REPEAT
+// record before any other record goes out, so seqs stay in order, or once
+// g_CollapseMs has passed since its first copy.
+#define COLLAPSE_SLOTS 64
+
+typedef struct {
+    DWORD pid;  // 0 = unused
+    DWORD len;
+    DWORD hash;
+    char text[MAX_TEXT_LEN];
+} LAST_MESSAGE;
+
+typedef struct {
+    LAST_MESSAGE* message;  // NULL when no run is pending
+    DWORD count;            // Copies held back
+    ULONGLONG firstTime;
+    ULONGLONG seq;          // Of the latest copy
+    ULONGLONG time;
+    ULONGLONG mono;
+    ULONGLONG deadline;     // GetTickCount64() by which the run is written
+} PENDING_RUN;
+
+static DWORD g_CollapseMs = 0;
+static LAST_MESSAGE* g_LastMessages = NULL;
+static PENDING_RUN g_Pending;
+static volatile ULONGLONG g_Collapsed = 0;  // Records saved by collapsing
+
+// Serving (--serve): output goes to every reader connected to a named
+// pipe instead of stdout. The pipe is message mode and each flush of the
+// output buffer is one message, so a reader that connects mid-stream
+// starts on a record boundary. The serve thread accepts readers and
+// notices them leaving through a pending one-byte read on each; whichever
+// thread flushes output writes to all of them under g_ClientLock.
+#define MAX_SERVE_CLIENTS 32
+#define SERVE_PIPE_BUFFER (1024 * 1024)
+#define SERVE_WRITE_TIMEOUT_MS 2000   // A reader this far behind is dropped
+#define SERVE_FIRST_CLIENT_MS 10000   // Exit if nobody connects at all
+
+typedef struct {
+    HANDLE hPipe;
+    OVERLAPPED readOv;   // Completes when the reader disconnects
+    OVERLAPPED writeOv;
+    BOOL writing;
+    BOOL broken;         // Set by a failed write; removed by the serve thread
+    char readByte;
+} SERVE_CLIENT;
+
+// Slots stay put while in use (the kernel holds pointers to their
+// OVERLAPPEDs); a free slot has no hPipe
+
+static const char* g_ServeName = NULL;
+static SERVE_CLIENT g_Clients[MAX_SERVE_CLIENTS];
+static DWORD g_ClientCount = 0;
+static CRITICAL_SECTION g_ClientLock;
+static HANDLE hListenPipe = INVALID_HANDLE_VALUE;
+static OVERLAPPED g_ListenOv;
+static HANDLE hServeThread = NULL;
+static HANDLE hServeStop = NULL;
+static volatile ULONGLONG g_ServeClients = 0;  // Readers connected so far
+
+// Stop capture and wake every thread waiting for work
+static void RequestStop(void) {
+    g_Running = FALSE;
+    if (g_Channels[0].hDataReady != NULL) {
+        SetEvent(g_Channels[0].hDataReady);
+    }
+    if (hRingNotEmpty != NULL) {
+        SetEvent(hRingNotEmpty);
+    }
+}
+
 // Console control handler
 BOOL WINAPI ConsoleHandler(DWORD signal) {
     if (signal == CTRL_C_EVENT || signal == CTRL_BREAK_EVENT || signal == CTRL_CLOSE_EVENT) {
-        g_Running = FALSE;
-        // Signal the wait to wake up
-        if (hDBWIN_DATA_READY != NULL) {
-            SetEvent(hDBWIN_DATA_READY);
-        }
+        RequestStop();
         return TRUE;
     }
     return FALSE;
 }
 
-// Escape a string for JSON output
-void JsonEscape(const char* input, char* output, size_t outputSize) {
-    size_t j = 0;
-    for (size_t i = 0; input[i] && j < outputSize - 2; i++) {
-        char c = input[i];
-        switch (c) {
-            case '"':  if (j < outputSize - 3) { output[j++] = '\\'; output[j++] = '"'; } break;
-            case '\\': if (j < outputSize - 3) { output[j++] = '\\'; output[j++] = '\\'; } break;
-            case '\b': if (j < outputSize - 3) { output[j++] = '\\'; output[j++] = 'b'; } break;
-            case '\f': if (j < outputSize - 3) { output[j++] = '\\'; output[j++] = 'f'; } break;
-            case '\n': if (j < outputSize - 3) { output[j++] = '\\'; output[j++] = 'n'; } break;
-            case '\r': if (j < outputSize - 3) { output[j++] = '\\'; output[j++] = 'r'; } break;
-            case '\t': if (j < outputSize - 3) { output[j++] = '\\'; output[j++] = 't'; } break;
-            default:
-                if ((unsigned char)c >= 32) {
-                    output[j++] = c;
-                }
-                break;
-        }
+// Create or open a channel's named objects. On failure the ones already
+// created are left for UninitializeCapture.
+static BOOL CreateChannelObjects(DBWIN_CHANNEL* ch, SECURITY_ATTRIBUTES* sa) {
+    char objectName[MAX_PATH];
+    const char* prefix = ch->global ? "Global\\" : "";
+    const char* scope = ch->global ? "global" : "local";
+
+    // Create/open the mutex
+    sprintf(objectName, "%sDBWinMutex", prefix);
+    ch->hMutex = OpenMutexA(SYNCHRONIZE, FALSE, objectName);
+    if (!ch->hMutex) {
+        ch->hMutex = CreateMutexA(sa, FALSE, objectName);
+    }
+
+    // Create/open the shared memory buffer
+    sprintf(objectName, "%sDBWIN_BUFFER", prefix);
+    ch->hBuffer = CreateFileMappingA(INVALID_HANDLE_VALUE, sa, PAGE_READWRITE, 0, BUFFER_SIZE, objectName);
+    if (!ch->hBuffer) {
+        fprintf(stderr, "{\"error\": \"Failed to create %s DBWIN_BUFFER: %lu\"}\n", scope, GetLastError());
+        return FALSE;
+    }
+
+    // Map the buffer
+    ch->pBuffer = (char*)MapViewOfFile(ch->hBuffer, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, BUFFER_SIZE);
+    if (!ch->pBuffer) {
+        fprintf(stderr, "{\"error\": \"Failed to map %s DBWIN_BUFFER: %lu\"}\n", scope, GetLastError());
+        return FALSE;
+    }
+
+    // Create/open DATA_READY event
+    sprintf(objectName, "%sDBWIN_DATA_READY", prefix);
+    ch->hDataReady = CreateEventA(sa, FALSE, FALSE, objectName);
+    if (!ch->hDataReady) {
+        fprintf(stderr, "{\"error\": \"Failed to create %s DBWIN_DATA_READY: %lu\"}\n", scope, GetLastError());
+        return FALSE;
+    }
+
+    // Create/open BUFFER_READY event
+    sprintf(objectName, "%sDBWIN_BUFFER_READY", prefix);
+    ch->hBufferReady = CreateEventA(sa, FALSE, FALSE, objectName);
+    if (!ch->hBufferReady) {
+        fprintf(stderr, "{\"error\": \"Failed to create %s DBWIN_BUFFER_READY: %lu\"}\n", scope, GetLastError());
+        return FALSE;
     }
-    output[j] = '\0';
+    return TRUE;
 }
 
-// Initialize Win32 debug capture
+// Initialize Win32 debug capture on one more channel
 BOOL InitializeCapture(BOOL global) {
+    DBWIN_CHANNEL* ch = &g_Channels[g_ChannelCount];
     SECURITY_ATTRIBUTES sa;
     PSECURITY_DESCRIPTOR sddlSd = NULL;
-    char objectName[MAX_PATH];
-    const char* prefix = global ? "Global\\" : "";
+    BOOL ok;
     
     // Security descriptor that allows access from all processes
     const char* sddlSecurity = 
@@ -88,148 +370,1202 @@ BOOL InitializeCapture(BOOL global) {
     sa.bInheritHandle = TRUE;
     sa.lpSecurityDescriptor = sddlSd;
 
-    // Create/open the mutex
-    sprintf(objectName, "%sDBWinMutex", prefix);
-    hDBWIN_MUTEX = OpenMutexA(SYNCHRONIZE, FALSE, objectName);
-    if (!hDBWIN_MUTEX) {
-        hDBWIN_MUTEX = CreateMutexA(&sa, FALSE, objectName);
+    ch->global = global;
+    ok = CreateChannelObjects(ch, &sa);
+    if (sddlSd) LocalFree(sddlSd);
+    if (!ok) {
+        return FALSE;
     }
 
-    // Create/open the shared memory buffer
-    sprintf(objectName, "%sDBWIN_BUFFER", prefix);
-    hDBWIN_BUFFER = CreateFileMappingA(INVALID_HANDLE_VALUE, &sa, PAGE_READWRITE, 0, BUFFER_SIZE, objectName);
-    if (!hDBWIN_BUFFER) {
-        fprintf(stderr, "{\"error\": \"Failed to create DBWIN_BUFFER: %lu\"}\n", GetLastError());
-        if (sddlSd) LocalFree(sddlSd);
+    // Signal that buffer is ready for first write
+    SetEvent(ch->hBufferReady);
+    g_ChannelCount++;
+    
+    return TRUE;
+}
+
+// Cleanup resources of every channel, including a partly created one
+void UninitializeCapture(void) {
+    for (DWORD i = 0; i < MAX_CHANNELS; i++) {
+        DBWIN_CHANNEL* ch = &g_Channels[i];
+        if (ch->pBuffer) {
+            UnmapViewOfFile(ch->pBuffer);
+            ch->pBuffer = NULL;
+        }
+        if (ch->hDataReady) {
+            CloseHandle(ch->hDataReady);
+            ch->hDataReady = NULL;
+        }
+        if (ch->hBufferReady) {
+            CloseHandle(ch->hBufferReady);
+            ch->hBufferReady = NULL;
+        }
+        if (ch->hBuffer) {
+            CloseHandle(ch->hBuffer);
+            ch->hBuffer = NULL;
+        }
+        if (ch->hMutex) {
+            CloseHandle(ch->hMutex);
+            ch->hMutex = NULL;
+        }
+    }
+    g_ChannelCount = 0;
+}
+
+// Allocate the async ring and its wakeup events
+BOOL InitializeRing(LONG64 slots) {
+    g_Ring = (RING_SLOT*)VirtualAlloc(NULL, (SIZE_T)slots * sizeof(RING_SLOT),
+                                      MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    if (!g_Ring) {
+        fprintf(stderr, "{\"error\": \"Failed to allocate ring: %lu\"}\n", GetLastError());
         return FALSE;
     }
+    g_RingSlots = slots;
 
-    // Map the buffer
-    pDebugBuffer = (char*)MapViewOfFile(hDBWIN_BUFFER, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, BUFFER_SIZE);
-    if (!pDebugBuffer) {
-        fprintf(stderr, "{\"error\": \"Failed to map DBWIN_BUFFER: %lu\"}\n", GetLastError());
-        CloseHandle(hDBWIN_BUFFER);
-        if (sddlSd) LocalFree(sddlSd);
+    hRingNotEmpty = CreateEventA(NULL, FALSE, FALSE, NULL);
+    hRingNotFull = CreateEventA(NULL, FALSE, FALSE, NULL);
+    if (!hRingNotEmpty || !hRingNotFull) {
+        fprintf(stderr, "{\"error\": \"Failed to create ring events: %lu\"}\n", GetLastError());
         return FALSE;
     }
+    return TRUE;
+}
+
+void UninitializeRing(void) {
+    if (g_Ring) {
+        VirtualFree(g_Ring, 0, MEM_RELEASE);
+        g_Ring = NULL;
+    }
+    if (hRingNotEmpty) {
+        CloseHandle(hRingNotEmpty);
+        hRingNotEmpty = NULL;
+    }
+    if (hRingNotFull) {
+        CloseHandle(hRingNotFull);
+        hRingNotFull = NULL;
+    }
+}
 
-    // Create/open DATA_READY event
-    sprintf(objectName, "%sDBWIN_DATA_READY", prefix);
-    hDBWIN_DATA_READY = CreateEventA(&sa, FALSE, FALSE, objectName);
-    if (!hDBWIN_DATA_READY) {
-        fprintf(stderr, "{\"error\": \"Failed to create DBWIN_DATA_READY: %lu\"}\n", GetLastError());
-        UnmapViewOfFile(pDebugBuffer);
-        CloseHandle(hDBWIN_BUFFER);
-        if (sddlSd) LocalFree(sddlSd);
+// Get the current time as a FILETIME value, with sub-microsecond
+// resolution rather than the ~1 ms of GetSystemTime
+static ULONGLONG CaptureTimestamp(void) {
+    FILETIME ft;
+    ULARGE_INTEGER uli;
+
+    GetSystemTimePreciseAsFileTime(&ft);
+    uli.LowPart = ft.dwLowDateTime;
+    uli.HighPart = ft.dwHighDateTime;
+    return uli.QuadPart;
+}
+
+// Monotonic time in 100 ns units since startup, or 0 without --mono.
+// Whole seconds and the remainder are scaled apart so the multiply can't
+// overflow however long capture runs.
+static ULONGLONG CaptureMono(void) {
+    LARGE_INTEGER now;
+    ULONGLONG ticks, freq;
+
+    if (!g_Mono) return 0;
+    QueryPerformanceCounter(&now);
+    ticks = (ULONGLONG)(now.QuadPart - g_QpcStart.QuadPart);
+    freq = (ULONGLONG)g_QpcFrequency.QuadPart;
+    return (ticks / freq) * 10000000 + (ticks % freq) * 10000000 / freq;
+}
+
+// Performance counter for the stats timings, or 0 when stats are off
+static ULONGLONG StatsClock(void) {
+    LARGE_INTEGER now;
+
+    if (g_StatsMs == 0) return 0;
+    QueryPerformanceCounter(&now);
+    return (ULONGLONG)now.QuadPart;
+}
+
+// Convert performance counter ticks to microseconds
+static ULONGLONG TicksToMicros(ULONGLONG ticks) {
+    ULONGLONG freq = (ULONGLONG)g_QpcFrequency.QuadPart;
+    return (ticks / freq) * 1000000 + (ticks % freq) * 1000000 / freq;
+}
+
+// Allocate the stdout batch buffer
+BOOL InitializeOutput(void) {
+    hStdout = GetStdHandle(STD_OUTPUT_HANDLE);
+    g_OutBuf = (char*)malloc(g_FlushBytes + MAX_RECORD_LEN);
+    if (!g_OutBuf) {
+        fprintf(stderr, "{\"error\": \"Failed to allocate output buffer\"}\n");
         return FALSE;
     }
+    return TRUE;
+}
 
-    // Create/open BUFFER_READY event
-    sprintf(objectName, "%sDBWIN_BUFFER_READY", prefix);
-    hDBWIN_BUFFER_READY = CreateEventA(&sa, FALSE, FALSE, objectName);
-    if (!hDBWIN_BUFFER_READY) {
-        fprintf(stderr, "{\"error\": \"Failed to create DBWIN_BUFFER_READY: %lu\"}\n", GetLastError());
-        CloseHandle(hDBWIN_DATA_READY);
-        UnmapViewOfFile(pDebugBuffer);
-        CloseHandle(hDBWIN_BUFFER);
-        if (sddlSd) LocalFree(sddlSd);
+void UninitializeOutput(void) {
+    free(g_OutBuf);
+    g_OutBuf = NULL;
+}
+
+// Create a listening instance of the --serve pipe. Only the owner, SYSTEM
+// and administrators may connect: with --global it carries every
+// session's output.
+static HANDLE CreateServePipe(BOOL first) {
+    char path[MAX_PATH];
+    SECURITY_ATTRIBUTES sa;
+    PSECURITY_DESCRIPTOR sd = NULL;
+    HANDLE hPipe;
+
+    _snprintf(path, sizeof(path), "\\\\.\\pipe\\%s", g_ServeName);
+    path[sizeof(path) - 1] = '\0';
+    ConvertStringSecurityDescriptorToSecurityDescriptorA(
+        "D:P(A;;GA;;;OW)(A;;GA;;;SY)(A;;GA;;;BA)", SDDL_REVISION_1, &sd, NULL);
+    sa.nLength = sizeof(SECURITY_ATTRIBUTES);
+    sa.bInheritHandle = FALSE;
+    sa.lpSecurityDescriptor = sd;
+
+    // The first instance claims the name, so a second server fails here
+    // instead of sharing it
+    hPipe = CreateNamedPipeA(path,
+                             PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED | (first ? FILE_FLAG_FIRST_PIPE_INSTANCE : 0),
+                             PIPE_TYPE_MESSAGE | PIPE_READMODE_MESSAGE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+                             PIPE_UNLIMITED_INSTANCES, SERVE_PIPE_BUFFER, 0, 0, &sa);
+    if (sd) LocalFree(sd);
+    if (hPipe == INVALID_HANDLE_VALUE) {
+        if (first && GetLastError() == ERROR_ACCESS_DENIED) {
+            fprintf(stderr, "{\"error\": \"Pipe %s is already being served\"}\n", g_ServeName);
+        } else {
+            fprintf(stderr, "{\"error\": \"Failed to create pipe %s: %lu\"}\n", g_ServeName, GetLastError());
+        }
+        fflush(stderr);
+    }
+    return hPipe;
+}
+
+// Wait for the next reader on hListenPipe; g_ListenOv's event is set once
+// one has connected
+static BOOL ListenForClient(void) {
+    ResetEvent(g_ListenOv.hEvent);
+    if (ConnectNamedPipe(hListenPipe, &g_ListenOv)) {
+        SetEvent(g_ListenOv.hEvent);
+        return TRUE;
+    }
+    switch (GetLastError()) {
+    case ERROR_IO_PENDING:
+        return TRUE;
+    case ERROR_PIPE_CONNECTED:
+        // Connected between CreateNamedPipe and ConnectNamedPipe
+        SetEvent(g_ListenOv.hEvent);
+        return TRUE;
+    default:
         return FALSE;
     }
+}
 
-    if (sddlSd) LocalFree(sddlSd);
+// Keep a read pending on a client, discarding anything it writes. FALSE
+// once the client has gone.
+static BOOL ReadFromClient(SERVE_CLIENT* client) {
+    for (;;) {
+        if (!ReadFile(client->hPipe, &client->readByte, 1, NULL, &client->readOv)) {
+            DWORD err = GetLastError();
+            if (err == ERROR_IO_PENDING) return TRUE;
+            if (err != ERROR_MORE_DATA) return FALSE;
+        }
+    }
+}
 
-    // Signal that buffer is ready for first write
-    SetEvent(hDBWIN_BUFFER_READY);
-    
+// Take over hListenPipe as a client. Called with g_ClientLock held and a
+// slot free.
+static void AddClient(void) {
+    SERVE_CLIENT* client = g_Clients;
+
+    while (client->hPipe) client++;
+    memset(client, 0, sizeof(*client));
+    client->hPipe = hListenPipe;
+    client->readOv.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+    client->writeOv.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+    hListenPipe = INVALID_HANDLE_VALUE;
+    g_ClientCount++;
+    g_ServeClients++;
+    if (!client->readOv.hEvent || !client->writeOv.hEvent || !ReadFromClient(client)) {
+        client->broken = TRUE;
+    }
+}
+
+// Disconnect a client once no write is pending on it. Called with
+// g_ClientLock held.
+static void RemoveClient(SERVE_CLIENT* client) {
+    DWORD transferred;
+
+    CancelIoEx(client->hPipe, NULL);
+    if (client->readOv.hEvent) {
+        GetOverlappedResult(client->hPipe, &client->readOv, &transferred, TRUE);
+        CloseHandle(client->readOv.hEvent);
+    }
+    if (client->writeOv.hEvent) {
+        CloseHandle(client->writeOv.hEvent);
+    }
+    DisconnectNamedPipe(client->hPipe);
+    CloseHandle(client->hPipe);
+    memset(client, 0, sizeof(*client));
+    g_ClientCount--;
+}
+
+// Serve thread: accepts readers and drops the ones that left. Capture stops
+// when the last reader disconnects, or if none ever connects.
+DWORD WINAPI ServeThread(LPVOID param) {
+    HANDLE handles[2 + MAX_SERVE_CLIENTS];
+    ULONGLONG started = GetTickCount64();
+    (void)param;
+
+    for (;;) {
+        DWORD count = 0, timeout = INFINITE, waitResult;
+
+        EnterCriticalSection(&g_ClientLock);
+        handles[count++] = hServeStop;
+        if (hListenPipe != INVALID_HANDLE_VALUE) {
+            handles[count++] = g_ListenOv.hEvent;
+        }
+        for (DWORD i = 0; i < MAX_SERVE_CLIENTS; i++) {
+            if (g_Clients[i].hPipe) {
+                handles[count++] = g_Clients[i].readOv.hEvent;
+            }
+        }
+        LeaveCriticalSection(&g_ClientLock);
+
+        if (g_ServeClients == 0) {
+            ULONGLONG waited = GetTickCount64() - started;
+            timeout = waited < SERVE_FIRST_CLIENT_MS ? (DWORD)(SERVE_FIRST_CLIENT_MS - waited) : 0;
+        }
+        waitResult = WaitForMultipleObjects(count, handles, FALSE, timeout);
+        if (waitResult == WAIT_OBJECT_0 || waitResult == WAIT_FAILED) break;
+        if (waitResult == WAIT_TIMEOUT) {
+            fprintf(stderr, "{\"error\": \"No reader connected to pipe %s\"}\n", g_ServeName);
+            fflush(stderr);
+            RequestStop();
+            break;
+        }
+
+        EnterCriticalSection(&g_ClientLock);
+        // A new reader (removed again below if it has already gone)
+        if (hListenPipe != INVALID_HANDLE_VALUE && WaitForSingleObject(g_ListenOv.hEvent, 0) == WAIT_OBJECT_0) {
+            DWORD transferred;
+            if (GetOverlappedResult(hListenPipe, &g_ListenOv, &transferred, FALSE)
+                || GetLastError() == ERROR_PIPE_CONNECTED) {
+                AddClient();
+            } else {
+                CloseHandle(hListenPipe);
+                hListenPipe = INVALID_HANDLE_VALUE;
+            }
+        }
+
+        // Readers that disconnected or fell too far behind
+        for (DWORD i = 0; i < MAX_SERVE_CLIENTS; i++) {
+            SERVE_CLIENT* client = &g_Clients[i];
+            DWORD transferred;
+            if (!client->hPipe) continue;
+            if (!client->broken && WaitForSingleObject(client->readOv.hEvent, 0) == WAIT_OBJECT_0) {
+                client->broken = !(GetOverlappedResult(client->hPipe, &client->readOv, &transferred, FALSE)
+                                   || GetLastError() == ERROR_MORE_DATA)
+                                 || !ReadFromClient(client);
+            }
+            if (client->broken) {
+                RemoveClient(client);
+            }
+        }
+
+        // A fresh instance for the next reader
+        if (hListenPipe == INVALID_HANDLE_VALUE && g_ClientCount < MAX_SERVE_CLIENTS) {
+            hListenPipe = CreateServePipe(FALSE);
+            if (hListenPipe != INVALID_HANDLE_VALUE && !ListenForClient()) {
+                CloseHandle(hListenPipe);
+                hListenPipe = INVALID_HANDLE_VALUE;
+            }
+        }
+        count = g_ClientCount;
+        LeaveCriticalSection(&g_ClientLock);
+
+        if (count == 0 && g_ServeClients > 0) {
+            RequestStop();
+            break;
+        }
+    }
+    return 0;
+}
+
+// Create the --serve pipe and start accepting readers
+BOOL InitializeServe(void) {
+    InitializeCriticalSection(&g_ClientLock);
+    hServeStop = CreateEventA(NULL, TRUE, FALSE, NULL);
+    g_ListenOv.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+    if (!hServeStop || !g_ListenOv.hEvent) {
+        fprintf(stderr, "{\"error\": \"Failed to create serve events: %lu\"}\n", GetLastError());
+        return FALSE;
+    }
+    hListenPipe = CreateServePipe(TRUE);
+    if (hListenPipe == INVALID_HANDLE_VALUE) {
+        return FALSE;
+    }
+    if (!ListenForClient()) {
+        fprintf(stderr, "{\"error\": \"Failed to listen on pipe %s: %lu\"}\n", g_ServeName, GetLastError());
+        return FALSE;
+    }
+    hServeThread = CreateThread(NULL, 0, ServeThread, NULL, 0, NULL);
+    if (!hServeThread) {
+        fprintf(stderr, "{\"error\": \"Failed to create serve thread: %lu\"}\n", GetLastError());
+        return FALSE;
+    }
     return TRUE;
 }
 
-// Cleanup resources
-void UninitializeCapture(void) {
-    if (pDebugBuffer) {
-        UnmapViewOfFile(pDebugBuffer);
-        pDebugBuffer = NULL;
+// Disconnect every reader. Called once nothing writes output any more,
+// and safe after a partial InitializeServe.
+void UninitializeServe(void) {
+    DWORD transferred;
+
+    if (!g_ServeName) return;
+    if (hServeThread) {
+        SetEvent(hServeStop);
+        WaitForSingleObject(hServeThread, INFINITE);
+        CloseHandle(hServeThread);
+        hServeThread = NULL;
     }
-    if (hDBWIN_DATA_READY) {
-        CloseHandle(hDBWIN_DATA_READY);
-        hDBWIN_DATA_READY = NULL;
+    EnterCriticalSection(&g_ClientLock);
+    for (DWORD i = 0; i < MAX_SERVE_CLIENTS; i++) {
+        if (g_Clients[i].hPipe) {
+            RemoveClient(&g_Clients[i]);
+        }
     }
-    if (hDBWIN_BUFFER_READY) {
-        CloseHandle(hDBWIN_BUFFER_READY);
-        hDBWIN_BUFFER_READY = NULL;
+    LeaveCriticalSection(&g_ClientLock);
+    if (hListenPipe != INVALID_HANDLE_VALUE) {
+        CancelIoEx(hListenPipe, &g_ListenOv);
+        GetOverlappedResult(hListenPipe, &g_ListenOv, &transferred, TRUE);
+        CloseHandle(hListenPipe);
+        hListenPipe = INVALID_HANDLE_VALUE;
     }
-    if (hDBWIN_BUFFER) {
-        CloseHandle(hDBWIN_BUFFER);
-        hDBWIN_BUFFER = NULL;
+    if (g_ListenOv.hEvent) {
+        CloseHandle(g_ListenOv.hEvent);
+        g_ListenOv.hEvent = NULL;
     }
-    if (hDBWIN_MUTEX) {
-        CloseHandle(hDBWIN_MUTEX);
-        hDBWIN_MUTEX = NULL;
+    if (hServeStop) {
+        CloseHandle(hServeStop);
+        hServeStop = NULL;
     }
+    DeleteCriticalSection(&g_ClientLock);
 }
 
-// Main capture loop
-void CaptureLoop(void) {
-    char escapedText[MAX_OUTPUT_LEN * 2];
-    DWORD pid;
-    char* text;
-    SYSTEMTIME st;
-    FILETIME ft;
-    ULARGE_INTEGER uli;
+// Write one message to every reader at once, dropping the ones that don't
+// take it within SERVE_WRITE_TIMEOUT_MS. With no reader it is discarded.
+static void ServeWrite(const char* data, DWORD len) {
+    ULONGLONG deadline = GetTickCount64() + SERVE_WRITE_TIMEOUT_MS;
+
+    EnterCriticalSection(&g_ClientLock);
+    for (DWORD i = 0; i < MAX_SERVE_CLIENTS; i++) {
+        SERVE_CLIENT* client = &g_Clients[i];
+        if (!client->hPipe || client->broken) continue;
+        if (!WriteFile(client->hPipe, data, len, NULL, &client->writeOv)) {
+            if (GetLastError() == ERROR_IO_PENDING) {
+                client->writing = TRUE;
+            } else {
+                client->broken = TRUE;
+            }
+        }
+    }
+    for (DWORD i = 0; i < MAX_SERVE_CLIENTS; i++) {
+        SERVE_CLIENT* client = &g_Clients[i];
+        DWORD transferred;
+        if (!client->hPipe) continue;
+        if (client->writing) {
+            ULONGLONG now = GetTickCount64();
+            DWORD remaining = now < deadline ? (DWORD)(deadline - now) : 0;
+            if (WaitForSingleObject(client->writeOv.hEvent, remaining) != WAIT_OBJECT_0) {
+                CancelIoEx(client->hPipe, &client->writeOv);
+            }
+            if (!GetOverlappedResult(client->hPipe, &client->writeOv, &transferred, TRUE)) {
+                client->broken = TRUE;
+            }
+            client->writing = FALSE;
+        }
+        if (client->broken) {
+            // Completes the pending read, so the serve thread removes it
+            CancelIoEx(client->hPipe, &client->readOv);
+        }
+    }
+    LeaveCriticalSection(&g_ClientLock);
+}
+
+// Write everything buffered so far with as few WriteFile calls as possible
+static void FlushOutput(void) {
+    size_t offset = 0;
+    ULONGLONG started = g_OutLen > 0 ? StatsClock() : 0;
+
+    if (g_ServeName && g_OutLen > 0) {
+        ServeWrite(g_OutBuf, (DWORD)g_OutLen);
+        offset = g_OutLen;
+    }
+    while (offset < g_OutLen) {
+        DWORD written = 0;
+        if (!WriteFile(hStdout, g_OutBuf + offset, (DWORD)(g_OutLen - offset), &written, NULL)) {
+            // Reader went away - nobody is left to consume output
+            g_Running = FALSE;
+            break;
+        }
+        offset += written;
+    }
+    if (started) {
+        g_Writes++;
+        g_WriteBytes += g_OutLen;
+        g_WriteTicks += StatsClock() - started;
+    }
+    g_OutLen = 0;
+    g_FlushDeadline = 0;
+}
+
+// Milliseconds until buffered output must be flushed, capped at maxWait
+static DWORD FlushTimeout(DWORD maxWait) {
+    ULONGLONG now;
+
+    if (g_OutLen == 0) return maxWait;
+    now = GetTickCount64();
+    if (now >= g_FlushDeadline) return 0;
+    return (DWORD)min(g_FlushDeadline - now, (ULONGLONG)maxWait);
+}
+
+// Flush if the oldest buffered record has reached its deadline
+static void FlushIfDue(void) {
+    if (g_OutLen > 0 && GetTickCount64() >= g_FlushDeadline) {
+        FlushOutput();
+    }
+}
+
+// Length of the NUL-terminated text in a DBWIN_BUFFER payload
+static DWORD TextLength(const char* text) {
+    const char* end = (const char*)memchr(text, '\0', MAX_TEXT_LEN);
+    return end ? (DWORD)(end - text) : (DWORD)(MAX_TEXT_LEN - 1);
+}
+
+static BOOL IsAscii(const char* text, DWORD len) {
+    for (DWORD i = 0; i < len; i++) {
+        if ((unsigned char)text[i] >= 0x80) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+// DBWIN text is whatever bytes the writer passed, normally in its ANSI code
+// page (OutputDebugStringW converts to it before the DBWIN protocol). Text
+// that decodes as UTF-8 is taken to be UTF-8, since ANSI text with high
+// bytes practically never does.
+static BOOL IsUtf8(const char* text, DWORD len) {
+    return MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS, text, (int)len, NULL, 0) > 0;
+}
+
+// Converts ANSI text to UTF-8 in g_Utf8Text. Returns the length, or 0 if it
+// can't be converted and should be written as is.
+static DWORD AnsiToUtf8(const char* text, DWORD len) {
+    WCHAR wide[MAX_OUTPUT_LEN];
+    int wideLen = MultiByteToWideChar(CP_ACP, 0, text, (int)len, wide, MAX_OUTPUT_LEN);
+    if (wideLen <= 0) {
+        return 0;
+    }
+    return (DWORD)max(WideCharToMultiByte(CP_UTF8, 0, wide, wideLen, g_Utf8Text, sizeof(g_Utf8Text), NULL, NULL), 0);
+}
+
+// Format a single record into the output buffer. repeat > 1 writes it as a
+// run of that many copies, the first at firstTime.
+static void EmitRecord(ULONGLONG seq, ULONGLONG time, ULONGLONG mono, DWORD pid,
+                       const char* text, DWORD len, DWORD repeat, ULONGLONG firstTime) {
+    ULONGLONG started = StatsClock();
+    const char* name = g_Names ? LookupProcessName(pid) : NULL;
+    char* out;
+
+    if (g_OutLen == 0) {
+        g_FlushDeadline = GetTickCount64() + g_FlushMs;
+    }
+
+    out = g_OutBuf + g_OutLen;
+    if (g_Binary) {
+        FRAME_HEADER* header = (FRAME_HEADER*)out;
+        char* payload = out + sizeof(FRAME_HEADER);
+        DWORD flags = 0;
+        header->seq = seq;
+        header->time = time;
+        header->pid = pid;
+        out = payload;
+        if (g_Mono) {
+            memcpy(out, &mono, sizeof(mono));
+            out += sizeof(mono);
+            flags |= FRAME_FLAG_MONO;
+        }
+        if (repeat > 1) {
+            memcpy(out, &repeat, sizeof(repeat));
+            out += sizeof(repeat);
+            memcpy(out, &firstTime, sizeof(firstTime));
+            out += sizeof(firstTime);
+            flags |= FRAME_FLAG_REPEAT;
+        }
+        if (name) {
+            DWORD nameLen = min((DWORD)strlen(name), (DWORD)MAX_FRAME_NAME);
+            *out++ = (char)nameLen;
+            memcpy(out, name, nameLen);
+            out += nameLen;
+            flags |= FRAME_FLAG_NAME;
+        }
+        if (!IsAscii(text, len) && IsUtf8(text, len)) {
+            flags |= FRAME_FLAG_UTF8;
+        }
+        memcpy(out, text, len);
+        out += len;
+        header->len = (DWORD)(out - payload) | (flags << FRAME_FLAGS_SHIFT);
+    } else {
+        // JSON is always UTF-8
+        if (!IsAscii(text, len) && !IsUtf8(text, len)) {
+            DWORD utf8Len = AnsiToUtf8(text, len);
+            if (utf8Len > 0) {
+                text = g_Utf8Text;
+                len = utf8Len;
+            }
+        }
+        out += sprintf(out, "{\"seq\":%llu,\"time\":%llu,", seq, time);
+        if (g_Mono) {
+            out += sprintf(out, "\"mono\":%llu,", mono);
+        }
+        if (repeat > 1) {
+            out += sprintf(out, "\"repeat\":%lu,\"first_time\":%llu,", repeat, firstTime);
+        }
+        out += sprintf(out, "\"pid\":%lu,", pid);
+        if (name) {
+            memcpy(out, "\"name\":\"", 8);
+            out += 8;
+            out += JsonEscape(name, strlen(name), out, MAX_PATH * 2);
+            memcpy(out, "\",", 2);
+            out += 2;
+        }
+        memcpy(out, "\"text\":\"", 8);
+        out += 8;
+        out += JsonEscape(text, len, out, MAX_JSON_TEXT);
+        memcpy(out, "\"}\n", 3);
+        out += 3;
+    }
+    g_OutLen = (size_t)(out - g_OutBuf);
+    if (started) {
+        g_FormatTicks += StatsClock() - started;
+        g_Formatted++;
+    }
+
+    if (g_OutLen >= g_FlushBytes || g_FlushMs == 0) {
+        FlushOutput();
+    }
+}
+
+BOOL InitializeCollapse(void) {
+    g_LastMessages = (LAST_MESSAGE*)calloc(COLLAPSE_SLOTS, sizeof(LAST_MESSAGE));
+    if (!g_LastMessages) {
+        fprintf(stderr, "{\"error\": \"Failed to allocate collapse table\"}\n");
+        return FALSE;
+    }
+    return TRUE;
+}
+
+void UninitializeCollapse(void) {
+    free(g_LastMessages);
+    g_LastMessages = NULL;
+}
+
+// FNV-1a, to rule out most mismatches before comparing text
+static DWORD HashText(const char* text, DWORD len) {
+    DWORD hash = 2166136261u;
+    for (DWORD i = 0; i < len; i++) {
+        hash = (hash ^ (unsigned char)text[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// Write the pending run, if any
+static void FlushRepeats(void) {
+    PENDING_RUN run = g_Pending;
+    LAST_MESSAGE* message = run.message;
+
+    if (!message) return;
+    g_Pending.message = NULL;
+    // A single held-back copy is just a record
+    EmitRecord(run.seq, run.time, run.mono, message->pid, message->text, message->len,
+               run.count, run.firstTime);
+}
+
+// Milliseconds until the pending run must be written, capped at maxWait
+static DWORD CollapseTimeout(DWORD maxWait) {
+    ULONGLONG now;
+
+    if (!g_Pending.message) return maxWait;
+    now = GetTickCount64();
+    if (now >= g_Pending.deadline) return 0;
+    return (DWORD)min(g_Pending.deadline - now, (ULONGLONG)maxWait);
+}
+
+// Write the pending run if it has reached its deadline
+static void CollapseIfDue(void) {
+    if (g_Pending.message && GetTickCount64() >= g_Pending.deadline) {
+        FlushRepeats();
+    }
+}
+
+// Format a record that passed the filter, collapsing repeats if enabled
+static void DeliverRecord(ULONGLONG seq, ULONGLONG time, ULONGLONG mono, DWORD pid, const char* text, DWORD len) {
+    LAST_MESSAGE* last;
+    DWORD hash;
+
+    if (!g_LastMessages) {
+        EmitRecord(seq, time, mono, pid, text, len, 1, 0);
+        return;
+    }
+
+    hash = HashText(text, len);
+    // PIDs are multiples of 4
+    last = &g_LastMessages[(pid >> 2) % COLLAPSE_SLOTS];
+    if (last->pid == pid && last->len == len && last->hash == hash && memcmp(last->text, text, len) == 0) {
+        CollapseIfDue();
+        if (g_Pending.message != last) {
+            FlushRepeats();
+            g_Pending.message = last;
+            g_Pending.count = 0;
+            g_Pending.firstTime = time;
+            g_Pending.deadline = GetTickCount64() + g_CollapseMs;
+        }
+        g_Pending.count++;
+        g_Pending.seq = seq;
+        g_Pending.time = time;
+        g_Pending.mono = mono;
+        if (g_Pending.count > 1) {
+            g_Collapsed++;
+        }
+        return;
+    }
+
+    FlushRepeats();
+    last->pid = pid;
+    last->len = len;
+    last->hash = hash;
+    memcpy(last->text, text, len);
+    EmitRecord(seq, time, mono, pid, text, len, 1, 0);
+}
+
+// Milliseconds until buffered or held-back output is due, capped at maxWait
+static DWORD OutputTimeout(DWORD maxWait) {
+    return FlushTimeout(CollapseTimeout(maxWait));
+}
+
+// Write out whatever is due
+static void OutputIfDue(void) {
+    CollapseIfDue();
+    FlushIfDue();
+}
+
+// Copy a message into the next ring slot. When the writer thread has
+// fallen a full ring behind, waits for it or sheds a message according to
+// g_Overflow.
+static void RingPush(ULONGLONG time, ULONGLONG mono, DWORD pid, const char* text, DWORD len) {
+    LONG64 head;
+    RING_SLOT* slot;
+
+    if (g_MultiProducer) {
+        EnterCriticalSection(&g_ProducerLock);
+    }
+    head = g_RingHead;
+
+    if (head - ReadAcquire64(&g_RingTail) >= g_RingSlots) {
+        if (g_Overflow == OVERFLOW_DROP_NEWEST) {
+            // The seq is still used up, so readers see the gap
+            g_Sequence++;
+            g_Dropped++;
+            if (g_MultiProducer) {
+                LeaveCriticalSection(&g_ProducerLock);
+            }
+            return;
+        }
+
+        if (g_Overflow == OVERFLOW_DROP_OLDEST) {
+            // Claim the oldest slot unless the writer takes it first
+            LONG64 tail = head - g_RingSlots;
+            if (InterlockedCompareExchange64(&g_RingTail, tail + 1, tail) == tail) {
+                g_Dropped++;
+            }
+        } else {
+            ULONGLONG started = GetTickCount64();
+            g_Blocked++;
+            while (head - ReadAcquire64(&g_RingTail) >= g_RingSlots) {
+                InterlockedExchange(&g_CaptureBlocked, 1);
+                if (head - ReadAcquire64(&g_RingTail) < g_RingSlots) {
+                    break;
+                }
+                WaitForSingleObject(hRingNotFull, 100);
+                if (!g_Running) {
+                    if (g_MultiProducer) {
+                        LeaveCriticalSection(&g_ProducerLock);
+                    }
+                    return;
+                }
+            }
+            g_BlockedMs += GetTickCount64() - started;
+        }
+    }
+
+    slot = &g_Ring[head & (g_RingSlots - 1)];
+    slot->len = min(len, (DWORD)(MAX_TEXT_LEN - 1));
+    memcpy(slot->text, text, slot->len);
+    slot->text[slot->len] = '\0';
+    slot->seq = g_Sequence++;
+    slot->time = time;
+    slot->mono = mono;
+    slot->pid = pid;
+    g_CapturedBytes += slot->len;
+
+    WriteRelease64(&g_RingHead, head + 1);
+    if (g_MultiProducer) {
+        LeaveCriticalSection(&g_ProducerLock);
+    }
+
+    // Only pay for SetEvent when the writer has gone to sleep
+    MemoryBarrier();
+    if (g_WriterIdle && InterlockedExchange(&g_WriterIdle, 0)) {
+        SetEvent(hRingNotEmpty);
+    }
+}
+
+// Copy the slot at tail out of the ring and claim it. Fails if a producer
+// dropped it meanwhile, in which case the copy may be torn and is discarded.
+static BOOL RingClaim(LONG64 tail, RING_SLOT* copy) {
+    RING_SLOT* slot = &g_Ring[tail & (g_RingSlots - 1)];
+    copy->seq = slot->seq;
+    copy->time = slot->time;
+    copy->mono = slot->mono;
+    copy->pid = slot->pid;
+    copy->len = min(slot->len, (DWORD)(MAX_TEXT_LEN - 1));
+    memcpy(copy->text, slot->text, copy->len);
+    return InterlockedCompareExchange64(&g_RingTail, tail + 1, tail) == tail;
+}
+
+// Writer thread: drains the ring, formats records and does all pipe I/O
+DWORD WINAPI WriterThread(LPVOID param) {
+    static RING_SLOT claimed;
+    LONG64 tail = g_RingTail;
+    (void)param;
+
+    for (;;) {
+        LONG64 head = ReadAcquire64(&g_RingHead);
+
+        if (g_Overflow == OVERFLOW_DROP_OLDEST) {
+            // Producers may have dropped slots from under us
+            tail = ReadAcquire64(&g_RingTail);
+        }
+
+        if (tail == head) {
+            if (!g_Running) break;
+
+            // Ring drained - sleep until more arrives or output is due
+            OutputIfDue();
+            InterlockedExchange(&g_WriterIdle, 1);
+            if (ReadAcquire64(&g_RingHead) == tail) {
+                WaitForSingleObject(hRingNotEmpty, OutputTimeout(100));
+            }
+            InterlockedExchange(&g_WriterIdle, 0);
+            continue;
+        }
+
+        while (tail != head) {
+            RING_SLOT* slot = &g_Ring[tail & (g_RingSlots - 1)];
+            if (g_Overflow == OVERFLOW_DROP_OLDEST) {
+                if (!RingClaim(tail, &claimed)) {
+                    tail = ReadAcquire64(&g_RingTail);
+                    continue;
+                }
+                slot = &claimed;
+            }
+            if (FilterAccepts(slot->pid, slot->text, slot->len)) {
+                DeliverRecord(slot->seq, slot->time, slot->mono, slot->pid, slot->text, slot->len);
+            }
+            tail++;
+            if (g_Overflow != OVERFLOW_DROP_OLDEST) {
+                WriteRelease64(&g_RingTail, tail);
+            }
+        }
+
+        MemoryBarrier();
+        if (g_CaptureBlocked && InterlockedExchange(&g_CaptureBlocked, 0)) {
+            SetEvent(hRingNotFull);
+        }
+    }
+
+    FlushRepeats();
+    FlushOutput();
+    return 0;
+}
+
+// ETW callback: push each kernel DbgPrint message into the ring. The event
+// timestamp has already been converted to FILETIME by ProcessTrace; the
+// monotonic time is when the event was delivered, which is later.
+static VOID WINAPI EtwEventCallback(PEVENT_RECORD record) {
+    const char* message;
+    const char* end;
+    DWORD len;
+
+    if (!IsEqualGUID(&record->EventHeader.ProviderId, &DbgPrintGuid) ||
+        record->EventHeader.EventDescriptor.Opcode != DBGPRINT_EVENT_TYPE ||
+        record->UserDataLength <= 2 * sizeof(ULONG)) {
+        return;
+    }
+
+    message = (const char*)record->UserData + 2 * sizeof(ULONG);
+    len = record->UserDataLength - 2 * sizeof(ULONG);
+    end = (const char*)memchr(message, '\0', len);
+    if (end) {
+        len = (DWORD)(end - message);
+    }
+
+    RingPush((ULONGLONG)record->EventHeader.TimeStamp.QuadPart, CaptureMono(),
+             record->EventHeader.ProcessId, message, len);
+}
+
+// Consumer thread: ProcessTrace blocks delivering events until the session stops
+DWORD WINAPI EtwThread(LPVOID param) {
+    (void)param;
+    ProcessTrace(&g_EtwTrace, 1, NULL, NULL);
+    return 0;
+}
+
+// Stop the ETW session, which also ends ProcessTrace on the consumer thread
+void UninitializeEtw(void) {
+    if (g_EtwSession) {
+        ULONG size = sizeof(EVENT_TRACE_PROPERTIES) + sizeof(ETW_SESSION_NAME);
+        EVENT_TRACE_PROPERTIES* props = (EVENT_TRACE_PROPERTIES*)calloc(1, size);
+        if (props) {
+            props->Wnode.BufferSize = size;
+            props->LoggerNameOffset = sizeof(EVENT_TRACE_PROPERTIES);
+            ControlTraceA(g_EtwSession, NULL, props, EVENT_TRACE_CONTROL_STOP);
+            free(props);
+        }
+        g_EtwSession = 0;
+    }
+    if (g_EtwTrace != INVALID_PROCESSTRACE_HANDLE) {
+        CloseTrace(g_EtwTrace);
+        g_EtwTrace = INVALID_PROCESSTRACE_HANDLE;
+    }
+    if (hEtwThread) {
+        WaitForSingleObject(hEtwThread, 5000);
+        CloseHandle(hEtwThread);
+        hEtwThread = NULL;
+    }
+    if (g_MultiProducer) {
+        g_MultiProducer = FALSE;
+        DeleteCriticalSection(&g_ProducerLock);
+    }
+}
+
+// Start a private system logger session with DbgPrint enabled and begin
+// consuming it in real time. Failure is reported but not fatal; DBWIN
+// capture continues without kernel output.
+BOOL InitializeEtw(void) {
+    ULONG size = sizeof(EVENT_TRACE_PROPERTIES) + sizeof(ETW_SESSION_NAME);
+    EVENT_TRACE_PROPERTIES* props = (EVENT_TRACE_PROPERTIES*)calloc(1, size);
+    EVENT_TRACE_LOGFILEA logfile;
+    ULONG status;
+
+    if (!props) return FALSE;
+
+    props->Wnode.BufferSize = size;
+    props->Wnode.Flags = WNODE_FLAG_TRACED_GUID;
+    props->Wnode.ClientContext = 2;  // System time
+    props->LogFileMode = EVENT_TRACE_REAL_TIME_MODE | EVENT_TRACE_SYSTEM_LOGGER_MODE;
+    props->EnableFlags = EVENT_TRACE_FLAG_DBGPRINT;
+    props->FlushTimer = 1;
+    props->LoggerNameOffset = sizeof(EVENT_TRACE_PROPERTIES);
+
+    // A previous instance that was killed leaves its session running
+    ControlTraceA(0, ETW_SESSION_NAME, props, EVENT_TRACE_CONTROL_STOP);
+    props->Wnode.BufferSize = size;
+    props->LoggerNameOffset = sizeof(EVENT_TRACE_PROPERTIES);
+
+    status = StartTraceA(&g_EtwSession, ETW_SESSION_NAME, props);
+    free(props);
+    if (status != ERROR_SUCCESS) {
+        fprintf(stderr, "{\"error\": \"Failed to start ETW session: %lu\"}\n", status);
+        g_EtwSession = 0;
+        return FALSE;
+    }
+
+    ZeroMemory(&logfile, sizeof(logfile));
+    logfile.LoggerName = (LPSTR)ETW_SESSION_NAME;
+    logfile.ProcessTraceMode = PROCESS_TRACE_MODE_REAL_TIME | PROCESS_TRACE_MODE_EVENT_RECORD;
+    logfile.EventRecordCallback = EtwEventCallback;
+
+    g_EtwTrace = OpenTraceA(&logfile);
+    if (g_EtwTrace == INVALID_PROCESSTRACE_HANDLE) {
+        fprintf(stderr, "{\"error\": \"Failed to open ETW session: %lu\"}\n", GetLastError());
+        UninitializeEtw();
+        return FALSE;
+    }
+
+    InitializeCriticalSection(&g_ProducerLock);
+    g_MultiProducer = TRUE;
+
+    hEtwThread = CreateThread(NULL, 0, EtwThread, NULL, 0, NULL);
+    if (!hEtwThread) {
+        fprintf(stderr, "{\"error\": \"Failed to create ETW thread: %lu\"}\n", GetLastError());
+        UninitializeEtw();
+        return FALSE;
+    }
+    return TRUE;
+}
+
+// Control thread: applies commands read line by line from stdin. Ends when
+// the parent closes the pipe.
+DWORD WINAPI ControlThread(LPVOID param) {
+    HANDLE hStdin = GetStdHandle(STD_INPUT_HANDLE);
+    char chunk[4096];
+    char line[MAX_CONTROL_LINE];
+    size_t lineLen = 0;
+    BOOL overflow = FALSE;
+    DWORD bytesRead;
+    (void)param;
+
+    while (ReadFile(hStdin, chunk, sizeof(chunk), &bytesRead, NULL) && bytesRead > 0) {
+        for (DWORD i = 0; i < bytesRead; i++) {
+            if (chunk[i] != '\n') {
+                if (lineLen < sizeof(line) - 1) {
+                    line[lineLen++] = chunk[i];
+                } else {
+                    overflow = TRUE;
+                }
+                continue;
+            }
+
+            if (lineLen > 0 && line[lineLen - 1] == '\r') lineLen--;
+            line[lineLen] = '\0';
+            if (overflow) {
+                fprintf(stderr, "{\"error\": \"Control line too long\"}\n");
+            } else if (lineLen > 0 && !FilterControlLine(line)) {
+                fprintf(stderr, "{\"error\": \"Unknown control command\"}\n");
+            }
+            fflush(stderr);
+            lineLen = 0;
+            overflow = FALSE;
+        }
+    }
+    return 0;
+}
+
+// Milliseconds until the next stats record is due, capped at maxWait
+static DWORD StatsTimeout(DWORD maxWait) {
+    ULONGLONG now;
+
+    if (g_StatsMs == 0) return maxWait;
+    now = GetTickCount64();
+    if (now >= g_StatsDeadline) return 0;
+    return (DWORD)min(g_StatsDeadline - now, (ULONGLONG)maxWait);
+}
+
+// Write a {"stats": ...} record to stderr
+static void EmitStats(void) {
+    fprintf(stderr,
+            "{\"stats\": {\"uptime_ms\": %llu, \"captured\": %llu, \"bytes\": %llu, "
+            "\"dropped\": %llu, \"blocked\": %llu, \"blocked_ms\": %llu, \"overflow\": \"%s\", "
+            "\"handoffs\": %llu, \"handoff_us\": %llu, \"handoff_max_us\": %llu, "
+            "\"format_us\": %llu, \"formatted\": %llu, "
+            "\"writes\": %llu, \"write_bytes\": %llu, \"write_us\": %llu, "
+            "\"collapsed\": %llu, \"clients\": %lu}}\n",
+            GetTickCount64() - g_StartTick, g_Sequence, g_CapturedBytes,
+            g_Dropped, g_Blocked, g_BlockedMs, g_OverflowNames[g_Overflow],
+            g_Handoffs, TicksToMicros(g_HandoffTicks), TicksToMicros(g_HandoffMaxTicks),
+            TicksToMicros(g_FormatTicks), g_Formatted,
+            g_Writes, g_WriteBytes, TicksToMicros(g_WriteTicks),
+            g_Collapsed, g_ClientCount);
+    fflush(stderr);
+    g_HandoffMaxTicks = 0;
+    g_StatsDeadline = GetTickCount64() + g_StatsMs;
+}
+
+// Emit stats if the interval has elapsed
+static void StatsIfDue(void) {
+    if (g_StatsMs != 0 && GetTickCount64() >= g_StatsDeadline) {
+        EmitStats();
+    }
+}
+
+// Take the message waiting in a channel's buffer and release the buffer
+static void CaptureMessage(DBWIN_CHANNEL* ch, BOOL async) {
+    ULONGLONG started = StatsClock();
+    // Extract PID (first 4 bytes) and text (rest)
+    DWORD pid = *(DWORD*)ch->pBuffer;
+    char* text = ch->pBuffer + sizeof(DWORD);
+    ULONGLONG time = CaptureTimestamp();
+    ULONGLONG mono = CaptureMono();
+    
+    if (async) {
+        // Copy out and release the writer immediately
+        RingPush(time, mono, pid, text, TextLength(text));
+    } else {
+        DWORD len = TextLength(text);
+        ULONGLONG seq = g_Sequence++;
+        g_CapturedBytes += len;
+        if (FilterAccepts(pid, text, len)) {
+            DeliverRecord(seq, time, mono, pid, text, len);
+        }
+    }
+    
+    // Signal ready for next output
+    SetEvent(ch->hBufferReady);
+
+    if (started) {
+        ULONGLONG ticks = StatsClock() - started;
+        g_Handoffs++;
+        g_HandoffTicks += ticks;
+        if (ticks > g_HandoffMaxTicks) {
+            g_HandoffMaxTicks = ticks;
+        }
+    }
+}
+
+// Main capture loop. All channels are served from this thread, so records
+// from both share one sequence.
+void CaptureLoop(BOOL async) {
+    HANDLE dataReady[MAX_CHANNELS];
+
+    for (DWORD i = 0; i < g_ChannelCount; i++) {
+        dataReady[i] = g_Channels[i].hDataReady;
+    }
 
     fprintf(stderr, "{\"status\": \"started\"}\n");
     fflush(stderr);
+    g_StatsDeadline = GetTickCount64() + g_StatsMs;
 
     while (g_Running) {
-        // Wait for debug output
-        DWORD waitResult = WaitForSingleObject(hDBWIN_DATA_READY, 1000);
+        // Wait for debug output, waking early if sync-mode output or a
+        // stats record is due
+        DWORD timeout = StatsTimeout(1000);
+        DWORD waitResult = WaitForMultipleObjects(g_ChannelCount, dataReady, FALSE,
+                                                  async ? timeout : OutputTimeout(timeout));
         
         if (!g_Running) break;
+        StatsIfDue();
         
-        if (waitResult == WAIT_OBJECT_0) {
-            // Extract PID (first 4 bytes) and text (rest)
-            pid = *(DWORD*)pDebugBuffer;
-            text = pDebugBuffer + sizeof(DWORD);
-            
-            // Get current time
-            GetSystemTime(&st);
-            SystemTimeToFileTime(&st, &ft);
-            uli.LowPart = ft.dwLowDateTime;
-            uli.HighPart = ft.dwHighDateTime;
-            
-            // Escape text for JSON
-            JsonEscape(text, escapedText, sizeof(escapedText));
-            
-            // Output JSON line
-            printf("{\"seq\":%llu,\"time\":%llu,\"pid\":%lu,\"text\":\"%s\"}\n",
-                   g_Sequence++, uli.QuadPart, pid, escapedText);
-            fflush(stdout);
-            
-            // Signal ready for next output
-            SetEvent(hDBWIN_BUFFER_READY);
-        }
-        // WAIT_TIMEOUT: just continue loop
+        if (waitResult < WAIT_OBJECT_0 + g_ChannelCount) {
+            DWORD first = waitResult - WAIT_OBJECT_0;
+            CaptureMessage(&g_Channels[first], async);
+
+            // The wait always reports the lowest signaled channel; poll the
+            // others too so a busy channel can't starve them
+            for (DWORD i = 0; i < g_ChannelCount; i++) {
+                if (i != first && WaitForSingleObject(dataReady[i], 0) == WAIT_OBJECT_0) {
+                    CaptureMessage(&g_Channels[i], async);
+                }
+            }
+        } else if (!async) {
+            OutputIfDue();
+        }
     }
 
+    if (!async) {
+        FlushRepeats();
+        FlushOutput();
+    }
+
+    if (g_StatsMs != 0) {
+        EmitStats();
+    }
     fprintf(stderr, "{\"status\": \"stopped\"}\n");
     fflush(stderr);
 }
 
 int main(int argc, char* argv[]) {
     BOOL global = FALSE;
+    BOOL local = FALSE;
+    DWORD sessionId = 0;
+    BOOL async = FALSE;
+    BOOL etw = FALSE;
+    BOOL control = FALSE;
+    LONG64 ringSlots = DEFAULT_RING_SLOTS;
+    HANDLE hWriter = NULL;
 
     // Parse arguments
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "--global") == 0 || strcmp(argv[i], "-g") == 0) {
             global = TRUE;
+        } else if (strcmp(argv[i], "--local") == 0 || strcmp(argv[i], "-l") == 0) {
+            local = TRUE;
+        } else if (strcmp(argv[i], "--async") == 0 || strcmp(argv[i], "-a") == 0) {
+            async = TRUE;
+        } else if (strcmp(argv[i], "--ring-slots") == 0 && i + 1 < argc) {
+            ringSlots = _strtoi64(argv[++i], NULL, 10);
+            if (ringSlots < 2 || (ringSlots & (ringSlots - 1)) != 0) {
+                fprintf(stderr, "{\"error\": \"--ring-slots must be a power of two\"}\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--overflow") == 0 && i + 1 < argc) {
+            const char* policy = argv[++i];
+            if (strcmp(policy, "block") == 0) {
+                g_Overflow = OVERFLOW_BLOCK;
+            } else if (strcmp(policy, "drop-oldest") == 0) {
+                g_Overflow = OVERFLOW_DROP_OLDEST;
+            } else if (strcmp(policy, "drop-newest") == 0) {
+                g_Overflow = OVERFLOW_DROP_NEWEST;
+            } else {
+                fprintf(stderr, "{\"error\": \"--overflow must be block, drop-oldest or drop-newest\"}\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--stats-ms") == 0 && i + 1 < argc) {
+            g_StatsMs = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--flush-ms") == 0 && i + 1 < argc) {
+            g_FlushMs = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--flush-bytes") == 0 && i + 1 < argc) {
+            g_FlushBytes = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--binary") == 0 || strcmp(argv[i], "-b") == 0) {
+            g_Binary = TRUE;
+        } else if (strcmp(argv[i], "--etw") == 0 || strcmp(argv[i], "-e") == 0) {
+            etw = TRUE;
+            async = TRUE;
+        } else if (strcmp(argv[i], "--control") == 0 || strcmp(argv[i], "-c") == 0) {
+            control = TRUE;
+        } else if (strcmp(argv[i], "--names") == 0 || strcmp(argv[i], "-n") == 0) {
+            g_Names = TRUE;
+        } else if (strcmp(argv[i], "--mono") == 0 || strcmp(argv[i], "-m") == 0) {
+            g_Mono = TRUE;
+        } else if (strcmp(argv[i], "--collapse-ms") == 0 && i + 1 < argc) {
+            g_CollapseMs = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+            g_ServeName = argv[++i];
         } else if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
-            printf("Usage: dbgcapture.exe [--global]\n");
-            printf("  --global, -g  Capture from all sessions (requires admin)\n");
-            printf("  --help, -h    Show this help\n");
+            printf("Usage: dbgcapture.exe [--global] [--local] [--async] [--ring-slots N]\n");
+            printf("                      [--flush-ms N] [--flush-bytes N] [--binary] [--etw]\n");
+            printf("                      [--control] [--names] [--mono]\n");
+            printf("                      [--overflow block|drop-oldest|drop-newest] [--stats-ms N]\n");
+            printf("                      [--collapse-ms N] [--serve NAME]\n");
+            printf("  --global, -g    Capture from all sessions (requires admin)\n");
+            printf("  --local, -l     Capture from the current session (default; with --global, both)\n");
+            printf("  --async, -a     Write output from a separate thread via a ring buffer\n");
+            printf("  --ring-slots N  Ring capacity in messages, power of two (default %d)\n", DEFAULT_RING_SLOTS);
+            printf("  --overflow P    When the ring is full: block, drop-oldest or drop-newest (default block)\n");
+            printf("  --stats-ms N    Interval of counter records on stderr (default %d, 0 = off)\n", DEFAULT_STATS_MS);
+            printf("  --flush-ms N    Max time output is held before writing (default %d, 0 = per line)\n", DEFAULT_FLUSH_MS);
+            printf("  --flush-bytes N Buffered output size that forces a write (default %d)\n", DEFAULT_FLUSH_BYTES);
+            printf("  --binary, -b    Write binary frames (seq, time, pid, len, text) instead of JSON\n");
+            printf("  --etw, -e       Also capture kernel DbgPrint via ETW (requires admin, implies --async)\n");
+            printf("  --control, -c   Read session filters from stdin and drop unwanted records\n");
+            printf("  --names, -n     Include the process image name in each record\n");
+            printf("  --mono, -m      Include a monotonic timestamp (100 ns units since start)\n");
+            printf("  --collapse-ms N Write runs of a process's repeated message as one record,\n");
+            printf("                  at most N ms after the first repeat (default 0 = off)\n");
+            printf("  --serve NAME    Write output to every reader of \\\\.\\pipe\\NAME instead of stdout\n");
+            printf("  --help, -h      Show this help\n");
             return 0;
         }
     }
 
+    if (g_ServeName && control) {
+        fprintf(stderr, "{\"error\": \"--control can't be combined with --serve\"}\n");
+        return 1;
+    }
+
+    QueryPerformanceFrequency(&g_QpcFrequency);
+    QueryPerformanceCounter(&g_QpcStart);
+    g_StartTick = GetTickCount64();
+
     // Set up console handler for graceful shutdown
     SetConsoleCtrlHandler(ConsoleHandler, TRUE);
 
@@ -237,16 +1573,100 @@ int main(int argc, char* argv[]) {
     _setmode(_fileno(stdout), _O_BINARY);
     _setmode(_fileno(stderr), _O_BINARY);
 
+    // Without --global the current session is captured. In session 0 the
+    // session-local objects are the Global\ ones, so only open them once.
+    if (!global) {
+        local = TRUE;
+    } else if (local && ProcessIdToSessionId(GetCurrentProcessId(), &sessionId) && sessionId == 0) {
+        local = FALSE;
+    }
+
     // Initialize capture
-    if (!InitializeCapture(global)) {
+    if (!InitializeOutput()) {
+        return 1;
+    }
+    if (g_CollapseMs > 0 && !InitializeCollapse()) {
+        UninitializeOutput();
+        return 1;
+    }
+    if ((local && !InitializeCapture(FALSE)) || (global && !InitializeCapture(TRUE))) {
+        UninitializeCapture();
+        UninitializeCollapse();
+        UninitializeOutput();
+        return 1;
+    }
+
+    // Readers can connect once capture is live
+    if (g_ServeName && !InitializeServe()) {
+        UninitializeServe();
+        UninitializeCapture();
+        UninitializeCollapse();
+        UninitializeOutput();
         return 1;
     }
 
+    // Start the writer thread for async mode
+    if (async) {
+        if (!InitializeRing(ringSlots)) {
+            UninitializeRing();
+            UninitializeServe();
+            UninitializeCapture();
+            UninitializeCollapse();
+            UninitializeOutput();
+            return 1;
+        }
+        hWriter = CreateThread(NULL, 0, WriterThread, NULL, 0, NULL);
+        if (!hWriter) {
+            fprintf(stderr, "{\"error\": \"Failed to create writer thread: %lu\"}\n", GetLastError());
+            UninitializeRing();
+            UninitializeServe();
+            UninitializeCapture();
+            UninitializeCollapse();
+            UninitializeOutput();
+            return 1;
+        }
+    }
+
+    // Kernel DbgPrint feeds the same ring as DBWIN
+    if (etw) {
+        InitializeEtw();
+    }
+
+    // Filter updates arrive on stdin while capture runs
+    if (control) {
+        hControlThread = CreateThread(NULL, 0, ControlThread, NULL, 0, NULL);
+        if (!hControlThread) {
+            fprintf(stderr, "{\"error\": \"Failed to create control thread: %lu\"}\n", GetLastError());
+        }
+    }
+
     // Run capture loop
-    CaptureLoop();
+    CaptureLoop(async);
+
+    // Stop ETW first so no producer is left when the writer drains
+    UninitializeEtw();
+
+    // Let the writer drain what is already in the ring
+    if (hWriter) {
+        SetEvent(hRingNotEmpty);
+        WaitForSingleObject(hWriter, 5000);
+        CloseHandle(hWriter);
+    }
+
+    // The control thread may still be blocked reading stdin and owns the
+    // filter it is building; both end with the process
+    if (hControlThread) {
+        CloseHandle(hControlThread);
+        hControlThread = NULL;
+    }
 
     // Cleanup
+    UninitializeRing();
+    UninitializeServe();
     UninitializeCapture();
+    UninitializeCollapse();
+    UninitializeOutput();
+    UninitializeProcessNames();
 
     return 0;
 }
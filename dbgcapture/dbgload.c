@@ -0,0 +1,379 @@
+/*
+ * dbgload.c - OutputDebugString load generator
+ *
+ * Drives the DBWIN protocol from several writer threads (optionally spread
+ * over several processes) at a target rate, with a configurable message
+ * size distribution, to find the limits of the capture pipeline. Every
+ * message is tagged "[LOAD run] writer n", and the QueryPerformanceCounter
+ * value just before and just after each OutputDebugString call is recorded,
+ * so a reader holding the capture side (mcp_server/bench_capture.py) can
+ * match entries back to when they were sent.
+ *
+ * Usage: dbgload.exe [--threads N] [--processes N] [--count N] [--rate N]
+ *                    [--size MIN[-MAX]] [--dist uniform|log] [--run ID]
+ *                    [--out FILE]
+ *   --threads: Writer threads per process (default 1)
+ *   --processes: Writer processes; each runs --threads writers (default 1,
+ *                i.e. threads of this process only)
+ *   --count: Messages per writer (default 10000)
+ *   --rate: Target total messages per second over all writers (default 0,
+ *           as fast as OutputDebugString returns)
+ *   --size: Message length in bytes, fixed or a range (default 64)
+ *   --dist: How lengths are drawn from the range: uniform, or log-uniform
+ *           (mostly short lines with a long tail, like real traffic)
+ *   --run: Tag identifying this run's messages (default the process ID)
+ *   --out: Write one record per message to FILE: little-endian
+ *          { DWORD writer; DWORD n; ULONGLONG sentQpc; ULONGLONG returnQpc; }
+ *
+ * A JSON summary is written to stdout when all writers are done.
+ */
+
+#define WIN32_LEAN_AND_MEAN
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <windows.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_MESSAGE_LEN 4000
+#define MAX_WRITERS 256
+#define MAX_COMMAND_LINE 2048
+
+// Pacing sleeps only when the next message is further off than a scheduler
+// tick, and spins on SwitchToThread for the rest
+#define SLEEP_THRESHOLD_MS 20
+
+#pragma pack(push, 1)
+typedef struct {
+    DWORD writer;
+    DWORD n;
+    ULONGLONG sentQpc;
+    ULONGLONG returnQpc;
+} LOAD_RECORD;
+#pragma pack(pop)
+
+typedef enum { DIST_UNIFORM, DIST_LOG } SIZE_DIST;
+
+typedef struct {
+    DWORD id;
+    LOAD_RECORD* records;
+    DWORD sent;
+} WRITER;
+
+// Options
+static DWORD g_Threads = 1;
+static DWORD g_Processes = 1;
+static DWORD g_Count = 10000;
+static double g_Rate = 0;
+static DWORD g_SizeMin = 64;
+static DWORD g_SizeMax = 64;
+static SIZE_DIST g_Dist = DIST_UNIFORM;
+static DWORD g_Run = 0;
+static DWORD g_WriterBase = 0;
+static const char* g_OutPath = NULL;
+static BOOL g_Child = FALSE;
+
+static LARGE_INTEGER g_QpcFrequency;
+static HANDLE g_StartEvent = NULL;
+
+static const char g_Filler[] = "the quick brown fox jumps over the lazy dog 0123456789 ";
+
+// xorshift64*; each writer has its own state
+static ULONGLONG NextRandom(ULONGLONG* state) {
+    ULONGLONG x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+static DWORD DrawSize(ULONGLONG* state) {
+    double u;
+
+    if (g_SizeMax <= g_SizeMin) {
+        return g_SizeMin;
+    }
+    u = (double)(NextRandom(state) >> 11) / (double)(1ULL << 53);
+    if (g_Dist == DIST_LOG) {
+        return (DWORD)(g_SizeMin * pow((double)g_SizeMax / g_SizeMin, u));
+    }
+    return g_SizeMin + (DWORD)(u * (g_SizeMax - g_SizeMin + 1));
+}
+
+static ULONGLONG Now(void) {
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return (ULONGLONG)now.QuadPart;
+}
+
+// Waits until the QPC reaches target
+static void WaitUntil(ULONGLONG target) {
+    ULONGLONG sleepTicks = (ULONGLONG)g_QpcFrequency.QuadPart * SLEEP_THRESHOLD_MS / 1000;
+    ULONGLONG now;
+
+    while ((now = Now()) < target) {
+        if (target - now > sleepTicks) {
+            Sleep(SLEEP_THRESHOLD_MS / 2);
+        } else {
+            SwitchToThread();
+        }
+    }
+}
+
+static DWORD WINAPI WriterThread(LPVOID param) {
+    WRITER* writer = (WRITER*)param;
+    ULONGLONG random = 0x9E3779B97F4A7C15ULL ^ ((ULONGLONG)g_Run << 32) ^ writer->id;
+    char message[MAX_MESSAGE_LEN + 1];
+    double period = 0;
+    ULONGLONG start;
+
+    // Each writer's share of the total rate, in QPC ticks per message
+    if (g_Rate > 0) {
+        period = (double)g_QpcFrequency.QuadPart * g_Threads * g_Processes / g_Rate;
+    }
+
+    WaitForSingleObject(g_StartEvent, INFINITE);
+    start = Now();
+
+    for (DWORD n = 0; n < g_Count; n++) {
+        LOAD_RECORD* record = &writer->records[n];
+        DWORD size = DrawSize(&random);
+        int len = _snprintf(message, MAX_MESSAGE_LEN, "[LOAD %lu] %lu %lu ", g_Run, writer->id, n);
+
+        // Pad with words up to the drawn length
+        for (DWORD i = 0; (DWORD)len < size; i++, len++) {
+            message[len] = g_Filler[i % (sizeof(g_Filler) - 1)];
+        }
+        message[len] = '\0';
+
+        if (period > 0) {
+            // Scheduled from the start, so a late message doesn't delay the rest
+            WaitUntil(start + (ULONGLONG)(n * period));
+        }
+
+        record->writer = writer->id;
+        record->n = n;
+        record->sentQpc = Now();
+        OutputDebugStringA(message);
+        record->returnQpc = Now();
+        writer->sent++;
+    }
+    return 0;
+}
+
+static BOOL WriteRecords(FILE* out, const LOAD_RECORD* records, DWORD count) {
+    return fwrite(records, sizeof(LOAD_RECORD), count, out) == count;
+}
+
+// Appends a child's record file to out (if any) and deletes it. Returns the
+// number of records.
+static DWORD AppendFile(FILE* out, const char* path) {
+    LOAD_RECORD records[1024];
+    DWORD total = 0;
+    size_t count;
+    FILE* in = fopen(path, "rb");
+
+    if (!in) {
+        return 0;
+    }
+    while ((count = fread(records, sizeof(LOAD_RECORD), 1024, in)) > 0) {
+        if (out) {
+            fwrite(records, sizeof(LOAD_RECORD), count, out);
+        }
+        total += (DWORD)count;
+    }
+    fclose(in);
+    DeleteFileA(path);
+    return total;
+}
+
+// Runs g_Processes copies of this program with --threads writers each,
+// numbering their writers consecutively. Returns the messages they sent.
+static DWORD RunProcesses(FILE* out) {
+    PROCESS_INFORMATION processes[MAX_WRITERS];
+    char paths[MAX_WRITERS][MAX_PATH];
+    char exe[MAX_PATH];
+    char commandLine[MAX_COMMAND_LINE];
+    DWORD started = 0;
+    DWORD sent = 0;
+
+    GetModuleFileNameA(NULL, exe, MAX_PATH);
+
+    for (DWORD p = 0; p < g_Processes; p++) {
+        STARTUPINFOA startup = { sizeof(startup) };
+
+        _snprintf(paths[p], MAX_PATH, "%s.%lu", g_OutPath ? g_OutPath : "dbgload.records", p);
+        _snprintf(commandLine, sizeof(commandLine),
+            "\"%s\" --child --run %lu --writer-base %lu --threads %lu --processes %lu "
+            "--count %lu --rate %.3f --size %lu-%lu --dist %s --out \"%s\"",
+            exe, g_Run, p * g_Threads, g_Threads, g_Processes, g_Count, g_Rate,
+            g_SizeMin, g_SizeMax, g_Dist == DIST_LOG ? "log" : "uniform", paths[p]);
+
+        if (!CreateProcessA(NULL, commandLine, NULL, NULL, FALSE, 0, NULL, NULL, &startup, &processes[p])) {
+            fprintf(stderr, "{\"error\": \"Failed to start writer process: %lu\"}\n", GetLastError());
+            break;
+        }
+        started++;
+    }
+
+    // Children wait on the same named event, so they all start together
+    SetEvent(g_StartEvent);
+
+    for (DWORD p = 0; p < started; p++) {
+        WaitForSingleObject(processes[p].hProcess, INFINITE);
+        CloseHandle(processes[p].hProcess);
+        CloseHandle(processes[p].hThread);
+        sent += AppendFile(out, paths[p]);
+    }
+    return sent;
+}
+
+// Runs g_Threads writer threads in this process. Returns the messages sent.
+static DWORD RunThreads(FILE* out) {
+    WRITER writers[MAX_WRITERS];
+    HANDLE threads[MAX_WRITERS];
+    DWORD started = 0;
+    DWORD sent = 0;
+
+    for (DWORD t = 0; t < g_Threads; t++) {
+        writers[t].id = g_WriterBase + t;
+        writers[t].sent = 0;
+        writers[t].records = (LOAD_RECORD*)calloc(g_Count ? g_Count : 1, sizeof(LOAD_RECORD));
+        if (!writers[t].records) {
+            fprintf(stderr, "{\"error\": \"Failed to allocate records for %lu messages\"}\n", g_Count);
+            break;
+        }
+        threads[t] = CreateThread(NULL, 0, WriterThread, &writers[t], 0, NULL);
+        if (!threads[t]) {
+            fprintf(stderr, "{\"error\": \"Failed to create writer thread: %lu\"}\n", GetLastError());
+            free(writers[t].records);
+            break;
+        }
+        started++;
+    }
+
+    // Release all writers at once; a child's are released by its parent
+    if (!g_Child) {
+        SetEvent(g_StartEvent);
+    }
+    WaitForMultipleObjects(started, threads, TRUE, INFINITE);
+
+    for (DWORD t = 0; t < started; t++) {
+        CloseHandle(threads[t]);
+        if (out && !WriteRecords(out, writers[t].records, writers[t].sent)) {
+            fprintf(stderr, "{\"error\": \"Failed to write records\"}\n");
+        }
+        sent += writers[t].sent;
+        free(writers[t].records);
+    }
+    return sent;
+}
+
+static BOOL ParseSize(const char* value) {
+    char* end;
+
+    g_SizeMin = strtoul(value, &end, 10);
+    g_SizeMax = *end == '-' ? strtoul(end + 1, NULL, 10) : g_SizeMin;
+    return g_SizeMin > 0 && g_SizeMax >= g_SizeMin && g_SizeMax <= MAX_MESSAGE_LEN;
+}
+
+int main(int argc, char* argv[]) {
+    FILE* out = NULL;
+    char eventName[64];
+    ULONGLONG start, elapsed;
+    double elapsedMs;
+    DWORD sent;
+
+    g_Run = GetCurrentProcessId();
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            g_Threads = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--processes") == 0 && i + 1 < argc) {
+            g_Processes = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--count") == 0 && i + 1 < argc) {
+            g_Count = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+            g_Rate = strtod(argv[++i], NULL);
+        } else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            if (!ParseSize(argv[++i])) {
+                fprintf(stderr, "{\"error\": \"--size must be MIN or MIN-MAX with 0 < MIN <= MAX <= %d\"}\n", MAX_MESSAGE_LEN);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--dist") == 0 && i + 1 < argc) {
+            const char* dist = argv[++i];
+            if (strcmp(dist, "uniform") == 0) {
+                g_Dist = DIST_UNIFORM;
+            } else if (strcmp(dist, "log") == 0) {
+                g_Dist = DIST_LOG;
+            } else {
+                fprintf(stderr, "{\"error\": \"--dist must be uniform or log\"}\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--run") == 0 && i + 1 < argc) {
+            g_Run = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            g_OutPath = argv[++i];
+        } else if (strcmp(argv[i], "--writer-base") == 0 && i + 1 < argc) {
+            g_WriterBase = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--child") == 0) {
+            g_Child = TRUE;
+        } else if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
+            printf("Usage: dbgload.exe [--threads N] [--processes N] [--count N] [--rate N]\n");
+            printf("                   [--size MIN[-MAX]] [--dist uniform|log] [--run ID] [--out FILE]\n");
+            printf("  --threads N      Writer threads per process (default 1)\n");
+            printf("  --processes N    Writer processes (default 1, this process)\n");
+            printf("  --count N        Messages per writer (default 10000)\n");
+            printf("  --rate N         Target total messages/sec (default 0 = unthrottled)\n");
+            printf("  --size MIN[-MAX] Message length in bytes (default 64, max %d)\n", MAX_MESSAGE_LEN);
+            printf("  --dist D         Length distribution over the range: uniform or log\n");
+            printf("  --run ID         Run tag in every message (default the process ID)\n");
+            printf("  --out FILE       Write per-message send/return QPC records to FILE\n");
+            printf("  --help, -h       Show this help\n");
+            return 0;
+        }
+    }
+
+    if (g_Threads == 0 || g_Processes == 0 || g_Threads * g_Processes > MAX_WRITERS) {
+        fprintf(stderr, "{\"error\": \"--threads times --processes must be between 1 and %d\"}\n", MAX_WRITERS);
+        return 1;
+    }
+
+    QueryPerformanceFrequency(&g_QpcFrequency);
+    _snprintf(eventName, sizeof(eventName), "Local\\dbgload-%lu-start", g_Run);
+    g_StartEvent = CreateEventA(NULL, TRUE, FALSE, eventName);
+    if (!g_StartEvent) {
+        fprintf(stderr, "{\"error\": \"Failed to create start event: %lu\"}\n", GetLastError());
+        return 1;
+    }
+
+    if (g_OutPath) {
+        out = fopen(g_OutPath, "wb");
+        if (!out) {
+            fprintf(stderr, "{\"error\": \"Failed to open %s\"}\n", g_OutPath);
+            return 1;
+        }
+    }
+
+    start = Now();
+    sent = (g_Processes > 1 && !g_Child) ? RunProcesses(out) : RunThreads(out);
+    elapsed = Now() - start;
+
+    if (out) {
+        fclose(out);
+    }
+    CloseHandle(g_StartEvent);
+
+    if (!g_Child) {
+        elapsedMs = (double)elapsed * 1000.0 / g_QpcFrequency.QuadPart;
+        printf("{\"run\":%lu,\"writers\":%lu,\"sent\":%lu,\"elapsed_ms\":%.3f,"
+               "\"rate\":%.1f,\"target_rate\":%.1f,\"qpc_frequency\":%lld}\n",
+            g_Run, g_Threads * g_Processes, sent, elapsedMs,
+            elapsedMs > 0 ? sent * 1000.0 / elapsedMs : 0.0, g_Rate,
+            g_QpcFrequency.QuadPart);
+    }
+    return 0;
+}
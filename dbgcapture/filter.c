@@ -0,0 +1,269 @@
+/*
+ * filter.c - Native record filtering for dbgcapture
+ *
+ * The MCP server pushes the union of its sessions' filters over the control
+ * channel so records nobody wants are dropped before they are formatted and
+ * piped. A record passes if any session accepts it; within a session the
+ * PID, name, include and exclude constraints must all hold, and an empty
+ * list means no constraint. Only literal patterns are pushed - the server
+ * leaves out anything it can't express here and filters exactly afterwards.
+ *
+ * Literals are compared as bytes, so excludes only apply to text that is
+ * ASCII or UTF-8, where an ASCII byte is always an ASCII character. In a
+ * double-byte ANSI code page the trailing byte of a character can look
+ * like ASCII, and a false exclude match would drop the record for good;
+ * includes and names can only over-accept, which the server corrects.
+ *
+ * The control thread builds a new union off to the side and swaps it in
+ * under an exclusive lock; the emitting thread only takes the lock shared.
+ */
+
+#define WIN32_LEAN_AND_MEAN
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <windows.h>
+#include <stdlib.h>
+#include <string.h>
+#include "filter.h"
+#include "procname.h"
+
+#define MAX_FILTER_TEXT 4096
+
+typedef struct {
+    DWORD* pids;
+    DWORD pidCount;
+    char** names;
+    DWORD nameCount;
+    char** includes;
+    DWORD includeCount;
+    char** excludes;
+    DWORD excludeCount;
+} SESSION_FILTER;
+
+typedef struct {
+    SESSION_FILTER* sessions;
+    DWORD count;
+    BOOL needsText;
+    BOOL needsName;
+    BOOL hasExcludes;
+} FILTER_UNION;
+
+static SRWLOCK g_FilterLock = SRWLOCK_INIT;
+static FILTER_UNION* g_Filter = NULL;    // NULL accepts everything
+static FILTER_UNION* g_Building = NULL;  // Control thread only
+
+static char AsciiLower(char c) {
+    return (c >= 'A' && c <= 'Z') ? (char)(c + ('a' - 'A')) : c;
+}
+
+static void LowerCopy(char* dest, const char* src, DWORD len) {
+    for (DWORD i = 0; i < len; i++) {
+        dest[i] = AsciiLower(src[i]);
+    }
+    dest[len] = '\0';
+}
+
+static BOOL ContainsAny(const char* haystack, char** needles, DWORD count) {
+    for (DWORD i = 0; i < count; i++) {
+        if (strstr(haystack, needles[i])) return TRUE;
+    }
+    return FALSE;
+}
+
+static void FreeStrings(char** list, DWORD count) {
+    for (DWORD i = 0; i < count; i++) {
+        free(list[i]);
+    }
+    free(list);
+}
+
+static void FreeUnion(FILTER_UNION* filter) {
+    if (!filter) return;
+    for (DWORD i = 0; i < filter->count; i++) {
+        SESSION_FILTER* session = &filter->sessions[i];
+        free(session->pids);
+        FreeStrings(session->names, session->nameCount);
+        FreeStrings(session->includes, session->includeCount);
+        FreeStrings(session->excludes, session->excludeCount);
+    }
+    free(filter->sessions);
+    free(filter);
+}
+
+// Append a lowercased copy of value to a string list
+static BOOL AppendString(char*** list, DWORD* count, const char* value) {
+    size_t len = strlen(value);
+    char** grown;
+    char* copy;
+
+    if (len == 0) return TRUE;
+    copy = (char*)malloc(len + 1);
+    if (!copy) return FALSE;
+    LowerCopy(copy, value, (DWORD)len);
+
+    grown = (char**)realloc(*list, (*count + 1) * sizeof(char*));
+    if (!grown) {
+        free(copy);
+        return FALSE;
+    }
+    grown[(*count)++] = copy;
+    *list = grown;
+    return TRUE;
+}
+
+static BOOL AppendPid(SESSION_FILTER* session, DWORD pid) {
+    DWORD* grown = (DWORD*)realloc(session->pids, (session->pidCount + 1) * sizeof(DWORD));
+    if (!grown) return FALSE;
+    grown[session->pidCount++] = pid;
+    session->pids = grown;
+    return TRUE;
+}
+
+static BOOL AddSession(FILTER_UNION* filter) {
+    SESSION_FILTER* grown = (SESSION_FILTER*)realloc(
+        filter->sessions, (filter->count + 1) * sizeof(SESSION_FILTER));
+    if (!grown) return FALSE;
+    ZeroMemory(&grown[filter->count], sizeof(SESSION_FILTER));
+    filter->count++;
+    filter->sessions = grown;
+    return TRUE;
+}
+
+// TRUE if byte-wise literal matches can be trusted not to split a character
+static BOOL BytewiseText(const char* text, DWORD len) {
+    for (DWORD i = 0; i < len; i++) {
+        if ((unsigned char)text[i] >= 0x80) {
+            return MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS, text, (int)len, NULL, 0) > 0;
+        }
+    }
+    return TRUE;
+}
+
+static BOOL SessionAccepts(const SESSION_FILTER* session, DWORD pid,
+                           const char* lowerText, const char* lowerName, BOOL excludes) {
+    if (session->pidCount > 0) {
+        BOOL found = FALSE;
+        for (DWORD i = 0; i < session->pidCount && !found; i++) {
+            found = session->pids[i] == pid;
+        }
+        if (!found) return FALSE;
+    }
+    // A name that can't be resolved passes; the server checks it again
+    if (session->nameCount > 0 && lowerName[0] &&
+        !ContainsAny(lowerName, session->names, session->nameCount)) {
+        return FALSE;
+    }
+    if (session->includeCount > 0 && !ContainsAny(lowerText, session->includes, session->includeCount)) {
+        return FALSE;
+    }
+    if (excludes && session->excludeCount > 0 && ContainsAny(lowerText, session->excludes, session->excludeCount)) {
+        return FALSE;
+    }
+    return TRUE;
+}
+
+BOOL FilterAccepts(DWORD pid, const char* text, DWORD len) {
+    static char lowerText[MAX_FILTER_TEXT];
+    static char lowerName[MAX_PATH];
+    BOOL accept = TRUE;
+    BOOL excludes;
+
+    AcquireSRWLockShared(&g_FilterLock);
+    if (g_Filter) {
+        excludes = g_Filter->hasExcludes && BytewiseText(text, len);
+        if (g_Filter->needsText) {
+            LowerCopy(lowerText, text, min(len, (DWORD)(MAX_FILTER_TEXT - 1)));
+        }
+        if (g_Filter->needsName) {
+            const char* name = LookupProcessName(pid);
+            LowerCopy(lowerName, name, min((DWORD)strlen(name), (DWORD)(MAX_PATH - 1)));
+        }
+
+        accept = FALSE;
+        for (DWORD i = 0; i < g_Filter->count && !accept; i++) {
+            accept = SessionAccepts(&g_Filter->sessions[i], pid, lowerText, lowerName, excludes);
+        }
+    }
+    ReleaseSRWLockShared(&g_FilterLock);
+    return accept;
+}
+
+// Swap in the union built since "filter begin"
+static void InstallFilter(void) {
+    FILTER_UNION* old;
+    FILTER_UNION* filter = g_Building;
+
+    g_Building = NULL;
+    if (filter) {
+        for (DWORD i = 0; i < filter->count; i++) {
+            SESSION_FILTER* session = &filter->sessions[i];
+            if (session->nameCount > 0) filter->needsName = TRUE;
+            if (session->includeCount > 0 || session->excludeCount > 0) filter->needsText = TRUE;
+            if (session->excludeCount > 0) filter->hasExcludes = TRUE;
+        }
+        // Any unconstrained session accepts everything
+        for (DWORD i = 0; i < filter->count; i++) {
+            SESSION_FILTER* session = &filter->sessions[i];
+            if (!session->pidCount && !session->nameCount &&
+                !session->includeCount && !session->excludeCount) {
+                FreeUnion(filter);
+                filter = NULL;
+                break;
+            }
+        }
+        if (filter && filter->count == 0) {
+            FreeUnion(filter);
+            filter = NULL;
+        }
+    }
+
+    AcquireSRWLockExclusive(&g_FilterLock);
+    old = g_Filter;
+    g_Filter = filter;
+    ReleaseSRWLockExclusive(&g_FilterLock);
+    FreeUnion(old);
+}
+
+BOOL FilterControlLine(const char* line) {
+    SESSION_FILTER* session;
+    BOOL ok = TRUE;
+
+    if (strcmp(line, "filter begin") == 0) {
+        FreeUnion(g_Building);
+        g_Building = (FILTER_UNION*)calloc(1, sizeof(FILTER_UNION));
+        return TRUE;
+    }
+    if (strcmp(line, "filter end") == 0) {
+        InstallFilter();
+        return TRUE;
+    }
+    if (!g_Building) {
+        return FALSE;
+    }
+    if (strcmp(line, "session") == 0) {
+        ok = AddSession(g_Building);
+    } else if (g_Building->count == 0) {
+        return FALSE;
+    } else {
+        session = &g_Building->sessions[g_Building->count - 1];
+        if (strncmp(line, "pid ", 4) == 0) {
+            ok = AppendPid(session, strtoul(line + 4, NULL, 10));
+        } else if (strncmp(line, "name ", 5) == 0) {
+            ok = AppendString(&session->names, &session->nameCount, line + 5);
+        } else if (strncmp(line, "include ", 8) == 0) {
+            ok = AppendString(&session->includes, &session->includeCount, line + 8);
+        } else if (strncmp(line, "exclude ", 8) == 0) {
+            ok = AppendString(&session->excludes, &session->excludeCount, line + 8);
+        } else {
+            return FALSE;
+        }
+    }
+
+    // Out of memory: drop the partial union, so "filter end" falls back to
+    // accepting everything rather than installing half a filter
+    if (!ok) {
+        FreeUnion(g_Building);
+        g_Building = NULL;
+    }
+    return TRUE;
+}
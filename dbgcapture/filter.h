@@ -0,0 +1,30 @@
+/*
+ * filter.h - Native record filtering for dbgcapture
+ */
+
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <windows.h>
+
+// Apply one control-channel line. Lines between "filter begin" and
+// "filter end" describe the union of session filters:
+//
+//   filter begin
+//   session            start a session; later lines add constraints to it
+//   pid <n>            pid must be one of the listed PIDs
+//   name <literal>     process name must contain one of the literals
+//   include <literal>  text must contain one of the literals
+//   exclude <literal>  text must not contain any of the literals
+//   filter end         install atomically; no sessions means accept all
+//
+// Literals match ASCII case-insensitively. Excludes are only applied to
+// text that is ASCII or valid UTF-8. Returns FALSE for lines it
+// doesn't recognize. Called only from the control thread.
+BOOL FilterControlLine(const char* line);
+
+// TRUE if any session in the installed union accepts the record. Called
+// only from the thread that emits records.
+BOOL FilterAccepts(DWORD pid, const char* text, DWORD len);
+
+#endif
@@ -0,0 +1,171 @@
+/*
+ * jsonescape.c - JSON string escaping for dbgcapture
+ *
+ * Nearly all debug output is printable ASCII with nothing to escape, so the
+ * fast path scans 32 (AVX2) or 16 (SSE2) bytes at a time for '"', '\\' and
+ * control characters, stores clean spans with a single vector store, and
+ * only handles the hit bytes individually. Builds without SSE2 (e.g. ARM64)
+ * use the scalar loop.
+ */
+
+#include <string.h>
+#include "jsonescape.h"
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define JSONESCAPE_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(JSONESCAPE_SSE2) && defined(__AVX2__)
+#define JSONESCAPE_AVX2
+#include <immintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+static __inline unsigned LowestBit(unsigned mask) {
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (unsigned)index;
+}
+#else
+#define LowestBit(mask) ((unsigned)__builtin_ctz(mask))
+#endif
+
+// Writes the 6-byte \u00XX escape for a control character
+static size_t EscapeControl(char c, char* output) {
+    static const char hex[] = "0123456789abcdef";
+    memcpy(output, "\\u00", 4);
+    output[4] = hex[((unsigned char)c >> 4) & 0xF];
+    output[5] = hex[(unsigned char)c & 0xF];
+    return 6;
+}
+
+size_t JsonEscapeScalar(const char* input, size_t inputLen, char* output, size_t outputSize) {
+    size_t j = 0;
+    if (outputSize == 0) {
+        return 0;
+    }
+    // Bounds are written as j + N <= outputSize (N counting the NUL) so a
+    // nearly full output can't wrap them around
+    for (size_t i = 0; i < inputLen && input[i] && j + 2 <= outputSize; i++) {
+        char c = input[i];
+        switch (c) {
+            case '"':  if (j + 3 <= outputSize) { output[j++] = '\\'; output[j++] = '"'; } break;
+            case '\\': if (j + 3 <= outputSize) { output[j++] = '\\'; output[j++] = '\\'; } break;
+            case '\b': if (j + 3 <= outputSize) { output[j++] = '\\'; output[j++] = 'b'; } break;
+            case '\f': if (j + 3 <= outputSize) { output[j++] = '\\'; output[j++] = 'f'; } break;
+            case '\n': if (j + 3 <= outputSize) { output[j++] = '\\'; output[j++] = 'n'; } break;
+            case '\r': if (j + 3 <= outputSize) { output[j++] = '\\'; output[j++] = 'r'; } break;
+            case '\t': if (j + 3 <= outputSize) { output[j++] = '\\'; output[j++] = 't'; } break;
+            default:
+                if ((unsigned char)c >= 32) {
+                    output[j++] = c;
+                } else if (j + 7 <= outputSize) {
+                    j += EscapeControl(c, output + j);
+                }
+                break;
+        }
+    }
+    output[j] = '\0';
+    return j;
+}
+
+#ifdef JSONESCAPE_SSE2
+
+// Escape a single byte found by the vector scan. The caller guarantees room
+// for six output bytes. Returns FALSE on NUL, which ends the string.
+static __inline int EscapeHit(char c, char* output, size_t* j) {
+    static const char shortEscapes[32] = {
+        0, 0, 0, 0, 0, 0, 0, 0, 'b', 't', 'n', 0, 'f', 'r', 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+    };
+
+    if (c == '"' || c == '\\') {
+        output[(*j)++] = '\\';
+        output[(*j)++] = c;
+    } else if (c == '\0') {
+        return 0;
+    } else if (shortEscapes[(unsigned char)c]) {
+        output[(*j)++] = '\\';
+        output[(*j)++] = shortEscapes[(unsigned char)c];
+    } else {
+        *j += EscapeControl(c, output + *j);
+    }
+    return 1;
+}
+
+size_t JsonEscape(const char* input, size_t inputLen, char* output, size_t outputSize) {
+    size_t i = 0;
+    size_t j = 0;
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1F);
+
+#ifdef JSONESCAPE_AVX2
+    const __m256i quote32 = _mm256_set1_epi8('"');
+    const __m256i backslash32 = _mm256_set1_epi8('\\');
+    const __m256i control32 = _mm256_set1_epi8(0x1F);
+
+    // Each block may store 32 bytes and then escape one hit to six bytes,
+    // so stay far enough from the end that the scalar bounds never apply
+    while (i + 32 <= inputLen && j + 32 + 7 <= outputSize) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(input + i));
+        __m256i hits = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, quote32), _mm256_cmpeq_epi8(v, backslash32)),
+            _mm256_cmpeq_epi8(_mm256_max_epu8(v, control32), control32));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(hits);
+
+        _mm256_storeu_si256((__m256i*)(output + j), v);
+        if (mask == 0) {
+            i += 32;
+            j += 32;
+            continue;
+        }
+
+        // Keep the clean prefix already stored, then handle the hit itself
+        unsigned clean = LowestBit(mask);
+        j += clean;
+        if (!EscapeHit(input[i + clean], output, &j)) {
+            output[j] = '\0';
+            return j;
+        }
+        i += clean + 1;
+    }
+#endif
+
+    while (i + 16 <= inputLen && j + 16 + 7 <= outputSize) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(input + i));
+        __m128i hits = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)),
+            _mm_cmpeq_epi8(_mm_max_epu8(v, control), control));
+        unsigned mask = (unsigned)_mm_movemask_epi8(hits);
+
+        _mm_storeu_si128((__m128i*)(output + j), v);
+        if (mask == 0) {
+            i += 16;
+            j += 16;
+            continue;
+        }
+
+        unsigned clean = LowestBit(mask);
+        j += clean;
+        if (!EscapeHit(input[i + clean], output, &j)) {
+            output[j] = '\0';
+            return j;
+        }
+        i += clean + 1;
+    }
+
+    // Short tail, or close enough to the output limit that exact scalar
+    // truncation rules matter
+    return j + JsonEscapeScalar(input + i, inputLen - i, output + j, outputSize - j);
+}
+
+#else
+
+size_t JsonEscape(const char* input, size_t inputLen, char* output, size_t outputSize) {
+    return JsonEscapeScalar(input, inputLen, output, outputSize);
+}
+
+#endif
@@ -0,0 +1,19 @@
+/*
+ * jsonescape.h - JSON string escaping for dbgcapture
+ */
+
+#ifndef JSONESCAPE_H
+#define JSONESCAPE_H
+
+#include <stddef.h>
+
+// Escape up to inputLen bytes of input (stopping early at a NUL) into output
+// as the body of a JSON string. Output is NUL-terminated and never exceeds
+// outputSize bytes; returns the escaped length. Control characters without a
+// short JSON escape are written as \u00XX.
+size_t JsonEscape(const char* input, size_t inputLen, char* output, size_t outputSize);
+
+// Byte-at-a-time reference implementation with identical output
+size_t JsonEscapeScalar(const char* input, size_t inputLen, char* output, size_t outputSize);
+
+#endif
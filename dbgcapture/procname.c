@@ -0,0 +1,104 @@
+/*
+ * procname.c - Process name lookup for dbgcapture
+ *
+ * Names are resolved from a limited-query process handle and kept in a
+ * small direct-mapped cache keyed by PID, so chatty processes pay for
+ * OpenProcess once. Each entry keeps its process handle open, which stops
+ * Windows from handing the PID to a new process while the name is cached.
+ * Entries whose process has exited are released by a periodic sweep, after
+ * a grace period so records still queued from that process keep its name.
+ */
+
+#define WIN32_LEAN_AND_MEAN
+
+#include <windows.h>
+#include <string.h>
+#include "procname.h"
+
+#define PROCESS_CACHE_SIZE 1024
+#define SWEEP_INTERVAL_MS 1000
+
+typedef struct {
+    DWORD pid;
+    HANDLE hProcess;        // NULL if the entry is unused or lookup failed
+    BOOL valid;
+    BOOL exited;            // Seen exited by the last sweep
+    char name[MAX_PATH];
+} PROCESS_ENTRY;
+
+static PROCESS_ENTRY g_ProcessCache[PROCESS_CACHE_SIZE];
+static ULONGLONG g_NextSweep = 0;
+
+static void ReleaseEntry(PROCESS_ENTRY* entry) {
+    if (entry->hProcess) {
+        CloseHandle(entry->hProcess);
+        entry->hProcess = NULL;
+    }
+    entry->valid = FALSE;
+    entry->exited = FALSE;
+}
+
+// Fill the entry with the base name of the process image
+static void ResolveEntry(PROCESS_ENTRY* entry, DWORD pid) {
+    char path[MAX_PATH];
+    DWORD pathLen = sizeof(path);
+    const char* base;
+
+    entry->pid = pid;
+    entry->valid = TRUE;
+    entry->name[0] = '\0';
+
+    entry->hProcess = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION | SYNCHRONIZE, FALSE, pid);
+    if (!entry->hProcess) return;
+
+    if (!QueryFullProcessImageNameA(entry->hProcess, 0, path, &pathLen)) {
+        CloseHandle(entry->hProcess);
+        entry->hProcess = NULL;
+        return;
+    }
+
+    base = strrchr(path, '\\');
+    base = base ? base + 1 : path;
+    strncpy(entry->name, base, sizeof(entry->name) - 1);
+    entry->name[sizeof(entry->name) - 1] = '\0';
+}
+
+// Drop entries whose process had already exited at the previous sweep and
+// mark the ones that have exited since
+static void SweepExited(void) {
+    for (int i = 0; i < PROCESS_CACHE_SIZE; i++) {
+        PROCESS_ENTRY* entry = &g_ProcessCache[i];
+        if (!entry->valid) continue;
+
+        if (entry->exited || !entry->hProcess) {
+            // Failed lookups are retried too, in case access was denied
+            // only while the process was starting
+            ReleaseEntry(entry);
+        } else if (WaitForSingleObject(entry->hProcess, 0) == WAIT_OBJECT_0) {
+            entry->exited = TRUE;
+        }
+    }
+}
+
+const char* LookupProcessName(DWORD pid) {
+    // PIDs are multiples of 4
+    PROCESS_ENTRY* entry = &g_ProcessCache[(pid >> 2) & (PROCESS_CACHE_SIZE - 1)];
+    ULONGLONG now = GetTickCount64();
+
+    if (now >= g_NextSweep) {
+        SweepExited();
+        g_NextSweep = now + SWEEP_INTERVAL_MS;
+    }
+
+    if (!entry->valid || entry->pid != pid) {
+        ReleaseEntry(entry);
+        ResolveEntry(entry, pid);
+    }
+    return entry->name;
+}
+
+void UninitializeProcessNames(void) {
+    for (int i = 0; i < PROCESS_CACHE_SIZE; i++) {
+        ReleaseEntry(&g_ProcessCache[i]);
+    }
+}
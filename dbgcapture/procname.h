@@ -0,0 +1,18 @@
+/*
+ * procname.h - Process name lookup for dbgcapture
+ */
+
+#ifndef PROCNAME_H
+#define PROCNAME_H
+
+#include <windows.h>
+
+// Return the image file name (e.g. "notepad.exe") for a process, or "" if
+// it cannot be opened. The returned string stays valid until the next call.
+// Not thread-safe; only the thread that emits records calls it.
+const char* LookupProcessName(DWORD pid);
+
+// Close every cached process handle
+void UninitializeProcessNames(void);
+
+#endif
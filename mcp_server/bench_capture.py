@@ -0,0 +1,235 @@
+"""
+End-to-end benchmark of the capture pipeline.
+
+Runs dbgload.exe (build it with `nmake load` in dbgcapture/) against a live
+CaptureManager and measures how long each message takes from its
+OutputDebugString call returning to being returned by get_output, plus the
+throughput achieved and how many messages were lost. Both sides stamp with
+QueryPerformanceCounter, which is consistent across processes.
+
+Usage:
+    python bench_capture.py [--threads N] [--processes N] [--count N]
+                            [--rate N] [--size MIN[-MAX]] [--dist uniform|log]
+                            [--overflow POLICY] [--report FILE]
+
+Examples:
+    # Unthrottled, one writer
+    python bench_capture.py --count 100000
+
+    # 8 writer processes at 50k msg/s total, realistic line lengths
+    python bench_capture.py --processes 8 --rate 50000 --size 20-2000 --dist log
+
+The report is JSON (stdout, or --report FILE) with the load generator's
+summary, end-to-end latency percentiles, OutputDebugString call times,
+loss counts and a get_capture_stats snapshot taken at the end.
+"""
+
+import argparse
+import ctypes
+import json
+import os
+import re
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+from pathlib import Path
+
+# Add parent to path for importing
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+
+from dbgcapture_mcp.capture_manager import CaptureManager
+
+# dbgload.exe's --out record: writer, n, QPC before and after OutputDebugString
+LOAD_RECORD = struct.Struct("<IIQQ")
+
+MESSAGE = re.compile(r"\[LOAD (\d+)\] (\d+) (\d+) ")
+
+
+def qpc() -> int:
+    """Current QueryPerformanceCounter value."""
+    counter = ctypes.c_int64()
+    ctypes.windll.kernel32.QueryPerformanceCounter(ctypes.byref(counter))
+    return counter.value
+
+
+def find_dbgload() -> Path:
+    """Locate dbgload.exe next to dbgcapture.exe."""
+    here = Path(__file__).resolve().parent
+    for candidate in (here.parent / "dbgcapture" / "dbgload.exe", Path("dbgload.exe")):
+        if candidate.exists():
+            return candidate
+    sys.exit("dbgload.exe not found; build it with 'nmake load' in dbgcapture/")
+
+
+def percentiles(values: list[float]) -> dict:
+    """p50/p99/p999, mean and max of values, by nearest rank."""
+    if not values:
+        return {"count": 0}
+    values = sorted(values)
+
+    def rank(p: float) -> float:
+        return round(values[min(len(values) - 1, int(p * len(values)))], 1)
+
+    return {
+        "count": len(values),
+        "p50": rank(0.50),
+        "p99": rank(0.99),
+        "p999": rank(0.999),
+        "max": round(values[-1], 1),
+        "mean": round(sum(values) / len(values), 1)
+    }
+
+
+def collect(manager: CaptureManager, session_id: str, load: subprocess.Popen,
+            run: int, expected: int, batch: int, drain_ms: int) -> dict:
+    """
+    Read the session until every message has been seen, or the load
+    generator has exited and nothing new arrived for drain_ms.
+    Returns (writer, n) -> QPC when get_output returned it.
+    """
+    visible: dict[tuple[int, int], int] = {}
+    idle_since = None
+
+    while len(visible) < expected:
+        entries, _ = manager.get_output(session_id, limit=batch, wait_ms=100)
+        now = qpc()
+
+        for entry in entries:
+            match = MESSAGE.match(entry["text"])
+            if match and int(match.group(1)) == run:
+                visible.setdefault((int(match.group(2)), int(match.group(3))), now)
+
+        if entries or load.poll() is None:
+            idle_since = None
+        elif idle_since is None:
+            idle_since = time.monotonic()
+        elif (time.monotonic() - idle_since) * 1000 >= drain_ms:
+            break
+
+    return visible
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Measure capture throughput and latency with dbgload.exe",
+        formatter_class=argparse.RawDescriptionHelpFormatter
+    )
+    parser.add_argument("--threads", type=int, default=1,
+                        help="Writer threads per process (default: 1)")
+    parser.add_argument("--processes", type=int, default=1,
+                        help="Writer processes (default: 1)")
+    parser.add_argument("--count", type=int, default=10000,
+                        help="Messages per writer (default: 10000)")
+    parser.add_argument("--rate", type=float, default=0,
+                        help="Target total messages/sec (default: 0 = unthrottled)")
+    parser.add_argument("--size", default="64",
+                        help="Message length, MIN or MIN-MAX bytes (default: 64)")
+    parser.add_argument("--dist", choices=["uniform", "log"], default="uniform",
+                        help="Length distribution over the --size range (default: uniform)")
+    parser.add_argument("--overflow", choices=["block", "drop-oldest", "drop-newest"],
+                        default="drop-oldest",
+                        help="dbgcapture.exe ring overflow policy (default: drop-oldest)")
+    parser.add_argument("--batch", type=int, default=1000,
+                        help="get_output limit per call (default: 1000)")
+    parser.add_argument("--drain-ms", type=int, default=2000,
+                        help="How long to wait for stragglers after the load ends (default: 2000)")
+    parser.add_argument("--report", type=Path,
+                        help="Write the JSON report here instead of stdout")
+    args = parser.parse_args()
+
+    if sys.platform != "win32":
+        sys.exit("Error: This benchmark only works on Windows.")
+
+    dbgload = find_dbgload()
+    run = os.getpid()
+    writers = args.threads * args.processes
+    expected = writers * args.count
+
+    manager = CaptureManager()
+    manager.configure(overflow=args.overflow)
+    session_id = manager.create_session("bench")
+    manager.set_filters(session_id, include=[rf"^\[LOAD {run}\] "])
+    if not manager.is_running():
+        sys.exit("Error: dbgcapture.exe did not start")
+    # Let dbgcapture.exe create the DBWIN objects before the first message
+    time.sleep(0.5)
+
+    with tempfile.TemporaryDirectory() as tmp:
+        records_path = Path(tmp) / "records.bin"
+        load = subprocess.Popen(
+            [str(dbgload), "--run", str(run), "--threads", str(args.threads),
+             "--processes", str(args.processes), "--count", str(args.count),
+             "--rate", str(args.rate), "--size", args.size, "--dist", args.dist,
+             "--out", str(records_path)],
+            stdout=subprocess.PIPE,
+            text=True
+        )
+        visible = collect(manager, session_id, load, run, expected, args.batch, args.drain_ms)
+        summary_line, _ = load.communicate()
+        records = list(LOAD_RECORD.iter_unpack(records_path.read_bytes()))
+
+    stats = manager.get_capture_stats()
+    manager.destroy_session(session_id)
+    manager.stop_capture()
+
+    if load.returncode != 0:
+        sys.exit(f"Error: dbgload.exe exited with {load.returncode}")
+    summary = json.loads(summary_line)
+    to_us = 1e6 / summary["qpc_frequency"]
+
+    latencies = []
+    calls = []
+    early = 0
+    for writer, n, sent_qpc, return_qpc in records:
+        calls.append((return_qpc - sent_qpc) * to_us)
+        seen = visible.get((writer, n))
+        if seen is not None:
+            # The reader can beat the writer's own post-call timestamp
+            if seen < return_qpc:
+                early += 1
+            latencies.append(max(0, seen - return_qpc) * to_us)
+
+    received = len(latencies)
+    window = (max(visible.values()) - min(r[2] for r in records)) * to_us / 1e6 if received else 0
+    report = {
+        "config": {
+            "threads": args.threads,
+            "processes": args.processes,
+            "count": args.count,
+            "rate": args.rate,
+            "size": args.size,
+            "dist": args.dist,
+            "overflow": args.overflow,
+            "batch": args.batch
+        },
+        "load": summary,
+        "sent": len(records),
+        "received": received,
+        "lost": len(records) - received,
+        "received_per_sec": round(received / window, 1) if window > 0 else None,
+        "latency_us": percentiles(latencies),
+        "latency_early": early,
+        "call_us": percentiles(calls),
+        "capture_stats": stats
+    }
+
+    text = json.dumps(report, indent=2)
+    if args.report:
+        args.report.write_text(text + "\n")
+    else:
+        print(text)
+
+    latency = report["latency_us"]
+    print(
+        f"sent {report['sent']} at {summary['rate']:.0f}/s, received {received} "
+        f"({report['lost']} lost) at {report['received_per_sec'] or 0:.0f}/s; "
+        f"latency p50 {latency.get('p50')} us, p99 {latency.get('p99')} us, "
+        f"p999 {latency.get('p999')} us",
+        file=sys.stderr
+    )
+
+
+if __name__ == "__main__":
+    main()
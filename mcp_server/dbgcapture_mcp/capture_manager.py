@@ -1,8 +1,10 @@
 """
 Capture Manager - Manages the debug capture subprocess and ring buffer.
 
-Spawns dbgcapture.exe, reads JSON lines from stdout, stores entries in a
-ring buffer, and provides filtered views via sessions.
+Spawns dbgcapture.exe, reads binary frames (or JSON lines) from stdout,
+stores entries in a ring buffer, and provides filtered views via sessions.
+With a shared capture service, frames are read from a dbgcapture.exe
+--serve pipe instead, which every server on the machine attaches to.
 """
 
 import json
@@ -10,25 +12,39 @@ import os
 import re
 import subprocess
 import sys
+import tempfile
 import threading
 import time
 import uuid
+from array import array
+from bisect import bisect_left, bisect_right
+from collections import deque
 from dataclasses import dataclass, field
+from multiprocessing.connection import Client
 from pathlib import Path
 from typing import Optional
-from collections import deque
 
 import psutil
 
+from .entry_store import DEFAULT_MAX_BYTES, DebugEntry, EntryStore
+from .filter_pool import FilterPool, FilterSpec
+from .instrumentation import NativeStats, TimedLock
+from .patterns import PatternMatcher, literal_of, literals_of
+from .protocol import ANSI_ENCODING, FrameDecoder, frame_codepage, frame_repeat, split_payload
+from .spill_store import SpillStore, encode_entry
 
-@dataclass
-class DebugEntry:
-    """A single debug output entry."""
-    seq: int
-    time: int  # Windows FILETIME
-    pid: int
-    text: str
-    process_name: Optional[str] = None
+# Named pipe of a shared capture service, by service name
+SERVICE_PIPE_PREFIX = "\\\\.\\pipe\\"
+
+# How long start_capture waits for a capture service to accept us,
+# including starting one
+SERVICE_CONNECT_TIMEOUT = 5.0
+
+# How long start_capture waits for dbgcapture.exe's {"status": "started"}
+STARTUP_TIMEOUT = 10.0
+
+# Entries export_session reads and writes at a time
+EXPORT_BATCH = 4096
 
 
 @dataclass
@@ -38,33 +54,181 @@ class FilterSet:
     exclude_patterns: list[re.Pattern] = field(default_factory=list)
     process_names: list[re.Pattern] = field(default_factory=list)
     process_pids: list[int] = field(default_factory=list)
+    # Combined matchers, built from the lists on first use
+    _include: Optional[PatternMatcher] = field(default=None, init=False, repr=False, compare=False)
+    _exclude: Optional[PatternMatcher] = field(default=None, init=False, repr=False, compare=False)
+    _names: Optional[PatternMatcher] = field(default=None, init=False, repr=False, compare=False)
+    
+    @classmethod
+    def compile(
+        cls,
+        include: Optional[list[str]] = None,
+        exclude: Optional[list[str]] = None,
+        process_names: Optional[list[str]] = None,
+        process_pids: Optional[list[int]] = None
+    ) -> "FilterSet":
+        """Build a filter set from pattern strings; patterns ignore case."""
+        filters = cls()
+        if include:
+            filters.include_patterns = [re.compile(p, re.IGNORECASE) for p in include]
+        if exclude:
+            filters.exclude_patterns = [re.compile(p, re.IGNORECASE) for p in exclude]
+        if process_names:
+            filters.process_names = [re.compile(p, re.IGNORECASE) for p in process_names]
+        if process_pids:
+            filters.process_pids = process_pids
+        return filters
+    
+    def spec(self) -> FilterSpec:
+        """The pattern strings this set was compiled from, for compile()."""
+        return (
+            [p.pattern for p in self.include_patterns],
+            [p.pattern for p in self.exclude_patterns],
+            [p.pattern for p in self.process_names],
+            list(self.process_pids)
+        )
+    
+    def _compile(self):
+        self._include = PatternMatcher(self.include_patterns)
+        self._exclude = PatternMatcher(self.exclude_patterns)
+        self._names = PatternMatcher(self.process_names)
     
     def matches(self, entry: DebugEntry) -> bool:
         """Check if an entry matches this filter set."""
+        if self._include is None:
+            self._compile()
+        
         # Check process filters first
         if self.process_pids and entry.pid not in self.process_pids:
             return False
         
-        if self.process_names:
-            if not entry.process_name:
-                return False
-            name_match = any(p.search(entry.process_name) for p in self.process_names)
-            if not name_match:
+        if self._names:
+            if not entry.process_name or not self._names.search(entry.process_name):
                 return False
         
         # Check exclude patterns
-        for pattern in self.exclude_patterns:
-            if pattern.search(entry.text):
-                return False
+        if self._exclude and self._exclude.search(entry.text):
+            return False
         
         # Check include patterns (if any defined, at least one must match)
-        if self.include_patterns:
-            if not any(p.search(entry.text) for p in self.include_patterns):
-                return False
+        if self._include and not self._include.search(entry.text):
+            return False
         
         return True
 
 
+class MatchCache:
+    """
+    Sequence numbers of buffered entries that pass one FilterSet.
+    
+    Each entry is evaluated against the filters once, the first time the
+    session looks past it; later polls and status calls only read seqs.
+    Replaced wholesale when the session's filters change. Callers hold the
+    session's lock.
+    """
+    
+    def __init__(self, filters: FilterSet):
+        self.filters = filters
+        self.seqs = array("Q")
+        self.covered_to = -1  # Highest seq evaluated so far
+        self._pending_cursor = -1
+        self._pending_pos = 0
+    
+    def update(self, buffer: EntryStore) -> int:
+        """
+        Evaluate entries appended since the last update and drop evicted ones.
+        Returns the number of entries evaluated.
+        """
+        first_seq = buffer.first_seq
+        if first_seq is None:
+            return 0
+        self._evict(first_seq)
+        return self._evaluate(buffer, buffer.last_seq)
+    
+    def _evict(self, first_seq: int):
+        if self.seqs and self.seqs[0] < first_seq:
+            evicted = bisect_left(self.seqs, first_seq)
+            del self.seqs[:evicted]
+            self._pending_cursor = -1
+    
+    def _evaluate(self, buffer: EntryStore, last_seq: int) -> int:
+        """Evaluate entries after covered_to through last_seq."""
+        if last_seq <= self.covered_to:
+            return 0
+        
+        matches = self.filters.matches
+        evaluated = 0
+        for entry in buffer.iter_from(self.covered_to, last_seq):
+            evaluated += 1
+            if matches(entry):
+                self.seqs.append(entry.seq)
+        self.covered_to = last_seq
+        return evaluated
+    
+    def after(self, seq: int, limit: int) -> array:
+        """Matching seqs greater than seq, at most limit of them."""
+        start = bisect_right(self.seqs, seq)
+        return self.seqs[start:start + limit]
+    
+    def pending(self, cursor: int) -> int:
+        """Number of matching entries after cursor."""
+        # The cursor usually hasn't moved since the last call
+        if cursor != self._pending_cursor:
+            self._pending_pos = bisect_right(self.seqs, cursor)
+            self._pending_cursor = cursor
+        return len(self.seqs) - self._pending_pos
+
+
+class PooledMatchCache(MatchCache):
+    """
+    A MatchCache whose filters run in a FilterPool worker.
+    
+    Entries up to the pool's handoff seq are evaluated here on first use,
+    as in MatchCache; after that, each batch the worker finishes is queued
+    by the collector thread and folded in by add_results.
+    """
+    
+    def __init__(self, filters: FilterSet, pool: FilterPool):
+        super().__init__(filters)
+        self.pool = pool
+        # Set by FilterPool.set_filters
+        self.generation = 0
+        self.handoff = -1
+        # (last_seq, seqs, evaluated, ns) per batch, oldest first; appended
+        # by the collector thread without the session's lock
+        self.results: deque = deque()
+    
+    def update(self, buffer: EntryStore) -> int:
+        """Evaluate entries up to the handoff and drop evicted ones."""
+        first_seq = buffer.first_seq
+        if first_seq is None:
+            return 0
+        self._evict(first_seq)
+        return self._evaluate(buffer, min(buffer.last_seq, self.handoff))
+    
+    def add_results(self, first_seq: Optional[int]) -> tuple[int, int]:
+        """
+        Fold queued worker results into seqs, once the entries up to the
+        handoff have been evaluated here, and drop seqs evicted meanwhile.
+        Returns the (entries, ns) the worker spent on them.
+        """
+        evaluated = ns = 0
+        if self.covered_to < self.handoff:
+            return evaluated, ns
+        results = self.results
+        while results:
+            last_seq, seqs, count, elapsed = results.popleft()
+            if last_seq <= self.covered_to:
+                continue
+            self.seqs.extend(seqs)
+            self.covered_to = last_seq
+            evaluated += count
+            ns += elapsed
+        if first_seq is not None:
+            self._evict(first_seq)
+        return evaluated, ns
+
+
 @dataclass
 class Session:
     """A capture session with its own filters and read cursor."""
@@ -73,6 +237,12 @@ class Session:
     filters: FilterSet
     cursor: int  # Sequence number of last read entry
     created_at: float
+    matches: Optional[MatchCache] = None  # Built lazily for the current filters
+    missed: int = 0  # Entries evicted before the session read past them
+    missed_through: int = 0  # Highest seq counted in missed
+    evaluated: int = 0  # Entries run through the filters, and the time it took
+    filter_ns: int = 0
+    lock: threading.Lock = field(default_factory=threading.Lock, repr=False, compare=False)  # Guards matches
 
 
 class CaptureManager:
@@ -98,16 +268,41 @@ class CaptureManager:
             return
         
         self._initialized = True
-        self._buffer: deque[DebugEntry] = deque(maxlen=100000)  # 100K entries
-        self._buffer_lock = threading.Lock()
+        self._buffer = EntryStore(max_bytes=DEFAULT_MAX_BYTES)
+        # Serializes writers to _buffer; readers take published snapshots
+        # instead (see entry_store.py)
+        self._buffer_lock = TimedLock()
+        self._buffer_changed = threading.Condition()  # Notified after every publish
+        self._changes = 0  # Bumped under _buffer_changed before each notify
+        # Replaced, never mutated, so lookups need no lock; the lock
+        # serializes the writers
         self._sessions: dict[str, Session] = {}
-        self._sessions_lock = threading.Lock()
+        self._sessions_lock = TimedLock()
         self._process: Optional[subprocess.Popen] = None
         self._reader_thread: Optional[threading.Thread] = None
         self._running = False
-        self._process_cache: dict[int, str] = {}  # PID -> process name cache
-        self._cache_lock = threading.Lock()
         self._current_seq = 0
+        self._ingested = False  # Whether _current_seq is a published seq yet
+        self._binary = True  # Use --binary framing instead of JSON lines
+        self._global_capture = False
+        self._kernel_capture = False
+        self._control_lock = threading.Lock()  # Serializes filter pushes
+        self._native_filter_on = False  # Start dbgcapture.exe with --control
+        self._control = False  # Whether the running process reads filter pushes
+        self._spill: Optional[SpillStore] = None  # On-disk history, if enabled
+        self._overflow = "block"  # dbgcapture.exe --overflow policy
+        self._collapse_ms = 0  # dbgcapture.exe --collapse-ms, 0 = off
+        self._stderr_thread: Optional[threading.Thread] = None
+        self._native_stats = NativeStats()  # {"stats": ...} records from dbgcapture.exe
+        self._parsed = 0  # Entries decoded from stdout, and the time it took
+        self._parse_ns = 0
+        self._last_error: Optional[str] = None  # Latest {"error": ...} record
+        self._pool: Optional[FilterPool] = None  # Worker processes for session filters
+        self._shared: Optional[str] = None  # Capture service name, None = own process
+        self._start_lock = threading.Lock()  # Serializes start_capture
+        self._linger_ms = 0  # How long capture outlives the last session
+        self._linger_timer: Optional[threading.Timer] = None  # Pending stop, if lingering
+        self._service = None  # Connection to the capture service while attached
         
         # Find dbgcapture.exe
         self._capture_exe = self._find_capture_exe()
@@ -134,23 +329,288 @@ class CaptureManager:
         # Default - will fail at runtime if not found
         return candidates[0].resolve()
     
-    def _get_process_name(self, pid: int) -> Optional[str]:
-        """Get process name for a PID, with caching."""
-        with self._cache_lock:
-            if pid in self._process_cache:
-                return self._process_cache[pid]
+    def configure(
+        self,
+        global_capture: Optional[bool] = None,
+        kernel_capture: Optional[bool] = None,
+        buffer_bytes: Optional[int] = None,
+        spill_dir: Optional[Path] = None,
+        spill_bytes: Optional[int] = None,
+        index_bytes: Optional[int] = None,
+        overflow: Optional[str] = None,
+        filter_workers: Optional[int] = None,
+        collapse_ms: Optional[int] = None,
+        shared: Optional[str] = None,
+        linger_ms: Optional[int] = None,
+        hot_blocks: Optional[int] = None,
+        native_filter: Optional[bool] = None
+    ):
+        """
+        Set capture options.
         
-        try:
-            proc = psutil.Process(pid)
-            name = proc.name()
-            with self._cache_lock:
-                self._process_cache[pid] = name
-            return name
-        except (psutil.NoSuchProcess, psutil.AccessDenied):
-            return None
+        global_capture captures all sessions instead of the current one;
+        kernel_capture also captures kernel DbgPrint output via ETW. Both
+        require admin and apply the next time dbgcapture.exe is started.
+        buffer_bytes bounds the memory used by buffered entries and applies
+        immediately. spill_dir also logs every entry to segment files there,
+        keeping at most spill_bytes on disk, so get_output can reach back
+        past what memory holds. index_bytes caps the text index used by
+        search (0 disables it) and applies from the next indexed chunk.
+        overflow is what dbgcapture.exe does when its ring fills up: "block"
+        the programs writing output, or "drop-oldest" / "drop-newest"
+        messages; it applies the next time dbgcapture.exe is started.
+        filter_workers runs session filters in that many worker processes
+        instead of on the threads reading output (0, the default, keeps
+        them in-process) and applies immediately. collapse_ms has
+        dbgcapture.exe write each run of a process repeating the same message
+        as one entry with a repeat count, at most that many ms after the
+        first repeat (0 turns it off); it applies the next time
+        dbgcapture.exe is started. shared names a capture service to read
+        from instead of a process of our own ("" goes back to that); the
+        service is started with these options if it isn't running, and
+        otherwise keeps the ones it was started with. It applies the next
+        time capture starts. linger_ms keeps capture running that long after
+        the last session is destroyed (0, the default, stops it right away),
+        so a session created meanwhile skips the startup and the buffer
+        keeps what was written in between; it applies from the next time
+        the last session goes. hot_blocks compresses the text of buffered
+        blocks older than the newest hot_blocks (of 4096 entries each; 0
+        keeps everything uncompressed), so buffer_bytes holds more history.
+        native_filter pushes the union of session filters to dbgcapture.exe,
+        which then drops records no session accepts before they are piped
+        here. That saves work under heavy output, but those records are
+        never buffered, so query, search, summarize and widening a
+        session's filters can't see them. Off by default; it applies the
+        next time dbgcapture.exe is started.
+        """
+        if global_capture is not None:
+            self._global_capture = global_capture
+        if kernel_capture is not None:
+            self._kernel_capture = kernel_capture
+        if overflow is not None:
+            self._overflow = overflow
+        if collapse_ms is not None:
+            self._collapse_ms = collapse_ms
+        if shared is not None:
+            self._shared = shared or None
+        if linger_ms is not None:
+            self._linger_ms = linger_ms
+        if native_filter is not None:
+            self._native_filter_on = native_filter
+        if buffer_bytes is not None:
+            with self._buffer_lock:
+                self._buffer.max_bytes = buffer_bytes
+        if index_bytes is not None:
+            with self._buffer_lock:
+                self._buffer.index_max_bytes = index_bytes
+        if hot_blocks is not None:
+            with self._buffer_lock:
+                self._buffer.hot_blocks = hot_blocks
+        if spill_dir is not None:
+            if self._spill is not None:
+                self._spill.close()
+            self._spill = SpillStore(spill_dir, **({"max_bytes": spill_bytes} if spill_bytes else {}))
+        if filter_workers is not None:
+            self._start_pool(filter_workers)
+    
+    def _start_pool(self, workers: int):
+        """Replace the filter pool with one of workers processes, or none."""
+        old, self._pool = self._pool, None
+        if old is not None:
+            old.close()
+        if workers > 0:
+            self._pool = FilterPool(workers, self._pool_matches, self._pool_failed)
+        # Existing sessions move over with their current filters
+        for session in self._sessions.values():
+            with session.lock:
+                self._attach(session)
+    
+    def _attach(self, session: Session):
+        """
+        Point the session's match cache at the filter pool for its current
+        filters, or back in-process if there is no pool. Caller holds
+        session.lock.
+        """
+        pool = self._pool
+        if pool is None:
+            session.matches = None
+            return
+        # Installed first: the collector may have results for it as soon
+        # as the worker has the filters
+        matches = session.matches = PooledMatchCache(session.filters, pool)
+        pool.set_filters(session.id, session.filters.spec(), matches)
+    
+    def _pool_matches(self, session_id: str, generation: int, last_seq: int,
+                      seqs: array, evaluated: int, ns: int):
+        """Collector thread: queue a worker's results on the session."""
+        session = self._sessions.get(session_id)
+        if session is None:
+            return
+        matches = session.matches
+        if not isinstance(matches, PooledMatchCache) or matches.generation != generation:
+            return  # For filters that have since changed
+        matches.results.append((last_seq, seqs, evaluated, ns))
+        # Fold them in now unless a reader is busy with the session, in
+        # which case it does so before it lets go
+        if session.lock.acquire(blocking=False):
+            try:
+                if session.matches is matches:
+                    self._add_pool_results(session, matches)
+            finally:
+                session.lock.release()
+        self._notify()
+    
+    def _add_pool_results(self, session: Session, matches: PooledMatchCache):
+        """Caller holds session.lock."""
+        evaluated, ns = matches.add_results(self._buffer.first_seq)
+        session.evaluated += evaluated
+        session.filter_ns += ns
+    
+    def _pool_failed(self):
+        """A filter worker died: go back to evaluating in-process."""
+        self._pool = None  # Sessions notice in _session_matches
+        self._last_error = "filter worker exited; evaluating filters in-process"
+        self._notify()
+    
+    def _notify(self):
+        """Wake get_output calls waiting for the buffer or match caches to change."""
+        with self._buffer_changed:
+            self._changes += 1
+            self._buffer_changed.notify_all()
+    
+    def _ingest(self, entries: list[DebugEntry]):
+        """Publish entries read from dbgcapture.exe."""
+        if self._spill is not None:
+            self._spill.extend(entries)
+        with self._buffer_lock:
+            self._buffer.extend(entries)
+            self._current_seq = entries[-1].seq
+            self._ingested = True
+        self._notify()
+        # After publishing, so every seq a worker sees is already buffered
+        pool = self._pool
+        if pool is not None:
+            pool.feed(entries)
+    
+    def _seq_offset(self, first_seq: int) -> int:
+        """
+        What to add to the seqs of a new capture process or service
+        connection, whose first seq is first_seq.
+        
+        dbgcapture.exe numbers from 0 each time it starts, but the buffer,
+        spill log, match caches and session cursors all need seqs that only
+        rise, so a source that starts at or below what is already buffered
+        carries on from there instead.
+        """
+        if self._ingested and first_seq <= self._current_seq:
+            return self._current_seq + 1 - first_seq
+        return 0
     
     def _reader_loop(self):
         """Background thread that reads from dbgcapture.exe stdout."""
+        if self._binary or self._service is not None:
+            self._read_binary()
+        else:
+            self._read_json()
+    
+    def _read_binary(self):
+        """
+        Read binary frames, decoding each pipe chunk in one pass.
+        
+        Text is stored as the raw bytes from the pipe with a code page tag
+        and decoded only when something reads it.
+        """
+        decoder = FrameDecoder()
+        names: dict[bytes, str] = {}  # The few distinct process names, decoded once
+        offset = None  # From the first frame of this process or connection
+        while self._running:
+            try:
+                chunk = self._read_chunk()
+                if chunk is None:
+                    break
+                if not chunk:
+                    continue
+                
+                started = time.perf_counter_ns()
+                entries = []
+                for frame in decoder.feed(chunk):
+                    if offset is None:
+                        offset = self._seq_offset(frame.seq)
+                    mono, name, text = split_payload(frame)
+                    process_name = None
+                    if name:
+                        process_name = names.get(name)
+                        if process_name is None:
+                            process_name = names[name] = name.decode(ANSI_ENCODING, errors="replace")
+                    entry = DebugEntry(
+                        seq=frame.seq + offset,
+                        time=frame.time,
+                        pid=frame.pid,
+                        process_name=process_name,
+                        mono=mono,
+                        raw=text,
+                        codepage=frame_codepage(frame.flags)
+                    )
+                    repeat = frame_repeat(frame)
+                    if repeat is not None:
+                        entry.repeat, entry.first_time = repeat
+                    entries.append(entry)
+                if not entries:
+                    continue
+                self._parsed += len(entries)
+                self._parse_ns += time.perf_counter_ns() - started
+                self._ingest(entries)
+                    
+            except Exception:
+                if self._running:
+                    time.sleep(0.1)
+    
+    def _read_chunk(self) -> Optional[bytes]:
+        """Next chunk of binary output: b"" if none arrived yet, None once it has ended."""
+        service = self._service
+        if service is None:
+            process = self._process
+            if process is None or process.poll() is not None:
+                return None
+            return process.stdout.read1(65536)
+        
+        try:
+            # Each message is one flush of whole frames. Polling lets
+            # stop_capture end the thread before it closes the connection.
+            return service.recv_bytes() if service.poll(0.5) else b""
+        except (EOFError, OSError):
+            if self._running:
+                self._last_error = f"Capture service {self._shared} disconnected"
+            return None
+    
+    def _stderr_loop(self, process: subprocess.Popen, started: Optional[threading.Event] = None):
+        """
+        Background thread that reads status, error and stats records from
+        stderr. started is set on {"status": "started"}, or when stderr ends
+        without it.
+        """
+        try:
+            for line in process.stderr:
+                try:
+                    data = json.loads(line)
+                except ValueError:
+                    continue
+                if not isinstance(data, dict):
+                    continue
+                if isinstance(data.get("stats"), dict):
+                    self._native_stats.update(data["stats"])
+                elif "error" in data:
+                    self._last_error = str(data["error"])
+                elif data.get("status") == "started" and started is not None:
+                    started.set()
+        except (OSError, ValueError):
+            pass  # Pipe closed
+        if started is not None:
+            started.set()
+    
+    def _read_json(self):
+        """Read JSON lines, one record per line."""
+        offset = None  # As in _read_binary
         while self._running:
             process = self._process
             if process is None or process.poll() is not None:
@@ -165,18 +625,23 @@ class CaptureManager:
                     continue
                 
                 try:
+                    started = time.perf_counter_ns()
                     data = json.loads(line)
+                    if offset is None:
+                        offset = self._seq_offset(data["seq"])
                     entry = DebugEntry(
-                        seq=data["seq"],
+                        seq=data["seq"] + offset,
                         time=data["time"],
                         pid=data["pid"],
                         text=data["text"],
-                        process_name=self._get_process_name(data["pid"])
+                        process_name=data.get("name") or None,
+                        mono=data.get("mono"),
+                        repeat=data.get("repeat", 1),
+                        first_time=data.get("first_time")
                     )
-                    
-                    with self._buffer_lock:
-                        self._buffer.append(entry)
-                        self._current_seq = entry.seq
+                    self._parsed += 1
+                    self._parse_ns += time.perf_counter_ns() - started
+                    self._ingest([entry])
                         
                 except (json.JSONDecodeError, KeyError):
                     # Skip malformed lines
@@ -186,40 +651,151 @@ class CaptureManager:
                 if self._running:
                     time.sleep(0.1)
     
+    def _capture_args(self, global_capture: bool) -> list[str]:
+        """dbgcapture.exe options for the current configuration, without the format."""
+        # Async mode keeps pipe I/O off the thread that holds DBWIN_BUFFER, so
+        # a slow reader here never stalls OutputDebugString callers. Process
+        # names come from dbgcapture.exe, which also knows when a PID is reused.
+        # The monotonic clock orders bursts that share a wall clock tick.
+        args = [str(self._capture_exe), "--async", "--names", "--mono", "--overflow", self._overflow]
+        if global_capture or self._global_capture:
+            # Global\ objects only see session 0 and other sessions' services;
+            # --local keeps this session's programs on the same pipe and seq
+            args.extend(["--global", "--local"])
+        if self._kernel_capture:
+            args.append("--etw")
+        if self._collapse_ms > 0:
+            args.extend(["--collapse-ms", str(self._collapse_ms)])
+        return args
+    
+    def _service_address(self) -> str:
+        return SERVICE_PIPE_PREFIX + self._shared
+    
+    def _connect_service(self, global_capture: bool):
+        """
+        Connect to the shared capture service, starting it if nobody has.
+        
+        The service is a dbgcapture.exe --serve that outlives this server
+        while other servers read from it, and exits after the last one
+        disconnects. It has no control channel, since each reader wants
+        different output, so filtering here stays entirely in-process.
+        """
+        deadline = time.monotonic() + SERVICE_CONNECT_TIMEOUT
+        service = None
+        while True:
+            try:
+                return Client(self._service_address())
+            except OSError as e:
+                if time.monotonic() >= deadline:
+                    raise RuntimeError(f"Failed to connect to capture service {self._shared}: {e}")
+            
+            if service is None:
+                # If another server starts it at the same time, one of the
+                # two fails to claim the pipe and the other is connected to
+                if not self._capture_exe.exists():
+                    raise FileNotFoundError(f"dbgcapture.exe not found at {self._capture_exe}")
+                args = self._capture_args(global_capture) + ["--binary", "--serve", self._shared]
+                service = subprocess.Popen(
+                    args,
+                    stdin=subprocess.DEVNULL,
+                    stdout=subprocess.DEVNULL,
+                    stderr=subprocess.DEVNULL,
+                    creationflags=(subprocess.CREATE_NO_WINDOW | subprocess.CREATE_NEW_PROCESS_GROUP)
+                                  if sys.platform == "win32" else 0
+                )
+            time.sleep(0.05)
+    
     def start_capture(self, global_capture: bool = False) -> bool:
-        """Start the capture subprocess if not already running."""
-        if self._process is not None and self._process.poll() is None:
+        """
+        Start the capture subprocess, or attach to the capture service, if
+        not already running. Returns once capture is live, so output written
+        after that is captured.
+        """
+        with self._start_lock:
+            return self._start_capture(global_capture)
+    
+    def _start_capture(self, global_capture: bool) -> bool:
+        if self.is_running():
             return True  # Already running
         
+        if self._shared:
+            if self._service is not None:
+                self._service.close()  # The service it was reading from has gone
+            self._service = self._connect_service(global_capture)
+            self._running = True
+            self._native_stats = NativeStats()
+            self._last_error = None
+            self._reader_thread = threading.Thread(target=self._reader_loop, daemon=True)
+            self._reader_thread.start()
+            return True
+        
         if not self._capture_exe.exists():
             raise FileNotFoundError(f"dbgcapture.exe not found at {self._capture_exe}")
         
-        args = [str(self._capture_exe)]
-        if global_capture:
-            args.append("--global")
+        args = self._capture_args(global_capture)
+        if self._native_filter_on:
+            args.append("--control")
+        if self._binary:
+            args.append("--binary")
         
         try:
             self._process = subprocess.Popen(
                 args,
+                stdin=subprocess.PIPE,
                 stdout=subprocess.PIPE,
                 stderr=subprocess.PIPE,
-                text=True,
-                bufsize=1,
+                text=not self._binary,
+                # JSON records are always UTF-8, whatever the console code page
+                encoding=None if self._binary else "utf-8",
+                errors=None if self._binary else "replace",
+                bufsize=-1 if self._binary else 1,
                 creationflags=subprocess.CREATE_NO_WINDOW if sys.platform == "win32" else 0
             )
             
             self._running = True
+            self._control = self._native_filter_on
+            self._native_stats = NativeStats()
+            self._last_error = None
             self._reader_thread = threading.Thread(target=self._reader_loop, daemon=True)
             self._reader_thread.start()
+            # An unread stderr pipe would eventually block dbgcapture.exe
+            started = threading.Event()
+            self._stderr_thread = threading.Thread(target=self._stderr_loop, args=(self._process, started),
+                                                   daemon=True)
+            self._stderr_thread.start()
             
-            return True
+            # Sessions that outlived a previous process keep their filters
+            self._push_native_filter()
             
         except Exception as e:
             raise RuntimeError(f"Failed to start capture: {e}")
+        
+        # dbgcapture.exe reports "started" once it is waiting on DBWIN, and
+        # the service only accepts readers from then on
+        if not started.wait(STARTUP_TIMEOUT):
+            # Nothing written meanwhile is known to be captured
+            self._last_error = f"dbgcapture.exe did not report starting within {STARTUP_TIMEOUT:g}s"
+            self.stop_capture()
+            raise RuntimeError(f"Failed to start capture: {self._last_error}")
+        if self._process.poll() is not None:
+            error = self._last_error or f"exit code {self._process.returncode}"
+            self.stop_capture()
+            raise RuntimeError(f"Failed to start capture: {error}")
+        return True
     
     def stop_capture(self):
         """Stop the capture subprocess."""
         self._running = False
+        self._notify()  # Release waiting get_output calls
+        
+        if self._service is not None:
+            # Disconnecting is enough; the service exits after its last reader
+            if self._reader_thread:
+                self._reader_thread.join(timeout=2)
+                self._reader_thread = None
+            self._service.close()
+            self._service = None
+            return
         
         if self._process:
             try:
@@ -235,15 +811,25 @@ class CaptureManager:
         if self._reader_thread:
             self._reader_thread.join(timeout=2)
             self._reader_thread = None
+        if self._stderr_thread:
+            self._stderr_thread.join(timeout=2)
+            self._stderr_thread = None
     
     def is_running(self) -> bool:
         """Check if capture is currently running."""
+        if self._service is not None:
+            return self._reader_thread is not None and self._reader_thread.is_alive()
         return self._process is not None and self._process.poll() is None
     
     def create_session(self, name: Optional[str] = None) -> str:
         """Create a new capture session."""
-        # Start capture if this is the first session
+        # Start capture if this is the first session; it may still be
+        # running from the last one
         if not self._sessions:
+            with self._sessions_lock:
+                if self._linger_timer is not None:
+                    self._linger_timer.cancel()
+                    self._linger_timer = None
             self.start_capture()
         
         session_id = str(uuid.uuid4())[:8]
@@ -256,8 +842,13 @@ class CaptureManager:
         )
         
         with self._sessions_lock:
-            self._sessions[session_id] = session
+            self._sessions = {**self._sessions, session_id: session}
+        if self._pool is not None:
+            with session.lock:
+                self._attach(session)
         
+        # A new session has no filters, so nothing may be dropped natively
+        self._push_native_filter()
         return session_id
     
     def destroy_session(self, session_id: str) -> bool:
@@ -265,18 +856,55 @@ class CaptureManager:
         with self._sessions_lock:
             if session_id not in self._sessions:
                 return False
-            del self._sessions[session_id]
+            sessions = dict(self._sessions)
+            del sessions[session_id]
+            self._sessions = sessions
             
-            # Stop capture if no sessions left
-            if not self._sessions:
-                self.stop_capture()
+            idle = not self._sessions
+            linger = idle and self._linger_ms > 0
+            if linger:
+                self._start_linger()
+        
+        pool = self._pool
+        if pool is not None:
+            pool.remove(session_id)
+        self._notify()  # Its waiting get_output calls return
         
+        # Stop capture if no sessions left. Outside _sessions_lock, since
+        # stopping joins threads for seconds and create_session would wait.
+        if not idle:
+            self._push_native_filter()
+        elif not linger:
+            self._stop_if_idle()
         return True
     
+    def _start_linger(self):
+        """Stop capture after linger_ms unless a session is created first. Caller holds _sessions_lock."""
+        timer = threading.Timer(self._linger_ms / 1000, self._linger_expired)
+        timer.daemon = True
+        timer.args = (timer,)
+        self._linger_timer = timer
+        timer.start()
+    
+    def _linger_expired(self, timer: threading.Timer):
+        with self._sessions_lock:
+            # create_session clears _linger_timer before starting capture
+            if self._linger_timer is not timer or self._sessions:
+                return
+            self._linger_timer = None
+        self._stop_if_idle()
+    
+    def _stop_if_idle(self):
+        """stop_capture, unless a session has been created since it was decided to."""
+        # create_session starts capture under _start_lock before it adds
+        # the session, so a start can't be undone by a stop already queued
+        with self._start_lock:
+            if not self._sessions:
+                self.stop_capture()
+    
     def get_session(self, session_id: str) -> Optional[Session]:
         """Get a session by ID."""
-        with self._sessions_lock:
-            return self._sessions.get(session_id)
+        return self._sessions.get(session_id)
     
     def set_filters(
         self,
@@ -291,34 +919,66 @@ class CaptureManager:
         if not session:
             return False
         
-        filters = FilterSet()
-        
-        if include:
-            filters.include_patterns = [re.compile(p, re.IGNORECASE) for p in include]
+        filters = FilterSet.compile(include, exclude, process_names, process_pids)
         
-        if exclude:
-            filters.exclude_patterns = [re.compile(p, re.IGNORECASE) for p in exclude]
-        
-        if process_names:
-            filters.process_names = [re.compile(p, re.IGNORECASE) for p in process_names]
+        with session.lock:
+            session.filters = filters
+            self._attach(session)
+        self._push_native_filter()
+        return True
+    
+    def _native_filter(self) -> list[str]:
+        """
+        Control commands describing the union of all session filters.
         
-        if process_pids:
-            filters.process_pids = process_pids
+        dbgcapture.exe only understands PIDs and literal substrings, so each
+        session's filter is widened to fit: a non-literal include or name
+        pattern drops that constraint, and non-literal excludes are left
+        out. Whatever passes natively is still checked exactly here.
+        """
+        filters = [session.filters for session in self._sessions.values()]
         
-        session.filters = filters
-        return True
+        lines = ["filter begin"]
+        for f in filters:
+            lines.append("session")
+            lines.extend(f"pid {pid}" for pid in f.process_pids)
+            lines.extend(f"name {name}" for name in literals_of(f.process_names) or [])
+            lines.extend(f"include {text}" for text in literals_of(f.include_patterns) or [])
+            for pattern in f.exclude_patterns:
+                literal = literal_of(pattern.pattern)
+                if literal is not None:
+                    lines.append(f"exclude {literal}")
+        lines.append("filter end")
+        return lines
+    
+    def _push_native_filter(self):
+        """Send the current filter union to dbgcapture.exe, if it was started with --control."""
+        with self._control_lock:
+            process = self._process
+            if process is None or process.stdin is None or not self._control:
+                return
+            
+            payload = "\n".join(self._native_filter()) + "\n"
+            try:
+                process.stdin.write(payload.encode("ascii") if self._binary else payload)
+                process.stdin.flush()
+            except (OSError, ValueError):
+                # Process is exiting; the reader notices on its own
+                pass
     
     def get_output(
         self,
         session_id: str,
         limit: int = 100,
-        since_seq: Optional[int] = None
+        since_seq: Optional[int] = None,
+        wait_ms: int = 0
     ) -> tuple[list[dict], int]:
         """
         Get filtered output for a session.
         
         Returns (entries, next_seq) where next_seq should be passed as since_seq
-        in the next call to get new entries only.
+        in the next call to get new entries only. With wait_ms, an empty result
+        waits up to that long and returns as soon as a matching entry arrives.
         """
         session = self.get_session(session_id)
         if not session:
@@ -326,36 +986,326 @@ class CaptureManager:
         
         start_seq = since_seq if since_seq is not None else session.cursor
         results = []
-        max_seq = start_seq
+        self._count_missed(session, start_seq)
         
-        with self._buffer_lock:
-            for entry in self._buffer:
-                if entry.seq <= start_seq:
-                    continue
-                
-                if session.filters.matches(entry):
-                    results.append({
-                        "seq": entry.seq,
-                        "time": entry.time,
-                        "pid": entry.pid,
-                        "process_name": entry.process_name,
-                        "text": entry.text
-                    })
-                    
-                    if len(results) >= limit:
-                        max_seq = entry.seq
-                        break
-                
-                max_seq = entry.seq
+        # Entries older than memory holds come from the spill log
+        spilled = self._read_spilled(session, start_seq, limit, results)
+        if spilled is not None:
+            start_seq, reached_memory = spilled
+            # Continue into memory only if the disk scan got all the way there
+            limit = limit - len(results) if reached_memory else 0
+            if results:
+                wait_ms = 0
+        
+        max_seq = start_seq
+        if limit > 0:
+            seqs, covered_to = self._wait_for_matches(session, start_seq, limit, wait_ms)
+            for seq in seqs:
+                # None if evicted since it matched; _count_missed counts it
+                entry = self._buffer.get(seq)
+                if entry is not None:
+                    results.append(self._entry_dict(entry))
+            max_seq = max(covered_to, max_seq)
         
         # Update session cursor
         if results:
             session.cursor = results[-1]["seq"]
+        elif spilled is not None and not spilled[1]:
+            session.cursor = start_seq  # Resume the disk scan from here
         elif max_seq > session.cursor:
             session.cursor = max_seq
         
         return results, session.cursor
     
+    def query(
+        self,
+        pids: Optional[list[int]] = None,
+        start_time: Optional[int] = None,
+        end_time: Optional[int] = None,
+        session_id: Optional[str] = None,
+        limit: int = 100,
+        since_seq: Optional[int] = None
+    ) -> Optional[tuple[list[dict], int]]:
+        """
+        Buffered entries by PID and/or time range, through the buffer's
+        indexes rather than a full scan.
+        
+        With session_id the session's filters apply too (None if there is
+        no such session). Session cursors are not touched. Returns
+        (entries, next_seq); pass next_seq as since_seq for the next page.
+        """
+        matches = None
+        if session_id is not None:
+            session = self.get_session(session_id)
+            if not session:
+                return None
+            matches = session.filters.matches
+        
+        results = []
+        next_seq = self._buffer.last_seq
+        for entry in self._buffer.query(pids, start_time, end_time, since_seq):
+            if next_seq is not None and entry.seq > next_seq:
+                break  # Published after the query started
+            if matches is None or matches(entry):
+                results.append(self._entry_dict(entry))
+                if len(results) >= limit:
+                    return results, entry.seq
+        
+        if next_seq is None:
+            next_seq = since_seq or 0
+        return results, next_seq
+    
+    def search(
+        self,
+        pattern: str,
+        case_sensitive: bool = False,
+        pids: Optional[list[int]] = None,
+        session_id: Optional[str] = None,
+        limit: int = 100,
+        since_seq: Optional[int] = None
+    ) -> Optional[tuple[list[dict], int]]:
+        """
+        Buffered entries whose text matches a regex, narrowed by the
+        buffer's text index before the regex runs.
+        
+        Paging, session_id and the return value work as in query().
+        """
+        matches = None
+        if session_id is not None:
+            session = self.get_session(session_id)
+            if not session:
+                return None
+            matches = session.filters.matches
+        regex = re.compile(pattern, 0 if case_sensitive else re.IGNORECASE)
+        
+        results = []
+        next_seq = self._buffer.last_seq
+        for entry in self._buffer.search(regex, pids, since_seq):
+            if next_seq is not None and entry.seq > next_seq:
+                break  # Published after the search started
+            if matches is None or matches(entry):
+                results.append(self._entry_dict(entry))
+                if len(results) >= limit:
+                    return results, entry.seq
+        
+        if next_seq is None:
+            next_seq = since_seq or 0
+        return results, next_seq
+    
+    def summarize(
+        self,
+        pids: Optional[list[int]] = None,
+        start_time: Optional[int] = None,
+        end_time: Optional[int] = None,
+        session_id: Optional[str] = None,
+        group_by: str = "pid",
+        top: int = 10
+    ) -> Optional[dict]:
+        """
+        Counts, rates and the most frequent message templates over buffered
+        entries, instead of the entries themselves.
+        
+        pids, the time range and session_id select entries as in query()
+        (None if there is no such session); a session's filters are not
+        re-run, its match cache is used. Session cursors are not touched.
+        """
+        seqs = None
+        if session_id is not None:
+            session = self.get_session(session_id)
+            if not session:
+                return None
+            with session.lock:
+                seqs = self._session_matches(session).seqs[:]
+        
+        return self._buffer.summarize(pids, start_time, end_time, seqs, group_by, top)
+    
+    def export_session(
+        self,
+        session_id: str,
+        path: Optional[str] = None,
+        since_seq: Optional[int] = None
+    ) -> Optional[dict]:
+        """
+        Write the entries matching a session's filters to a file of binary
+        frames, the same stream dbgcapture.exe --binary writes, readable
+        with protocol.FrameDecoder.
+        
+        Covers matches after since_seq (all of them if None), older ones
+        from the spill log, up to what had been captured when the export
+        started. Entries are read and written EXPORT_BATCH at a time
+        without holding any buffer lock, so capture carries on meanwhile.
+        The file (by default a new one in the temp directory) is written
+        under a .partial name and renamed once complete. An existing file
+        is never overwritten: FileExistsError is raised instead. Session
+        cursors are not touched. Returns {"path", "rows"}, or None if there
+        is no such session.
+        """
+        session = self.get_session(session_id)
+        if not session:
+            return None
+        with session.lock:
+            seqs = self._session_matches(session).seqs[:]
+            filters = session.filters
+        # Matches the snapshot is missing because they left memory are on disk
+        first_in_memory = self._buffer.first_seq
+        start_seq = since_seq or 0
+        
+        if path is None:
+            stamp = time.strftime("%Y%m%d-%H%M%S")
+            unique = uuid.uuid4().hex[:6]
+            target = Path(tempfile.gettempdir()) / f"dbgcapture-{session.id}-{stamp}-{unique}.bin"
+        else:
+            target = Path(path)
+        partial = target.with_name(target.name + ".partial")
+        
+        # Claim the name first, so a file created while exporting isn't
+        # replaced either; the rename then only replaces this placeholder
+        open(target, "xb").close()
+        rows = 0
+        try:
+            with open(partial, "wb") as out:
+                if (self._spill is not None and first_in_memory is not None
+                        and start_seq + 1 < first_in_memory):
+                    scanned_to = start_seq
+                    while scanned_to < first_in_memory - 1:
+                        entries, scanned_to = self._spill.read(
+                            scanned_to, filters.matches, EXPORT_BATCH, stop_seq=first_in_memory
+                        )
+                        out.write(b"".join(encode_entry(entry) for entry in entries))
+                        rows += len(entries)
+                    start_seq = first_in_memory - 1
+                
+                for i in range(bisect_right(seqs, start_seq), len(seqs), EXPORT_BATCH):
+                    # Entries evicted since the snapshot come back as None
+                    entries = [entry for entry in map(self._buffer.get, seqs[i:i + EXPORT_BATCH])
+                               if entry is not None]
+                    out.write(b"".join(encode_entry(entry) for entry in entries))
+                    rows += len(entries)
+            os.replace(partial, target)
+        except BaseException:
+            partial.unlink(missing_ok=True)
+            target.unlink(missing_ok=True)
+            raise
+        
+        return {"path": str(target), "rows": rows}
+    
+    @staticmethod
+    def _entry_dict(entry: DebugEntry) -> dict:
+        result = {
+            "seq": entry.seq,
+            "time": entry.time,
+            "pid": entry.pid,
+            "process_name": entry.process_name,
+            "mono": entry.mono,
+            "text": entry.text
+        }
+        if entry.repeat > 1:
+            # A run of identical messages collapsed by dbgcapture.exe
+            result["repeat"] = entry.repeat
+            result["first_time"] = entry.first_time
+        return result
+    
+    def _read_spilled(
+        self,
+        session: Session,
+        start_seq: int,
+        limit: int,
+        results: list[dict]
+    ) -> Optional[tuple[int, bool]]:
+        """
+        Append matching spilled entries older than the memory buffer.
+        
+        Returns None if start_seq is within memory (or spilling is off),
+        else (seq examined up to, whether the scan reached memory).
+        """
+        if self._spill is None:
+            return None
+        first_in_memory = self._buffer.first_seq
+        if first_in_memory is None or start_seq + 1 >= first_in_memory:
+            return None
+        
+        entries, scanned_to = self._spill.read(
+            start_seq, session.filters.matches, limit, stop_seq=first_in_memory
+        )
+        results.extend(self._entry_dict(entry) for entry in entries)
+        return scanned_to, scanned_to >= first_in_memory - 1
+    
+    def _count_missed(self, session: Session, start_seq: int):
+        """Add entries evicted from memory and disk before the session read them to session.missed."""
+        oldest = self._buffer.first_seq
+        if self._spill is not None:
+            spilled = self._spill.first_seq
+            if spilled is not None and (oldest is None or spilled < oldest):
+                oldest = spilled
+        if oldest is None:
+            return
+        
+        start = max(start_seq, session.missed_through)
+        if oldest - 1 > start:
+            session.missed += oldest - 1 - start
+            session.missed_through = oldest - 1
+    
+    def wait_for_output(self, session_id: str, wait_ms: int) -> Optional[bool]:
+        """
+        Wait up to wait_ms for the session to have unread matching output.
+        
+        Returns whether it does, or None if the session doesn't exist.
+        """
+        session = self.get_session(session_id)
+        if not session:
+            return None
+        
+        seqs, _ = self._wait_for_matches(session, session.cursor, 1, wait_ms)
+        return bool(seqs)
+    
+    def _wait_for_matches(
+        self,
+        session: Session,
+        start_seq: int,
+        limit: int,
+        wait_ms: int
+    ) -> tuple[array, int]:
+        """
+        Matching seqs after start_seq, waiting up to wait_ms for the first,
+        and the seq the session's filters have been evaluated through.
+        
+        Stops waiting early if capture stops or the session is destroyed.
+        """
+        deadline = time.monotonic() + wait_ms / 1000
+        while True:
+            changes = self._changes
+            with session.lock:
+                matches = self._session_matches(session)
+                seqs = matches.after(start_seq, limit)
+                covered_to = matches.covered_to
+            if seqs or not self._running or session.id not in self._sessions:
+                return seqs, covered_to
+            remaining = deadline - time.monotonic()
+            if remaining <= 0:
+                return seqs, covered_to
+            with self._buffer_changed:
+                # Writers publish before they bump the count, so checking it
+                # under the lock can't miss a wakeup
+                if (self._changes == changes and self._running
+                        and session.id in self._sessions):
+                    self._buffer_changed.wait(remaining)
+    
+    def _session_matches(self, session: Session) -> MatchCache:
+        """Bring the session's match cache up to date. Caller holds session.lock."""
+        matches = session.matches
+        if (matches is None or matches.filters is not session.filters
+                or isinstance(matches, PooledMatchCache) and matches.pool is not self._pool):
+            matches = MatchCache(session.filters)
+            session.matches = matches
+        started = time.perf_counter_ns()
+        evaluated = matches.update(self._buffer)
+        if evaluated:
+            session.evaluated += evaluated
+            session.filter_ns += time.perf_counter_ns() - started
+        if isinstance(matches, PooledMatchCache):
+            self._add_pool_results(session, matches)
+        return matches
+    
     def clear_session(self, session_id: str) -> bool:
         """Reset session cursor to current position (skip all pending)."""
         session = self.get_session(session_id)
@@ -371,13 +1321,9 @@ class CaptureManager:
         if not session:
             return None
         
-        # Count pending entries
-        pending = 0
-        with self._buffer_lock:
-            for entry in self._buffer:
-                if entry.seq > session.cursor:
-                    if session.filters.matches(entry):
-                        pending += 1
+        self._count_missed(session, session.cursor)
+        with session.lock:
+            pending = self._session_matches(session).pending(session.cursor)
         
         return {
             "session_id": session.id,
@@ -391,7 +1337,77 @@ class CaptureManager:
             "cursor": session.cursor,
             "pending_count": pending,
             "capture_running": self.is_running(),
-            "total_buffered": len(self._buffer)
+            "total_buffered": len(self._buffer),
+            "buffered_bytes": self._buffer.nbytes,
+            "missed": session.missed,
+            "buffer_evicted": self._buffer.evicted,
+            "capture": {
+                "overflow": self._overflow,
+                "dropped": self._native_stats.get("dropped"),
+                "blocked": self._native_stats.get("blocked"),
+                "blocked_ms": self._native_stats.get("blocked_ms"),
+                "last_error": self._last_error
+            }
+        }
+    
+    def get_capture_stats(self) -> dict:
+        """
+        Throughput and latency counters for each stage of the pipeline.
+        
+        "native" comes from dbgcapture.exe's latest stats record, with rates
+        over the interval before it; the rest is measured here.
+        """
+        sessions = list(self._sessions.values())
+        buffer = {
+            "entries": len(self._buffer),
+            "bytes": self._buffer.nbytes,
+            "evicted": self._buffer.evicted,
+            "index_bytes": self._buffer.index_nbytes,
+            "cold_blocks": self._buffer.cold_blocks,
+            "cold_ratio": self._buffer.cold_ratio
+        }
+        
+        def avg_us(ns: int, count: int) -> Optional[float]:
+            return round(ns / count / 1000, 3) if count else None
+        
+        pool = self._pool
+        filter_pool = None
+        if pool is not None:
+            filter_pool = {
+                "workers": pool.workers,
+                "batches": pool.batches,
+                "entries": pool.entries,
+                "feed_ms": round(pool.feed_ns / 1e6, 3),
+                "feed_avg_us": avg_us(pool.feed_ns, pool.entries)
+            }
+        
+        return {
+            "capture_running": self.is_running(),
+            "lingering": self._linger_timer is not None,
+            "shared": self._shared,
+            "native": self._native_stats.snapshot(),
+            "reader": {
+                "entries": self._parsed,
+                "parse_ms": round(self._parse_ns / 1e6, 3),
+                "parse_avg_us": avg_us(self._parse_ns, self._parsed)
+            },
+            "locks": {
+                "buffer": self._buffer_lock.snapshot(),
+                "sessions": self._sessions_lock.snapshot()
+            },
+            "buffer": buffer,
+            "filter_pool": filter_pool,
+            "sessions": [
+                {
+                    "session_id": s.id,
+                    "name": s.name,
+                    "pooled": isinstance(s.matches, PooledMatchCache),
+                    "evaluated": s.evaluated,
+                    "filter_ms": round(s.filter_ns / 1e6, 3),
+                    "filter_avg_us": avg_us(s.filter_ns, s.evaluated)
+                }
+                for s in sessions
+            ]
         }
     
     def list_processes(self, name_pattern: Optional[str] = None) -> list[dict]:
@@ -0,0 +1,747 @@
+"""
+Entry Store - Columnar, memory-bounded ring buffer for captured entries.
+
+Entries are kept in fixed-size blocks of parallel arrays (seq, time,
+monotonic time, pid, process-name id, code page) plus one arena of raw text
+bytes per block, instead of one Python object per entry. Text is decoded
+when an entry's .text is first read, not when it is stored. The ring is
+bounded by total bytes: once it grows past max_bytes the oldest whole
+blocks are dropped.
+
+Since sequence numbers are monotonic, a reader's since_seq maps straight to
+a (block, offset) position, so polling only touches entries it has not seen.
+
+Two secondary indexes support query(): a per-PID posting list of seqs, and
+the min/max capture time of every block, so a PID and time range lookup
+only visits the blocks and entries that can match.
+
+search() goes through a trigram index (text_index.py) over fixed-size
+chunks of each block, so a regex is only run against chunks that contain
+every trigram it requires.
+
+summarize() counts entries by group and message template (summary.py),
+keeping each entry's template id per block so it is only computed once.
+
+With hot_blocks set, the text arena of every full block older than the
+newest hot_blocks is zlib-compressed. The other columns stay as they are,
+so locating, PID and time lookups never decompress anything; only reading
+a cold block's text does, a whole block at a time, and the few most recently
+decompressed blocks are kept for readers walking through them. Cold blocks
+also keep the set of PIDs they hold, so search() by PID skips those
+without any.
+
+There is a single writer (the capture reader thread, or whoever holds the
+caller's write lock) and any number of concurrent readers, which take no
+lock. The writer only appends in place; anything it removes or replaces is
+swapped for a new object, so a reader holding an old one still sees
+consistent data. An entry is published by incrementing its block's count
+after every column is written, and a block is published only once it holds
+an entry. Readers bound their scans by the head seq they started from, and
+an entry evicted under them is just stale: get() by seq returns None. This
+relies on the GIL making single list, array and dict operations atomic.
+"""
+
+import heapq
+import math
+import re
+import threading
+import zlib
+from array import array
+from collections import OrderedDict
+from bisect import bisect_left, bisect_right
+from typing import Iterable, Iterator, Optional
+
+from .protocol import CP_UTF8, decode_text
+from .summary import Summary, TemplateIndex
+from .text_index import DEFAULT_MAX_BYTES as DEFAULT_INDEX_BYTES, TextIndex, required_trigrams
+
+DEFAULT_MAX_BYTES = 256 * 1024 * 1024
+DEFAULT_BLOCK_ENTRIES = 4096
+
+# Entries per text index chunk (or the largest divisor of the block size
+# below it)
+INDEX_CHUNK_ENTRIES = 256
+
+# Bytes of column storage per entry: seq + time + mono + pid + name id +
+# code page + offset, plus its seq in the PID posting list
+ENTRY_OVERHEAD = 8 + 8 + 8 + 4 + 4 + 2 + 4 + 8
+
+# Bytes per collapsed entry's repeat count and first time, in a dict
+REPEAT_OVERHEAD = 128
+
+# Stored in the mono column for entries without a monotonic time
+_NO_MONO = -1
+
+# (repeat, first time) of an entry that wasn't collapsed
+_NO_REPEAT = (1, None)
+
+# Full blocks kept uncompressed when compression is on; 0 turns it off
+DEFAULT_HOT_BLOCKS = 0
+
+# zlib level for cold blocks: fast, and debug output compresses well anyway
+COLD_LEVEL = 1
+
+# Decompressed cold block texts kept for readers
+UNPACKED_BLOCKS = 4
+
+
+class _UnpackedCache:
+    """The text of the few most recently read cold blocks."""
+
+    def __init__(self, size: int = UNPACKED_BLOCKS):
+        self.size = size
+        self._lock = threading.Lock()
+        self._texts: OrderedDict["_Block", bytes] = OrderedDict()
+
+    def get(self, block: "_Block") -> bytes:
+        with self._lock:
+            text = self._texts.get(block)
+            if text is not None:
+                self._texts.move_to_end(block)
+                return text
+        text = zlib.decompress(block.packed)
+        with self._lock:
+            self._texts[block] = text
+            while len(self._texts) > self.size:
+                self._texts.popitem(last=False)
+        return text
+
+
+_unpacked = _UnpackedCache()
+
+
+class DebugEntry:
+    """
+    A single debug output entry.
+
+    Captured entries carry their raw text bytes and the code page they are
+    in, and only decode them to text the first time .text is read, so
+    entries that are only looked at by PID or process name never pay for it.
+    """
+
+    __slots__ = ("seq", "time", "pid", "process_name", "mono", "raw", "codepage", "repeat",
+                 "first_time", "_text")
+
+    def __init__(
+        self,
+        seq: int,
+        time: int,  # Windows FILETIME
+        pid: int,
+        text: Optional[str] = None,
+        process_name: Optional[str] = None,
+        mono: Optional[int] = None,  # 100 ns units since dbgcapture.exe started (--mono)
+        raw: Optional[bytes] = None,
+        codepage: int = CP_UTF8,
+        repeat: int = 1,  # Identical messages this entry stands for (--collapse-ms)
+        first_time: Optional[int] = None  # FILETIME of the first of them; time is the last
+    ):
+        self.seq = seq
+        self.time = time
+        self.pid = pid
+        self.process_name = process_name
+        self.mono = mono
+        self.raw = raw
+        self.codepage = codepage
+        self.repeat = repeat
+        self.first_time = first_time
+        self._text = text
+
+    @property
+    def text(self) -> str:
+        if self._text is None:
+            self._text = decode_text(self.raw or b"", self.codepage)
+        return self._text
+
+    def encoded(self) -> tuple[bytes, int]:
+        """The text as (raw bytes, code page), without decoding it."""
+        if self.raw is not None:
+            return self.raw, self.codepage
+        return self._text.encode("utf-8", "surrogatepass"), CP_UTF8
+
+    def __eq__(self, other) -> bool:
+        if not isinstance(other, DebugEntry):
+            return NotImplemented
+        return (self.seq, self.time, self.pid, self.text, self.process_name, self.mono,
+                self.repeat, self.first_time) == (
+            other.seq, other.time, other.pid, other.text, other.process_name, other.mono,
+            other.repeat, other.first_time)
+
+    def __repr__(self) -> str:
+        return (f"DebugEntry(seq={self.seq!r}, time={self.time!r}, pid={self.pid!r}, "
+                f"text={self.text!r}, process_name={self.process_name!r}, mono={self.mono!r})")
+
+
+class _Block:
+    """A run of consecutive entries stored column-wise."""
+
+    __slots__ = ("ordinal", "count", "seqs", "times", "monos", "pids", "name_ids", "codepages",
+                 "offsets", "text", "repeats", "min_time", "max_time", "times_sorted", "packed",
+                 "pid_set")
+
+    def __init__(self, ordinal: int):
+        self.ordinal = ordinal  # Blocks ever created before this one
+        self.count = 0  # Published entries; columns may briefly hold one more
+        self.seqs = array("Q")
+        self.times = array("Q")
+        self.monos = array("q")
+        self.pids = array("I")
+        self.name_ids = array("I")
+        self.codepages = array("H")  # Code page of each entry's raw text
+        self.offsets = array("I", [0])  # text[offsets[i]:offsets[i + 1]]
+        self.text = bytearray()
+        # Offset -> (repeat, first time) of collapsed entries, which are
+        # too few to be worth a column
+        self.repeats: dict[int, tuple[int, int]] = {}
+        self.min_time = 0
+        self.max_time = 0
+        self.times_sorted = True  # Capture times never went backwards in this block
+        self.packed: Optional[bytes] = None  # Compressed text of a cold block, which has no text
+        self.pid_set: Optional[frozenset] = None  # PIDs in a cold block
+
+    def __len__(self) -> int:
+        return self.count
+
+    @property
+    def last_seq(self) -> int:
+        return self.seqs[self.count - 1]
+
+    @property
+    def nbytes(self) -> int:
+        text = len(self.text) if self.packed is None else len(self.packed)
+        return len(self.seqs) * ENTRY_OVERHEAD + text + len(self.repeats) * REPEAT_OVERHEAD
+
+    def cold(self) -> Optional["_Block"]:
+        """
+        A copy with the text compressed, sharing the other columns, or None
+        if compressing doesn't make it smaller. Only for full blocks.
+        """
+        packed = zlib.compress(self.text, COLD_LEVEL)
+        if len(packed) >= len(self.text):
+            return None
+        block = _Block(self.ordinal)
+        for name in ("count", "seqs", "times", "monos", "pids", "name_ids", "codepages", "offsets",
+                     "repeats", "min_time", "max_time", "times_sorted"):
+            setattr(block, name, getattr(self, name))
+        block.text = b""
+        block.packed = packed
+        block.pid_set = frozenset(self.pids)
+        return block
+
+    def add_time(self, time: int):
+        if not self.times:
+            self.min_time = self.max_time = time
+        else:
+            if time < self.times[-1]:
+                self.times_sorted = False
+            self.min_time = min(self.min_time, time)
+            self.max_time = max(self.max_time, time)
+        self.times.append(time)
+
+    def time_range(self, start_time: Optional[int], end_time: Optional[int]) -> range:
+        """
+        Offsets that may hold entries with start_time <= time <= end_time.
+
+        Exact when the block's times are sorted; otherwise the whole block.
+        """
+        count = self.count
+        if not self.times_sorted:
+            return range(count)
+        lo = bisect_left(self.times, start_time, 0, count) if start_time is not None else 0
+        hi = bisect_right(self.times, end_time, 0, count) if end_time is not None else count
+        return range(lo, hi)
+
+    def raw_at(self, i: int) -> bytes:
+        text = self.text if self.packed is None else _unpacked.get(self)
+        return bytes(text[self.offsets[i]:self.offsets[i + 1]])
+
+    def text_at(self, i: int) -> str:
+        return decode_text(self.raw_at(i), self.codepages[i])
+
+
+class EntryStore:
+    """
+    Byte-bounded ring of DebugEntry records stored in columnar blocks.
+
+    Writers (append, extend, clear, and setting max_bytes or
+    index_max_bytes) must be serialized by the caller (CaptureManager uses
+    _buffer_lock); readers need no lock.
+    """
+
+    def __init__(
+        self,
+        max_bytes: int = DEFAULT_MAX_BYTES,
+        block_entries: int = DEFAULT_BLOCK_ENTRIES,
+        index_bytes: int = DEFAULT_INDEX_BYTES,
+        hot_blocks: int = DEFAULT_HOT_BLOCKS
+    ):
+        self.max_bytes = max_bytes
+        # Full blocks whose text stays uncompressed; 0 compresses nothing.
+        # Applies to blocks filling up from now on.
+        self.hot_blocks = hot_blocks
+        self._block_entries = block_entries
+        self._blocks: list[_Block] = []  # Every block but the last is full
+        self._next_ordinal = 0
+        self._first_seq: Optional[int] = None  # Published tail and head
+        self._last_seq: Optional[int] = None
+        self._count = 0
+        self._nbytes = 0  # Bytes in all blocks except the last (still growing) one
+        self._evicted = 0
+        self._cold_blocks = 0  # Of those in _blocks
+        self._cold_text = 0  # Text bytes they held before compression
+        # Interned process names; id 0 means unknown
+        self._names: list[Optional[str]] = [None]
+        self._name_ids: dict[str, int] = {}
+        # PID -> seqs of its buffered entries, ascending
+        self._postings: dict[int, array] = {}
+        # Chunk k of the block with ordinal b is text index chunk b * _chunks_per_block + k
+        self._chunk_entries = math.gcd(block_entries, INDEX_CHUNK_ENTRIES)
+        self._chunks_per_block = block_entries // self._chunk_entries
+        self._index = TextIndex(index_bytes)
+        self._templates = TemplateIndex()  # Filled in by summarize()
+
+    def __len__(self) -> int:
+        return self._count
+
+    @property
+    def nbytes(self) -> int:
+        """Approximate bytes held by entry data."""
+        if not self._blocks:
+            return 0
+        return self._nbytes + self._blocks[-1].nbytes
+
+    @property
+    def index_nbytes(self) -> int:
+        """Approximate bytes held by the text index."""
+        return self._index.nbytes
+
+    @property
+    def index_max_bytes(self) -> int:
+        """Memory cap of the text index; 0 disables it."""
+        return self._index.max_bytes
+
+    @index_max_bytes.setter
+    def index_max_bytes(self, max_bytes: int):
+        self._index.max_bytes = max_bytes
+        if max_bytes <= 0:
+            self._index.clear()
+
+    @property
+    def cold_blocks(self) -> int:
+        """Number of blocks whose text is compressed."""
+        return self._cold_blocks
+
+    @property
+    def cold_ratio(self) -> Optional[float]:
+        """Compressed size of cold block text relative to the original."""
+        if not self._cold_text:
+            return None
+        packed = sum(len(block.packed) for block in list(self._blocks) if block.packed is not None)
+        return round(packed / self._cold_text, 3)
+
+    @property
+    def evicted(self) -> int:
+        """Number of entries dropped to stay under max_bytes."""
+        return self._evicted
+
+    @property
+    def first_seq(self) -> Optional[int]:
+        """Sequence number of the oldest buffered entry."""
+        return self._first_seq
+
+    @property
+    def last_seq(self) -> Optional[int]:
+        """Sequence number of the newest buffered entry."""
+        return self._last_seq
+
+    def _intern_name(self, name: Optional[str]) -> int:
+        if name is None:
+            return 0
+        name_id = self._name_ids.get(name)
+        if name_id is None:
+            name_id = len(self._names)
+            self._names.append(name)
+            self._name_ids[name] = name_id
+        return name_id
+
+    def append(self, entry: DebugEntry):
+        """Append an entry; seq must be greater than the last appended one."""
+        block = self._blocks[-1] if self._blocks else None
+        new_block = block is None or len(block) >= self._block_entries
+        if new_block:
+            if block is not None:
+                self._nbytes += block.nbytes
+                if self.hot_blocks > 0:
+                    self._compress_before(len(self._blocks) - self.hot_blocks)
+            block = _Block(self._next_ordinal)
+            self._next_ordinal += 1
+
+        block.seqs.append(entry.seq)
+        block.add_time(entry.time)
+        block.monos.append(_NO_MONO if entry.mono is None else entry.mono)
+        block.pids.append(entry.pid)
+        block.name_ids.append(self._intern_name(entry.process_name))
+        raw, codepage = entry.encoded()
+        block.codepages.append(codepage)
+        block.text += raw
+        block.offsets.append(len(block.text))
+        if entry.repeat > 1:
+            block.repeats[len(block.seqs) - 1] = (entry.repeat, entry.first_time)
+
+        postings = self._postings.get(entry.pid)
+        if postings is None:
+            postings = self._postings[entry.pid] = array("Q")
+        postings.append(entry.seq)
+
+        # Publish: the entry, then its block if new, then the head
+        block.count += 1
+        if new_block:
+            self._blocks.append(block)
+        self._count += 1
+        self._last_seq = entry.seq
+        if self._first_seq is None:
+            self._first_seq = entry.seq
+
+        if len(block) % self._chunk_entries == 0:
+            self._index_chunk(block, len(block) // self._chunk_entries - 1)
+
+        if self._nbytes + block.nbytes > self.max_bytes:
+            self._trim()
+
+    def _compress_before(self, end: int):
+        """Swap the blocks before index end that haven't been tried yet for their cold copies."""
+        blocks = self._blocks
+        for index in range(end - 1, -1, -1):
+            block = blocks[index]
+            if block.pid_set is not None:
+                break  # Cold already, or not worth compressing, and so is everything older
+            cold = block.cold()
+            if cold is None:
+                block.pid_set = frozenset(block.pids)  # Don't try again
+                continue
+            # Readers holding the old list keep reading the uncompressed block
+            blocks = blocks[:index] + [cold] + blocks[index + 1:]
+            self._nbytes += cold.nbytes - block.nbytes
+            self._cold_blocks += 1
+            self._cold_text += len(block.text)
+        self._blocks = blocks
+
+    def _index_chunk(self, block: _Block, k: int):
+        """Add the now complete chunk k of block to the text index."""
+        first = k * self._chunk_entries
+        last = first + self._chunk_entries
+        text = block.text[block.offsets[first]:block.offsets[last]]
+        if not text.isascii() and any(cp != CP_UTF8 for cp in block.codepages[first:last]):
+            # The index folds UTF-8; re-encode chunks with non-ASCII ANSI text
+            text = "\n".join(block.text_at(i) for i in range(first, last)).encode("utf-8", "surrogatepass")
+        self._index.add(block.ordinal * self._chunks_per_block + k, text)
+
+    def extend(self, entries):
+        """Append several entries in order."""
+        for entry in entries:
+            self.append(entry)
+
+    def _trim(self):
+        """Drop the oldest blocks until under max_bytes, keeping the newest."""
+        blocks = self._blocks
+        drop = 0
+        nbytes = self._nbytes + blocks[-1].nbytes
+        while drop < len(blocks) - 1 and nbytes > self.max_bytes:
+            nbytes -= blocks[drop].nbytes
+            drop += 1
+        if not drop:
+            return
+
+        # Readers hold on to the old list; publish the new tail with the new one
+        dropped, self._blocks = blocks[:drop], blocks[drop:]
+        self._first_seq = self._blocks[0].seqs[0]
+        for block in dropped:
+            self._nbytes -= block.nbytes
+            self._count -= len(block)
+            self._evicted += len(block)
+            if block.packed is not None:
+                self._cold_blocks -= 1
+                self._cold_text -= block.offsets[-1]
+            self._drop_postings(block)
+        self._index.drop_before(self._blocks[0].ordinal * self._chunks_per_block)
+
+    def _drop_postings(self, block: _Block):
+        """Remove an evicted block's seqs from the posting lists."""
+        last_seq = block.last_seq
+        for pid in set(block.pids):
+            postings = self._postings[pid]
+            keep = bisect_right(postings, last_seq)
+            if keep < len(postings):
+                self._postings[pid] = postings[keep:]
+            else:
+                del self._postings[pid]
+
+    def clear(self):
+        """Remove all entries."""
+        self._evicted += self._count
+        self._blocks = []
+        self._first_seq = self._last_seq = None
+        self._count = 0
+        self._nbytes = 0
+        self._cold_blocks = 0
+        self._cold_text = 0
+        self._postings = {}
+        self._index.clear()
+
+    def _entry(self, block: _Block, i: int, text: Optional[str] = None) -> DebugEntry:
+        repeat, first_time = block.repeats.get(i, _NO_REPEAT)
+        return DebugEntry(
+            seq=block.seqs[i],
+            time=block.times[i],
+            pid=block.pids[i],
+            text=text,
+            process_name=self._names[block.name_ids[i]],
+            mono=None if block.monos[i] == _NO_MONO else block.monos[i],
+            raw=block.raw_at(i),
+            codepage=block.codepages[i],
+            repeat=repeat,
+            first_time=first_time
+        )
+
+    def _locate(self, blocks: list[_Block], since_seq: int) -> tuple[int, int]:
+        """Return (block index, offset) in blocks of the first entry with seq > since_seq."""
+        if not blocks:
+            return 0, 0
+        
+        # Sequence numbers are normally contiguous, so the position is just
+        # arithmetic from the oldest entry
+        pos = since_seq + 1 - blocks[0].seqs[0]
+        if pos <= 0:
+            return 0, 0
+        index, offset = divmod(pos, self._block_entries)
+        if index < len(blocks) and offset < len(blocks[index]) and blocks[index].seqs[offset] == since_seq + 1:
+            return index, offset
+        
+        # Gaps (filtered or dropped records) - binary search instead
+        index = max(bisect_right(blocks, since_seq, key=lambda b: b.seqs[0]) - 1, 0)
+        offset = bisect_right(blocks[index].seqs, since_seq, 0, len(blocks[index]))
+        if offset >= len(blocks[index]):
+            return index + 1, 0
+        return index, offset
+
+    def get(self, seq: int) -> Optional[DebugEntry]:
+        """Return the entry with this sequence number, or None if it was evicted (or never buffered)."""
+        blocks = self._blocks
+        index, offset = self._locate(blocks, seq - 1)
+        if index < len(blocks) and offset < len(blocks[index]) and blocks[index].seqs[offset] == seq:
+            return self._entry(blocks[index], offset)
+        return None
+
+    def iter_from(self, since_seq: Optional[int], until_seq: Optional[int] = None) -> Iterator[DebugEntry]:
+        """
+        Iterate entries with since_seq < seq <= until_seq (None: from the
+        oldest, or up to the head when iteration starts).
+        """
+        blocks = list(self._blocks)
+        head = self._last_seq if until_seq is None else until_seq
+        if head is None:
+            return
+        if since_seq is None:
+            index, offset = 0, 0
+        else:
+            index, offset = self._locate(blocks, since_seq)
+        
+        while index < len(blocks):
+            block = blocks[index]
+            for i in range(offset, len(block)):
+                if block.seqs[i] > head:
+                    return
+                yield self._entry(block, i)
+            index += 1
+            offset = 0
+
+    def __iter__(self) -> Iterator[DebugEntry]:
+        return self.iter_from(None)
+    
+    def pids(self) -> list[int]:
+        """PIDs with buffered entries."""
+        return list(self._postings)
+    
+    def query(
+        self,
+        pids: Optional[Iterable[int]] = None,
+        start_time: Optional[int] = None,
+        end_time: Optional[int] = None,
+        since_seq: Optional[int] = None
+    ) -> Iterator[DebugEntry]:
+        """
+        Iterate entries from any of pids with start_time <= time <= end_time,
+        in seq order, after since_seq. None means no constraint.
+        
+        Blocks whose time span misses the range are skipped whole; with pids,
+        only that PID's posting list positions inside each block are visited.
+        """
+        for block, i in self._positions(list(self._blocks), pids, start_time, end_time, since_seq):
+            yield self._entry(block, i)
+    
+    def _positions(
+        self,
+        blocks: list[_Block],
+        pids: Optional[Iterable[int]],
+        start_time: Optional[int],
+        end_time: Optional[int],
+        since_seq: Optional[int]
+    ) -> Iterator[tuple[_Block, int]]:
+        """(block, offset) of each entry query() would yield."""
+        if since_seq is None:
+            index = 0
+        else:
+            index, _ = self._locate(blocks, since_seq)
+        postings = None
+        if pids is not None:
+            all_postings = self._postings
+            postings = [p for p in map(all_postings.get, set(pids)) if p is not None]
+            if not postings:
+                return
+        
+        for block in blocks[index:]:
+            if start_time is not None and block.max_time < start_time:
+                continue
+            if end_time is not None and block.min_time > end_time:
+                continue
+            
+            lo_seq = block.seqs[0] if since_seq is None else max(block.seqs[0], since_seq + 1)
+            hi_seq = block.last_seq
+            if postings is None:
+                offsets = block.time_range(start_time, end_time)
+                start = bisect_left(block.seqs, lo_seq, offsets.start, offsets.stop)
+                offsets = range(start, offsets.stop)
+            else:
+                seqs = heapq.merge(*(
+                    p[bisect_left(p, lo_seq):bisect_right(p, hi_seq)] for p in postings
+                ))
+                offsets = (bisect_left(block.seqs, seq, 0, len(block)) for seq in seqs)
+            
+            for i in offsets:
+                time = block.times[i]
+                if start_time is not None and time < start_time:
+                    continue
+                if end_time is not None and time > end_time:
+                    continue
+                yield block, i
+    
+    def summarize(
+        self,
+        pids: Optional[Iterable[int]] = None,
+        start_time: Optional[int] = None,
+        end_time: Optional[int] = None,
+        seqs: Optional[array] = None,
+        group_by: str = "pid",
+        top: int = 10
+    ) -> dict:
+        """
+        Summary.result() over the entries query(pids, start_time, end_time)
+        would yield, only those in seqs (ascending) if given.
+        
+        Template ids come from the store's TemplateIndex, so only entries
+        no earlier call has seen get normalized.
+        """
+        summary = Summary(group_by)
+        blocks = list(self._blocks)
+        head = self._last_seq
+        templates = self._templates
+        
+        if seqs is None:
+            positions = self._positions(blocks, pids, start_time, end_time, None)
+        else:
+            positions = self._seq_positions(blocks, seqs, pids, start_time, end_time)
+        
+        with templates.lock:
+            if blocks:
+                templates.prune(blocks[0].ordinal)
+            block_ids = repeats = None
+            current = None
+            for block, i in positions:
+                seq = block.seqs[i]
+                if seq > head:
+                    break  # Published after the summary started
+                if block is not current:
+                    current = block
+                    block_ids = templates.block_ids(block)
+                    repeats = block.repeats
+                count = repeats[i][0] if repeats and i in repeats else 1
+                summary.add(seq, block.times[i], block.pids[i], block.name_ids[i], block_ids[i], count)
+            return summary.result(self._names, templates, top, start_time, end_time)
+    
+    def _seq_positions(
+        self,
+        blocks: list[_Block],
+        seqs: array,
+        pids: Optional[Iterable[int]],
+        start_time: Optional[int],
+        end_time: Optional[int]
+    ) -> Iterator[tuple[_Block, int]]:
+        """(block, offset) of each buffered entry in seqs that also passes the query constraints."""
+        pid_set = set(pids) if pids is not None else None
+        for block in blocks:
+            if start_time is not None and block.max_time < start_time:
+                continue
+            if end_time is not None and block.min_time > end_time:
+                continue
+            count = len(block)
+            lo = bisect_left(seqs, block.seqs[0])
+            hi = bisect_right(seqs, block.seqs[count - 1])
+            for seq in seqs[lo:hi]:
+                i = bisect_left(block.seqs, seq, 0, count)
+                if i >= count or block.seqs[i] != seq:
+                    continue
+                if pid_set is not None and block.pids[i] not in pid_set:
+                    continue
+                time = block.times[i]
+                if start_time is not None and time < start_time:
+                    continue
+                if end_time is not None and time > end_time:
+                    continue
+                yield block, i
+
+    def search(
+        self,
+        pattern: re.Pattern,
+        pids: Optional[Iterable[int]] = None,
+        since_seq: Optional[int] = None
+    ) -> Iterator[DebugEntry]:
+        """
+        Iterate entries whose text pattern matches, in seq order, after
+        since_seq, optionally only from pids.
+
+        Indexed chunks that lack one of the pattern's required trigrams are
+        skipped without decoding; everything else is verified with the
+        pattern.
+        """
+        blocks = list(self._blocks)
+        if since_seq is None:
+            index, offset = 0, 0
+        else:
+            index, offset = self._locate(blocks, since_seq)
+        pid_set = set(pids) if pids is not None else None
+        # Chunks are added after all their postings and dropped before any
+        # are removed, so only chunks indexed throughout the lookup can be
+        # skipped: from the first chunk after it to the end chunk before it
+        index_end = self._index.end_chunk
+        candidates = self._index.candidates(required_trigrams(pattern))
+        indexed = range(self._index.first_chunk, index_end)
+        chunk_entries = self._chunk_entries
+
+        while index < len(blocks):
+            block = blocks[index]
+            if pid_set is not None and block.pid_set is not None and pid_set.isdisjoint(block.pid_set):
+                index += 1
+                offset = 0
+                continue
+            base = block.ordinal * self._chunks_per_block
+            for k in range(offset // chunk_entries, (len(block) + chunk_entries - 1) // chunk_entries):
+                chunk = base + k
+                if candidates is not None and chunk not in candidates and chunk in indexed:
+                    continue
+                for i in range(max(k * chunk_entries, offset), min((k + 1) * chunk_entries, len(block))):
+                    if pid_set is not None and block.pids[i] not in pid_set:
+                        continue
+                    text = block.text_at(i)
+                    if pattern.search(text):
+                        yield self._entry(block, i, text)
+            index += 1
+            offset = 0
@@ -0,0 +1,223 @@
+"""
+Filter Pool - Evaluates session filters in worker processes.
+
+Filters are plain Python and hold the GIL while they run, so every session
+added makes the reader thread wait a little longer. A FilterPool shards
+sessions across worker processes instead: each ingested batch is pickled
+once and sent to every worker that has sessions, the worker runs its
+sessions' filters over it, and the matching seqs come back to a collector
+thread, which hands them to the session's match cache for get_output.
+
+Batches and filter changes for a worker travel down the same pipe, so a
+filter change applies from the first batch sent after it. set_filters
+records the last seq already sent (the handoff); the caller evaluates
+entries up to there itself.
+"""
+
+import multiprocessing
+import pickle
+import threading
+import time
+from array import array
+from multiprocessing.connection import wait
+from typing import Callable
+
+# (include, exclude, process_names, process_pids) as pattern source strings
+FilterSpec = tuple[list[str], list[str], list[str], list[int]]
+
+
+def _worker_main(conn):
+    """Worker process: evaluate batches against this shard's sessions."""
+    # Imported here; capture_manager imports this module
+    from .capture_manager import FilterSet
+    from .entry_store import DebugEntry
+
+    sessions: dict[str, tuple[int, FilterSet]] = {}
+    while True:
+        try:
+            message = conn.recv()
+        except (EOFError, OSError):
+            return
+        kind = message[0]
+
+        if kind == "batch":
+            _, last_seq, rows = message
+            if not sessions:
+                continue
+            # Shared by all sessions, so each text is decoded at most once
+            entries = [
+                DebugEntry(seq, 0, pid, process_name=name, raw=raw, codepage=codepage)
+                for seq, pid, name, raw, codepage in rows
+            ]
+            results = []
+            for session_id, (generation, filters) in sessions.items():
+                started = time.perf_counter_ns()
+                matches = filters.matches
+                seqs = array("Q", [entry.seq for entry in entries if matches(entry)])
+                results.append((session_id, generation, seqs.tobytes(),
+                                len(entries), time.perf_counter_ns() - started))
+            conn.send(("matches", last_seq, results))
+
+        elif kind == "filters":
+            _, session_id, generation, spec = message
+            sessions[session_id] = (generation, FilterSet.compile(*spec))
+
+        elif kind == "remove":
+            sessions.pop(message[1], None)
+
+        elif kind == "stop":
+            return
+
+
+class FilterPool:
+    """
+    Worker processes that evaluate session filters off the GIL.
+
+    on_matches(session_id, generation, last_seq, seqs, evaluated, ns) is
+    called on the collector thread once per batch for every session in
+    the pool, matching or not, so the session can tell how far it has been
+    evaluated. on_failure() is called once if a worker goes away; the pool
+    is unusable after that.
+    """
+
+    def __init__(
+        self,
+        workers: int,
+        on_matches: Callable[[str, int, int, array, int, int], None],
+        on_failure: Callable[[], None]
+    ):
+        self._on_matches = on_matches
+        self._on_failure = on_failure
+        # spawn is the only start method on Windows; use it everywhere
+        context = multiprocessing.get_context("spawn")
+        self._conns = []
+        self._processes = []
+        for _ in range(workers):
+            parent, child = context.Pipe()
+            process = context.Process(target=_worker_main, args=(child,),
+                                      name="dbgcapture-filter", daemon=True)
+            process.start()
+            child.close()
+            self._conns.append(parent)
+            self._processes.append(process)
+
+        # Orders batches and filter changes on each pipe, and guards the
+        # shard table
+        self._lock = threading.Lock()
+        self._shard: dict[str, int] = {}  # Session id -> worker index
+        self._loads = [0] * workers  # Sessions per worker
+        self._generation = 0  # Bumped by every filter change
+        self._fed_to = -1  # Last seq sent to the workers
+        self.failed = False
+        self.batches = 0  # Batches sent, their entries, and the time spent sending
+        self.entries = 0
+        self.feed_ns = 0
+
+        self._collector = threading.Thread(target=self._collect, daemon=True)
+        self._collector.start()
+
+    @property
+    def workers(self) -> int:
+        return len(self._conns)
+
+    def feed(self, entries: list):
+        """Send newly buffered entries to every worker that has sessions."""
+        with self._lock:
+            if self.failed:
+                return
+            last_seq = entries[-1].seq
+            busy = [conn for conn, load in zip(self._conns, self._loads) if load]
+            if not busy:
+                self._fed_to = last_seq
+                return
+
+            started = time.perf_counter_ns()
+            rows = [(e.seq, e.pid, e.process_name, *e.encoded()) for e in entries]
+            payload = pickle.dumps(("batch", last_seq, rows), pickle.HIGHEST_PROTOCOL)
+            for conn in busy:
+                if not self._send(conn, payload):
+                    return
+            self._fed_to = last_seq
+            self.batches += 1
+            self.entries += len(entries)
+            self.feed_ns += time.perf_counter_ns() - started
+
+    def set_filters(self, session_id: str, spec: FilterSpec, target):
+        """
+        Give a session new filters, adding it to the least loaded worker if
+        it is new. Before the filters are sent, target.generation is set to
+        the generation their results will carry and target.handoff to the
+        last seq they won't be evaluated against.
+        """
+        with self._lock:
+            worker = self._shard.get(session_id)
+            if worker is None:
+                worker = min(range(len(self._loads)), key=self._loads.__getitem__)
+                self._shard[session_id] = worker
+                self._loads[worker] += 1
+            self._generation += 1
+            target.generation = self._generation
+            target.handoff = self._fed_to
+            message = ("filters", session_id, self._generation, spec)
+            self._send(self._conns[worker], pickle.dumps(message, pickle.HIGHEST_PROTOCOL))
+
+    def remove(self, session_id: str):
+        """Stop evaluating a session."""
+        with self._lock:
+            worker = self._shard.pop(session_id, None)
+            if worker is None:
+                return
+            self._loads[worker] -= 1
+            self._send(self._conns[worker], pickle.dumps(("remove", session_id)))
+
+    def close(self):
+        """Stop the workers."""
+        with self._lock:
+            self.failed = True  # Nothing more is sent, and the collector's EOF isn't a failure
+            for conn in self._conns:
+                try:
+                    conn.send(("stop",))
+                except (OSError, ValueError):
+                    pass
+        for process in self._processes:
+            process.join(timeout=2)
+            if process.is_alive():
+                process.terminate()
+        for conn in self._conns:
+            conn.close()
+        self._collector.join(timeout=2)
+
+    def _send(self, conn, payload: bytes) -> bool:
+        """Write a message to a worker. Caller holds _lock."""
+        try:
+            conn.send_bytes(payload)
+            return True
+        except (OSError, ValueError):
+            self._fail()
+            return False
+
+    def _fail(self):
+        if not self.failed:
+            self.failed = True
+            self._on_failure()
+
+    def _collect(self):
+        """Collector thread: pass worker results on as they arrive."""
+        conns = list(self._conns)
+        while conns:
+            try:
+                ready = wait(conns)
+            except (OSError, ValueError):
+                break
+            for conn in ready:
+                try:
+                    _, last_seq, results = conn.recv()
+                except (EOFError, OSError, ValueError):
+                    conns.remove(conn)
+                    with self._lock:
+                        self._fail()
+                    continue
+                for session_id, generation, seqs, evaluated, ns in results:
+                    matched = array("Q")
+                    matched.frombytes(seqs)
+                    self._on_matches(session_id, generation, last_seq, matched, evaluated, ns)
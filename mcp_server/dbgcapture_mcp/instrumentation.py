@@ -0,0 +1,103 @@
+"""
+Instrumentation - Cheap counters for finding where capture time goes.
+
+TimedLock is a drop-in threading.Lock (it also works under a Condition)
+that accumulates how long callers waited for it and how long it was held.
+NativeStats keeps the two most recent {"stats": ...} records from
+dbgcapture.exe and turns their counters into rates and averages.
+"""
+
+import threading
+from time import perf_counter_ns
+from typing import Optional
+
+
+def _ms(ns: int) -> float:
+    return round(ns / 1e6, 3)
+
+
+def _avg_us(total_us: float, count: int) -> Optional[float]:
+    return round(total_us / count, 3) if count else None
+
+
+class TimedLock:
+    """A non-reentrant lock that times waits and holds."""
+
+    def __init__(self):
+        self._lock = threading.Lock()
+        self._acquired_at = 0
+        self.acquisitions = 0
+        self.wait_ns = 0
+        self.hold_ns = 0
+        self.max_hold_ns = 0
+
+    def acquire(self, blocking: bool = True, timeout: float = -1) -> bool:
+        started = perf_counter_ns()
+        if not self._lock.acquire(blocking, timeout):
+            return False
+        # Counters only change while the lock is held
+        self._acquired_at = now = perf_counter_ns()
+        self.acquisitions += 1
+        self.wait_ns += now - started
+        return True
+
+    def release(self):
+        held = perf_counter_ns() - self._acquired_at
+        self.hold_ns += held
+        if held > self.max_hold_ns:
+            self.max_hold_ns = held
+        self._lock.release()
+
+    def locked(self) -> bool:
+        return self._lock.locked()
+
+    __enter__ = acquire
+
+    def __exit__(self, *exc):
+        self.release()
+
+    def snapshot(self) -> dict:
+        """Totals so far; read without the lock, so possibly a little torn."""
+        count = self.acquisitions
+        return {
+            "acquisitions": count,
+            "wait_ms": _ms(self.wait_ns),
+            "hold_ms": _ms(self.hold_ns),
+            "hold_avg_us": round(self.hold_ns / count / 1000, 3) if count else None,
+            "hold_max_us": round(self.max_hold_ns / 1000, 3),
+        }
+
+
+class NativeStats:
+    """Latest dbgcapture.exe counters plus rates over the last interval."""
+
+    def __init__(self):
+        self.latest: dict = {}
+        self._previous: dict = {}
+
+    def update(self, record: dict):
+        self._previous, self.latest = self.latest, record
+
+    def get(self, key: str, default=0):
+        return self.latest.get(key, default)
+
+    def snapshot(self) -> dict:
+        """Counters from the latest record, with per-second rates and average timings."""
+        latest, previous = self.latest, self._previous
+        if not latest:
+            return {}
+
+        result = dict(latest)
+        result["handoff_avg_us"] = _avg_us(latest.get("handoff_us", 0), latest.get("handoffs", 0))
+        # captured also counts records dropped or filtered out before formatting
+        result["format_avg_us"] = _avg_us(latest.get("format_us", 0), latest.get("formatted", 0))
+        result["write_avg_us"] = _avg_us(latest.get("write_us", 0), latest.get("writes", 0))
+
+        elapsed_ms = latest.get("uptime_ms", 0) - previous.get("uptime_ms", 0)
+        if previous and elapsed_ms > 0:
+            def rate(key):
+                return round((latest.get(key, 0) - previous.get(key, 0)) * 1000 / elapsed_ms, 1)
+            result["messages_per_sec"] = rate("captured")
+            result["bytes_per_sec"] = rate("bytes")
+            result["dropped_per_sec"] = rate("dropped")
+        return result
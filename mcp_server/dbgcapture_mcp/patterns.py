@@ -0,0 +1,230 @@
+"""
+Pattern matching - Classifies text against a list of filter patterns in one pass.
+
+Session filters are lists of case-insensitive regexes, most of them plain
+keywords. Instead of searching once per pattern, PatternMatcher folds the
+keywords into a single trie-shaped regex run over the lowercased text, and
+the remaining regexes into one alternation, so the cost of a line barely
+grows with the number of patterns.
+"""
+
+import re
+from typing import Optional
+
+# Regex metacharacters; a pattern without any of these (after unescaping)
+# matches as a plain substring
+_REGEX_SPECIAL = set(".^$*+?{}[]|()")
+
+# Constructs that change meaning when a pattern is embedded in a larger one
+_NOT_COMBINABLE = re.compile(r"\\[1-9]|\(\?P=|\(\?\(")
+
+
+def literal_of(pattern: str) -> Optional[str]:
+    """
+    The substring a regex pattern matches, or None if it isn't a literal.
+
+    Only ASCII literals qualify, since they are the only ones that match
+    the same way with and without re.IGNORECASE case folding.
+    """
+    chars = []
+    escaped = False
+    for c in pattern:
+        if escaped:
+            if c.isalnum():
+                return None  # \d, \b, \1 ...
+            chars.append(c)
+            escaped = False
+        elif c == "\\":
+            escaped = True
+        elif c in _REGEX_SPECIAL:
+            return None
+        else:
+            chars.append(c)
+
+    literal = "".join(chars)
+    if escaped or not literal or not literal.isascii() or "\n" in literal or "\r" in literal:
+        return None
+    return literal
+
+
+def literals_of(patterns: list[re.Pattern]) -> Optional[list[str]]:
+    """Literals for every pattern, or None if any pattern isn't one."""
+    literals = [literal_of(p.pattern) for p in patterns]
+    return None if None in literals else literals
+
+
+def _skip_group(pattern: str, i: int, close: str) -> int:
+    """Index just past the group or class starting at pattern[i]."""
+    depth = 0
+    while i < len(pattern):
+        c = pattern[i]
+        if c == "\\":
+            i += 2
+            continue
+        if close == "]":
+            # A ']' right after '[' or '[^' is a literal member
+            if c == "]" and depth and i > 1 and pattern[i - 1] not in "[^":
+                return i + 1
+            depth = 1
+        elif c == "[":
+            i = _skip_group(pattern, i, "]")
+            continue
+        elif c == "(":
+            depth += 1
+        elif c == ")":
+            depth -= 1
+            if depth == 0:
+                return i + 1
+        i += 1
+    return i
+
+
+def required_literals(pattern: re.Pattern) -> list[str]:
+    """
+    Literal runs that every match of pattern must contain.
+
+    Only the top level of the pattern is examined, and an alternation there
+    yields nothing. Groups, classes and optional characters end a run. Runs
+    shorter than three characters are dropped. The result may miss required
+    text, but never includes text a match could lack.
+    """
+    if pattern.flags & re.VERBOSE:
+        return []
+    source = pattern.pattern
+    runs = []
+    run: list[str] = []
+
+    def flush():
+        if len(run) >= 3:
+            runs.append("".join(run))
+        run.clear()
+
+    i = 0
+    while i < len(source):
+        c = source[i]
+        if c == "|":
+            return []
+        if c in "?*{":
+            # The preceding atom is optional (or counted); drop it
+            if run:
+                run.pop()
+            flush()
+            if c == "{":
+                close = source.find("}", i)
+                i = close if close != -1 else len(source)
+            i += 1
+            if i < len(source) and source[i] in "?+":
+                i += 1
+            continue
+        if c == "+":
+            flush()
+            i += 1
+            if i < len(source) and source[i] in "?+":
+                i += 1
+            continue
+        if c == "\\":
+            if i + 1 < len(source) and not source[i + 1].isalnum():
+                run.append(source[i + 1])
+            else:
+                flush()
+            i += 2
+            continue
+        if c in "([":
+            flush()
+            i = _skip_group(source, i, ")" if c == "(" else "]")
+            continue
+        if c in ".^$)]":
+            flush()
+            i += 1
+            continue
+        run.append(c)
+        i += 1
+    flush()
+    return runs
+
+
+def _trie_regex(words: list[str]) -> str:
+    """
+    A regex matching any of words, factored by common prefixes.
+
+    Only used for existence checks, so a word that contains another word
+    is redundant and dropped; every remaining word ends at a trie leaf.
+    """
+    words = sorted(set(words), key=len)
+    kept: list[str] = []
+    for word in words:
+        if not any(shorter in word for shorter in kept):
+            kept.append(word)
+
+    trie: dict = {}
+    for word in kept:
+        node = trie
+        for c in word:
+            node = node.setdefault(c, {})
+
+    def emit(node: dict) -> str:
+        branches = [re.escape(c) + emit(child) for c, child in sorted(node.items())]
+        if len(branches) <= 1:
+            return "".join(branches)
+        return "(?:" + "|".join(branches) + ")"
+
+    return emit(trie)
+
+
+class PatternMatcher:
+    """Tells whether any of a list of patterns matches a string."""
+
+    def __init__(self, patterns: list[re.Pattern]):
+        self.patterns = patterns
+
+        literals = []
+        regexes: dict[int, list[re.Pattern]] = {}
+        for p in patterns:
+            literal = literal_of(p.pattern)
+            if literal is not None and (p.flags & ~re.UNICODE) == re.IGNORECASE:
+                literals.append(literal.lower())
+            else:
+                regexes.setdefault(p.flags, []).append(p)
+
+        # ASCII text is searched lowercased with a case-sensitive trie;
+        # anything else needs real case folding
+        self._literals = re.compile(_trie_regex(literals)) if literals else None
+        self._literals_folded = (
+            re.compile("|".join(map(re.escape, literals)), re.IGNORECASE) if literals else None
+        )
+
+        self._regexes: list[re.Pattern] = []
+        for flags, group in regexes.items():
+            self._regexes.extend(self._combine(group, flags))
+
+    @staticmethod
+    def _combine(patterns: list[re.Pattern], flags: int) -> list[re.Pattern]:
+        """One alternation for the patterns that can share one."""
+        alone = [p for p in patterns if _NOT_COMBINABLE.search(p.pattern)]
+        combinable = [p for p in patterns if not _NOT_COMBINABLE.search(p.pattern)]
+        if len(combinable) < 2:
+            return combinable + alone
+
+        try:
+            combined = re.compile("|".join(f"(?:{p.pattern})" for p in combinable), flags)
+        except re.error:
+            # e.g. inline global flags, which must start the whole pattern
+            return patterns
+        return [combined] + alone
+
+    def __bool__(self) -> bool:
+        return bool(self.patterns)
+
+    def search(self, text: str) -> bool:
+        """True if any pattern matches somewhere in text."""
+        if self._literals is not None:
+            if text.isascii():
+                if self._literals.search(text.lower()):
+                    return True
+            elif self._literals_folded.search(text):
+                return True
+
+        for regex in self._regexes:
+            if regex.search(text):
+                return True
+        return False
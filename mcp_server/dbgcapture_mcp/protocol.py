@@ -0,0 +1,156 @@
+"""
+Binary framing protocol - Decodes `dbgcapture.exe --binary` output.
+
+Each record is a fixed little-endian header followed by the raw text bytes:
+
+    seq   u64   sequence number
+    time  u64   Windows FILETIME
+    pid   u32   process ID
+    len   u32   low 24 bits: payload length, high 8 bits: FRAME_FLAG_* bits
+
+With FRAME_FLAG_MONO (`--mono`) the payload starts with a u64 monotonic
+timestamp in 100 ns units. With FRAME_FLAG_REPEAT (`--collapse-ms`) the
+record stands for a run of identical messages from one process, and a u32
+count of them and the u64 FILETIME of the first come next; the header
+carries the last one's seq and time. With FRAME_FLAG_NAME (`--names`) a
+one-byte length and the writer's process image name, in the ANSI code
+page, follow. The text comes last, as raw bytes: UTF-8 with
+FRAME_FLAG_UTF8, otherwise the ANSI code page.
+
+The decoder is fed arbitrary chunks read from the pipe and returns every
+complete record in one pass, carrying partial frames over to the next call.
+"""
+
+import struct
+import sys
+from typing import NamedTuple, Optional
+
+FRAME_HEADER = struct.Struct("<QQII")
+FRAME_HEADER_SIZE = FRAME_HEADER.size
+FRAME_LEN_MASK = 0x00FFFFFF
+FRAME_FLAGS_SHIFT = 24
+FRAME_FLAG_NAME = 0x01
+FRAME_FLAG_UTF8 = 0x02  # Text is UTF-8, not ANSI
+FRAME_FLAG_MONO = 0x04
+FRAME_FLAG_REPEAT = 0x08
+
+MONO = struct.Struct("<Q")
+REPEAT = struct.Struct("<IQ")  # Messages in the run, FILETIME of the first
+
+# Text from DBWIN_BUFFER is in the writer's ANSI code page
+ANSI_ENCODING = "mbcs" if sys.platform == "win32" else "latin-1"
+
+# Code page tags stored with raw text
+CP_ACP = 0
+CP_UTF8 = 65001
+
+
+def decode_text(raw: bytes, codepage: int) -> str:
+    """Decode raw entry text tagged with a code page."""
+    if raw.isascii():
+        return raw.decode("ascii")
+    if codepage == CP_UTF8:
+        return raw.decode("utf-8", "surrogatepass")
+    if codepage == CP_ACP:
+        return raw.decode(ANSI_ENCODING, "replace")
+    return raw.decode(f"cp{codepage}", "replace")
+
+
+def frame_codepage(flags: int) -> int:
+    """Code page tag of a frame's text."""
+    return CP_UTF8 if flags & FRAME_FLAG_UTF8 else CP_ACP
+
+
+class Frame(NamedTuple):
+    """A single decoded record."""
+    seq: int
+    time: int
+    pid: int
+    flags: int
+    payload: bytes
+
+
+def encode_frame(
+    seq: int,
+    time: int,
+    pid: int,
+    payload: bytes,
+    flags: int = 0,
+    name: Optional[bytes] = None,
+    mono: Optional[int] = None,
+    repeat: Optional[tuple[int, int]] = None
+) -> bytes:
+    """Encode a single record in the binary framing format; repeat is (count, first time)."""
+    if name is not None:
+        payload = bytes([len(name)]) + name + payload
+        flags |= FRAME_FLAG_NAME
+    if repeat is not None:
+        payload = REPEAT.pack(*repeat) + payload
+        flags |= FRAME_FLAG_REPEAT
+    if mono is not None:
+        payload = MONO.pack(mono) + payload
+        flags |= FRAME_FLAG_MONO
+    return FRAME_HEADER.pack(seq, time, pid, len(payload) | (flags << FRAME_FLAGS_SHIFT)) + payload
+
+
+def split_payload(frame: Frame) -> tuple[Optional[int], Optional[bytes], bytes]:
+    """Split a frame's payload into (monotonic time, process name, text); absent fields are None."""
+    payload = frame.payload
+    mono = None
+    if frame.flags & FRAME_FLAG_MONO and len(payload) >= MONO.size:
+        mono = MONO.unpack_from(payload)[0]
+        payload = payload[MONO.size:]
+    if frame.flags & FRAME_FLAG_REPEAT:
+        payload = payload[REPEAT.size:]
+    if not frame.flags & FRAME_FLAG_NAME or not payload:
+        return mono, None, payload
+    name_len = payload[0]
+    return mono, payload[1:1 + name_len], payload[1 + name_len:]
+
+
+def frame_repeat(frame: Frame) -> Optional[tuple[int, int]]:
+    """(count, first time) of a FRAME_FLAG_REPEAT record, else None."""
+    if not frame.flags & FRAME_FLAG_REPEAT:
+        return None
+    offset = MONO.size if frame.flags & FRAME_FLAG_MONO else 0
+    if len(frame.payload) < offset + REPEAT.size:
+        return None
+    return REPEAT.unpack_from(frame.payload, offset)
+
+
+class FrameDecoder:
+    """Incremental decoder for a stream of binary frames."""
+
+    def __init__(self):
+        self._pending = bytearray()
+
+    def feed(self, data: bytes) -> list[Frame]:
+        """Decode every complete frame in data plus any carried-over bytes."""
+        if self._pending:
+            self._pending += data
+            buf = memoryview(self._pending)
+        else:
+            buf = memoryview(data)
+
+        frames = []
+        offset = 0
+        end = len(buf)
+        unpack_from = FRAME_HEADER.unpack_from
+
+        while end - offset >= FRAME_HEADER_SIZE:
+            seq, time, pid, length = unpack_from(buf, offset)
+            payload_len = length & FRAME_LEN_MASK
+            start = offset + FRAME_HEADER_SIZE
+            if end - start < payload_len:
+                break
+            frames.append(Frame(
+                seq, time, pid,
+                length >> FRAME_FLAGS_SHIFT,
+                buf[start:start + payload_len].tobytes()
+            ))
+            offset = start + payload_len
+
+        remainder = buf[offset:].tobytes()
+        buf.release()
+        self._pending = bytearray(remainder)
+        return frames
@@ -9,19 +9,59 @@ import asyncio
 import json
 import re
 import traceback
+from pathlib import Path
 from typing import Any
 
-from mcp.server import Server
+from mcp.server import NotificationOptions, Server
 from mcp.server.stdio import stdio_server
-from mcp.types import Tool, TextContent
+from mcp.types import Resource, Tool, TextContent
 
 from . import __version__
 from .capture_manager import get_manager
+from .subscriptions import SubscriptionManager, session_uri
+
+# Upper bound for get_output's wait_ms, so a call can't hold a worker
+# thread indefinitely
+MAX_WAIT_MS = 60000
 
 
 def create_server() -> Server:
     """Create and configure the MCP server."""
     server = Server("dbgcapture-mcp")
+    subscriptions = SubscriptionManager(get_manager())
+    
+    @server.list_resources()
+    async def list_resources() -> list[Resource]:
+        """Expose each session's unread output as a resource."""
+        sessions = list(get_manager()._sessions.values())
+        return [
+            Resource(
+                uri=session_uri(session.id),
+                name=session.name,
+                description="Unread debug output matching this session's filters. Reading returns the next batch and advances the session cursor; subscribe to be notified when more arrives.",
+                mimeType="application/json"
+            )
+            for session in sessions
+        ]
+    
+    @server.read_resource()
+    async def read_resource(uri) -> str:
+        """Return the next batch of a session's output."""
+        batch = subscriptions.read(str(uri))
+        if batch is None:
+            raise ValueError(f"Unknown resource: {uri}")
+        return json.dumps(batch)
+    
+    @server.subscribe_resource()
+    async def subscribe_resource(uri) -> None:
+        """Notify the subscribing client when a session has new output."""
+        client = server.request_context.session
+        if not subscriptions.subscribe(str(uri), lambda u: client.send_resource_updated(u)):
+            raise ValueError(f"Unknown resource: {uri}")
+    
+    @server.unsubscribe_resource()
+    async def unsubscribe_resource(uri) -> None:
+        subscriptions.unsubscribe(str(uri))
     
     @server.list_tools()
     async def list_tools() -> list[Tool]:
@@ -90,7 +130,7 @@ def create_server() -> Server:
             ),
             Tool(
                 name="get_output",
-                description="Get captured debug output for a session. Returns entries that match the session's filters. Use since_seq to get only new entries since last call.",
+                description="Get captured debug output for a session. Returns entries that match the session's filters. Use since_seq to get only new entries since last call. Set wait_ms to wait for new matching output instead of polling.",
                 inputSchema={
                     "type": "object",
                     "properties": {
@@ -106,11 +146,147 @@ def create_server() -> Server:
                         "since_seq": {
                             "type": "integer",
                             "description": "Only return entries after this sequence number"
+                        },
+                        "wait_ms": {
+                            "type": "integer",
+                            "description": f"If nothing matches yet, wait up to this many milliseconds for a matching entry (default 0, max {MAX_WAIT_MS})",
+                            "default": 0
                         }
                     },
                     "required": ["session_id"]
                 }
             ),
+            Tool(
+                name="query",
+                description="Look up buffered output by process and/or time range without scanning everything. Times are Windows FILETIME values, as in the 'time' field of entries. Optionally also apply a session's filters. Does not move any session cursor; page with since_seq.",
+                inputSchema={
+                    "type": "object",
+                    "properties": {
+                        "pids": {
+                            "type": "array",
+                            "items": {"type": "integer"},
+                            "description": "Only entries from these PIDs"
+                        },
+                        "start_time": {
+                            "type": "integer",
+                            "description": "Only entries at or after this FILETIME"
+                        },
+                        "end_time": {
+                            "type": "integer",
+                            "description": "Only entries at or before this FILETIME"
+                        },
+                        "session_id": {
+                            "type": "string",
+                            "description": "Also apply this session's filters"
+                        },
+                        "limit": {
+                            "type": "integer",
+                            "description": "Maximum entries to return (default 100)",
+                            "default": 100
+                        },
+                        "since_seq": {
+                            "type": "integer",
+                            "description": "Only return entries after this sequence number"
+                        }
+                    }
+                }
+            ),
+            Tool(
+                name="summarize",
+                description="Summarize buffered output instead of returning it: entry counts and rates per second per process, the busiest second, and the most frequent message templates (text with numbers, hex values and GUIDs replaced by <n>, <hex> and <guid>). Select entries by PIDs, time range and/or a session's filters. Much smaller than pulling the lines with get_output.",
+                inputSchema={
+                    "type": "object",
+                    "properties": {
+                        "pids": {
+                            "type": "array",
+                            "items": {"type": "integer"},
+                            "description": "Only entries from these PIDs"
+                        },
+                        "start_time": {
+                            "type": "integer",
+                            "description": "Only entries at or after this FILETIME"
+                        },
+                        "end_time": {
+                            "type": "integer",
+                            "description": "Only entries at or before this FILETIME"
+                        },
+                        "session_id": {
+                            "type": "string",
+                            "description": "Only entries matching this session's filters"
+                        },
+                        "group_by": {
+                            "type": "string",
+                            "enum": ["pid", "name", "none"],
+                            "description": "Count per PID, per process name, or not at all (default pid)",
+                            "default": "pid"
+                        },
+                        "top": {
+                            "type": "integer",
+                            "description": "Number of groups and templates to return (default 10)",
+                            "default": 10
+                        }
+                    }
+                }
+            ),
+            Tool(
+                name="export_session",
+                description="Write everything matching a session's filters to a file of dbgcapture binary frames (the --binary stdout format), including output spilled to disk, and return just the path and row count. Use this to hand a large capture to another tool instead of paging through get_output. Does not move the session cursor.",
+                inputSchema={
+                    "type": "object",
+                    "properties": {
+                        "session_id": {
+                            "type": "string",
+                            "description": "The session ID"
+                        },
+                        "path": {
+                            "type": "string",
+                            "description": "New file to write; an existing file is never overwritten (default: a new file in the temp directory)"
+                        },
+                        "since_seq": {
+                            "type": "integer",
+                            "description": "Only export entries after this sequence number"
+                        }
+                    },
+                    "required": ["session_id"]
+                }
+            ),
+            Tool(
+                name="search",
+                description="Search all buffered output for a regex (case-insensitive unless case_sensitive). Uses a text index, so it is much cheaper than re-filtering a session. Optionally restrict to PIDs or also apply a session's filters. Does not move any session cursor; page with since_seq.",
+                inputSchema={
+                    "type": "object",
+                    "properties": {
+                        "pattern": {
+                            "type": "string",
+                            "description": "Regex to search entry text for"
+                        },
+                        "case_sensitive": {
+                            "type": "boolean",
+                            "description": "Match case exactly (default false)",
+                            "default": False
+                        },
+                        "pids": {
+                            "type": "array",
+                            "items": {"type": "integer"},
+                            "description": "Only entries from these PIDs"
+                        },
+                        "session_id": {
+                            "type": "string",
+                            "description": "Also apply this session's filters"
+                        },
+                        "limit": {
+                            "type": "integer",
+                            "description": "Maximum entries to return (default 100)",
+                            "default": 100
+                        },
+                        "since_seq": {
+                            "type": "integer",
+                            "description": "Only return entries after this sequence number"
+                        }
+                    },
+                    "required": ["pattern"]
+                }
+            ),
             Tool(
                 name="clear_session",
                 description="Clear session's read position - skip all pending entries and start fresh from now.",
@@ -127,7 +303,7 @@ def create_server() -> Server:
             ),
             Tool(
                 name="get_session_status",
-                description="Get status of a capture session including active filters, pending entry count, and capture state.",
+                description="Get status of a capture session including active filters, pending entry count, and capture state. Reports loss too: 'missed' counts entries evicted before this session read them, 'buffer_evicted' all evictions, and 'capture' the messages dbgcapture.exe dropped or was blocked on when its ring filled.",
                 inputSchema={
                     "type": "object",
                     "properties": {
@@ -159,6 +335,19 @@ def create_server() -> Server:
                     "type": "object",
                     "properties": {}
                 }
+            ),
+            Tool(
+                name="get_capture_stats",
+                description=(
+                    "Performance counters for the capture pipeline: dbgcapture.exe "
+                    "messages/sec, bytes/sec, handoff latency, formatting and pipe write "
+                    "time; parse time, lock wait/hold time and per-session filter cost "
+                    "in the server. Native counters refresh every stats interval."
+                ),
+                inputSchema={
+                    "type": "object",
+                    "properties": {}
+                }
             )
         ]
     
@@ -170,7 +359,16 @@ def create_server() -> Server:
         try:
             if name == "create_session":
                 session_name = arguments.get("name")
-                session_id = manager.create_session(session_name)
+                # Starting capture waits for dbgcapture.exe's handshake, so
+                # keep it off the event loop
+                try:
+                    session_id = await asyncio.to_thread(manager.create_session, session_name)
+                except (RuntimeError, FileNotFoundError) as e:
+                    return [TextContent(
+                        type="text",
+                        text=json.dumps({"error": str(e)})
+                    )]
+                await server.request_context.session.send_resource_list_changed()
                 return [TextContent(
                     type="text",
                     text=f'{{"session_id": "{session_id}", "status": "created", "capture_running": true}}'
@@ -179,7 +377,9 @@ def create_server() -> Server:
             elif name == "destroy_session":
                 session_id = arguments["session_id"]
                 success = manager.destroy_session(session_id)
+                subscriptions.unsubscribe(session_uri(session_id))
                 if success:
+                    await server.request_context.session.send_resource_list_changed()
                     return [TextContent(
                         type="text",
                         text=f'{{"session_id": "{session_id}", "status": "destroyed"}}'
@@ -229,9 +429,51 @@ def create_server() -> Server:
                 session_id = arguments["session_id"]
                 limit = arguments.get("limit", 100)
                 since_seq = arguments.get("since_seq")
+                wait_ms = min(max(arguments.get("wait_ms", 0), 0), MAX_WAIT_MS)
+                
+                if wait_ms:
+                    # Block in a worker thread so other requests keep flowing
+                    entries, next_seq = await asyncio.to_thread(
+                        manager.get_output, session_id, limit, since_seq, wait_ms
+                    )
+                else:
+                    entries, next_seq = manager.get_output(session_id, limit, since_seq)
+                
+                return [TextContent(
+                    type="text",
+                    text=json.dumps({
+                        "entries": entries,
+                        "count": len(entries),
+                        "next_seq": next_seq
+                    })
+                )]
+            
+            elif name == "search":
+                pattern = arguments["pattern"]
+                try:
+                    re.compile(pattern)
+                except re.error as e:
+                    return [TextContent(
+                        type="text",
+                        text=f'{{"error": "Invalid regex: {pattern} - {e}"}}'
+                    )]
                 
-                entries, next_seq = manager.get_output(session_id, limit, since_seq)
+                session_id = arguments.get("session_id")
+                result = manager.search(
+                    pattern,
+                    case_sensitive=arguments.get("case_sensitive", False),
+                    pids=arguments.get("pids"),
+                    session_id=session_id,
+                    limit=arguments.get("limit", 100),
+                    since_seq=arguments.get("since_seq")
+                )
+                if result is None:
+                    return [TextContent(
+                        type="text",
+                        text=f'{{"error": "Session not found: {session_id}"}}'
+                    )]
                 
+                entries, next_seq = result
                 return [TextContent(
                     type="text",
                     text=json.dumps({
@@ -241,6 +483,77 @@ def create_server() -> Server:
                     })
                 )]
             
+            elif name == "query":
+                session_id = arguments.get("session_id")
+                result = manager.query(
+                    pids=arguments.get("pids"),
+                    start_time=arguments.get("start_time"),
+                    end_time=arguments.get("end_time"),
+                    session_id=session_id,
+                    limit=arguments.get("limit", 100),
+                    since_seq=arguments.get("since_seq")
+                )
+                if result is None:
+                    return [TextContent(
+                        type="text",
+                        text=f'{{"error": "Session not found: {session_id}"}}'
+                    )]
+                
+                entries, next_seq = result
+                return [TextContent(
+                    type="text",
+                    text=json.dumps({
+                        "entries": entries,
+                        "count": len(entries),
+                        "next_seq": next_seq
+                    })
+                )]
+            
+            elif name == "summarize":
+                session_id = arguments.get("session_id")
+                result = manager.summarize(
+                    pids=arguments.get("pids"),
+                    start_time=arguments.get("start_time"),
+                    end_time=arguments.get("end_time"),
+                    session_id=session_id,
+                    group_by=arguments.get("group_by", "pid"),
+                    top=arguments.get("top", 10)
+                )
+                if result is None:
+                    return [TextContent(
+                        type="text",
+                        text=f'{{"error": "Session not found: {session_id}"}}'
+                    )]
+                
+                return [TextContent(
+                    type="text",
+                    text=json.dumps(result)
+                )]
+            
+            elif name == "export_session":
+                session_id = arguments["session_id"]
+                # Written in a worker thread so other requests keep flowing
+                try:
+                    result = await asyncio.to_thread(
+                        manager.export_session, session_id,
+                        arguments.get("path"), arguments.get("since_seq")
+                    )
+                except FileExistsError as e:
+                    return [TextContent(
+                        type="text",
+                        text=json.dumps({"error": f"File already exists: {e.filename}"})
+                    )]
+                if result is None:
+                    return [TextContent(
+                        type="text",
+                        text=f'{{"error": "Session not found: {session_id}"}}'
+                    )]
+                
+                return [TextContent(
+                    type="text",
+                    text=json.dumps(result)
+                )]
+            
             elif name == "clear_session":
                 session_id = arguments["session_id"]
                 success = manager.clear_session(session_id)
@@ -280,14 +593,14 @@ def create_server() -> Server:
                 )]
             
             elif name == "list_sessions":
-                sessions = []
-                with manager._sessions_lock:
-                    for session in manager._sessions.values():
-                        sessions.append({
-                            "session_id": session.id,
-                            "name": session.name,
-                            "cursor": session.cursor
-                        })
+                sessions = [
+                    {
+                        "session_id": session.id,
+                        "name": session.name,
+                        "cursor": session.cursor
+                    }
+                    for session in manager._sessions.values()
+                ]
                 
                 return [TextContent(
                     type="text",
@@ -298,6 +611,12 @@ def create_server() -> Server:
                     })
                 )]
             
+            elif name == "get_capture_stats":
+                return [TextContent(
+                    type="text",
+                    text=json.dumps(manager.get_capture_stats())
+                )]
+            
             else:
                 return [TextContent(
                     type="text",
@@ -313,16 +632,31 @@ def create_server() -> Server:
     return server
 
 
-async def run_server():
-    """Run the MCP server."""
+async def prestart_capture():
+    """Start capture ahead of the first session, without delaying the handshake."""
+    try:
+        await asyncio.to_thread(get_manager().start_capture)
+    except Exception:
+        pass  # create_session tries again and reports the error
+
+
+async def run_server(prestart: bool = False):
+    """Run the MCP server. prestart starts capture before any session is created."""
     server = create_server()
+    if prestart:
+        # Held until the server exits, since the loop only keeps a weak reference
+        prestart_task = asyncio.create_task(prestart_capture())
+    
+    # Sessions come and go, so clients should re-list resources on change
+    options = server.create_initialization_options(
+        NotificationOptions(resources_changed=True)
+    )
+    if options.capabilities.resources is not None:
+        # The low-level server never advertises subscribe support itself
+        options.capabilities.resources.subscribe = True
     
     async with stdio_server() as (read_stream, write_stream):
-        await server.run(
-            read_stream,
-            write_stream,
-            server.create_initialization_options()
-        )
+        await server.run(read_stream, write_stream, options)
 
 
 def main():
@@ -336,9 +670,106 @@ def main():
         action="version",
         version=f"%(prog)s {__version__}"
     )
-    parser.parse_args()
+    parser.add_argument(
+        "--global",
+        dest="global_capture",
+        action="store_true",
+        help="Capture debug output from all sessions (requires admin)"
+    )
+    parser.add_argument(
+        "--kernel",
+        action="store_true",
+        help="Also capture kernel DbgPrint output via ETW (requires admin)"
+    )
+    parser.add_argument(
+        "--buffer-mb",
+        type=int,
+        default=256,
+        help="Memory limit for buffered debug output in MB (default 256)"
+    )
+    parser.add_argument(
+        "--spill-dir",
+        type=Path,
+        help="Also log all output to segment files in this directory, so older output stays readable"
+    )
+    parser.add_argument(
+        "--spill-mb",
+        type=int,
+        default=4096,
+        help="Disk limit for --spill-dir in MB (default 4096)"
+    )
+    parser.add_argument(
+        "--overflow",
+        choices=["block", "drop-oldest", "drop-newest"],
+        default="block",
+        help="When dbgcapture.exe falls behind: block the programs writing output, or drop the oldest or newest messages (default block)"
+    )
+    parser.add_argument(
+        "--index-mb",
+        type=int,
+        default=64,
+        help="Memory limit for the search index in MB, 0 to disable (default 64)"
+    )
+    parser.add_argument(
+        "--filter-workers",
+        type=int,
+        default=0,
+        help="Evaluate session filters in this many worker processes, 0 for in-process (default 0)"
+    )
+    parser.add_argument(
+        "--collapse-ms",
+        type=int,
+        default=0,
+        help="Collapse repeats of the same message from a process within this many ms into one entry, 0 to keep every copy (default 0)"
+    )
+    parser.add_argument(
+        "--shared",
+        nargs="?",
+        const="dbgcapture",
+        metavar="NAME",
+        help="Read from the capture service NAME (default dbgcapture) shared by every server that passes it, starting it if needed"
+    )
+    parser.add_argument(
+        "--hot-blocks",
+        type=int,
+        default=4,
+        help="Blocks of 4096 buffered entries kept uncompressed; older ones are compressed, 0 to compress none (default 4)"
+    )
+    parser.add_argument(
+        "--linger-ms",
+        type=int,
+        default=0,
+        help="Keep capture running this long after the last session is destroyed (default 0)"
+    )
+    parser.add_argument(
+        "--native-filter",
+        action="store_true",
+        help="Have dbgcapture.exe drop output no session's filters accept; query, search and summarize then never see it"
+    )
+    parser.add_argument(
+        "--prestart",
+        action="store_true",
+        help="Start capture when the server starts instead of at the first create_session"
+    )
+    args = parser.parse_args()
+    
+    get_manager().configure(
+        global_capture=args.global_capture,
+        kernel_capture=args.kernel,
+        buffer_bytes=args.buffer_mb * 1024 * 1024,
+        spill_dir=args.spill_dir,
+        spill_bytes=args.spill_mb * 1024 * 1024,
+        index_bytes=args.index_mb * 1024 * 1024,
+        overflow=args.overflow,
+        filter_workers=args.filter_workers,
+        collapse_ms=args.collapse_ms,
+        shared=args.shared,
+        linger_ms=args.linger_ms,
+        hot_blocks=args.hot_blocks,
+        native_filter=args.native_filter
+    )
     
-    asyncio.run(run_server())
+    asyncio.run(run_server(prestart=args.prestart))
 
 
 if __name__ == "__main__":
@@ -0,0 +1,292 @@
+"""
+Spill Store - Persistent capture log in memory-mapped segment files.
+
+Every captured entry is appended, in the binary framing format from
+protocol.py, to a fixed-size segment file that is mapped into memory.
+When a segment fills up a new one is started, and the oldest segments are
+deleted once the files on disk exceed max_bytes. Each segment keeps a
+sparse index of (seq, offset) pairs every INDEX_INTERVAL records, so a read
+from an old since_seq seeks near its position and walks forward from there.
+
+Text is stored as the raw bytes it arrived with, flagged FRAME_FLAG_UTF8
+when it is UTF-8 rather than ANSI, and read back the same way, so neither
+side decodes it. Reads parse straight out of the mapping without copying
+frames first.
+
+Segments are named dbgcapture-NNNNNNNN.seg; any left in the directory by a
+previous run are deleted when the store opens.
+"""
+
+import mmap
+import os
+import threading
+from array import array
+from bisect import bisect_right
+from pathlib import Path
+from typing import Callable, Optional
+
+from .entry_store import DebugEntry
+from .protocol import (
+    ANSI_ENCODING,
+    FRAME_FLAG_MONO,
+    FRAME_FLAG_NAME,
+    FRAME_FLAG_REPEAT,
+    FRAME_FLAG_UTF8,
+    FRAME_FLAGS_SHIFT,
+    FRAME_HEADER,
+    FRAME_HEADER_SIZE,
+    FRAME_LEN_MASK,
+    CP_UTF8,
+    MONO,
+    REPEAT,
+    encode_frame,
+    frame_codepage,
+)
+
+DEFAULT_SEGMENT_BYTES = 64 * 1024 * 1024
+DEFAULT_MAX_BYTES = 4 * 1024 * 1024 * 1024
+INDEX_INTERVAL = 256
+
+SEGMENT_PATTERN = "dbgcapture-*.seg"
+
+
+def encode_entry(entry: DebugEntry) -> bytes:
+    """Encode an entry as a frame, the way dbgcapture.exe --binary would have sent it."""
+    # Names are in the ANSI code page there, which is where they came from
+    name = entry.process_name.encode(ANSI_ENCODING, "replace") if entry.process_name else None
+    raw, codepage = entry.encoded()
+    return encode_frame(
+        entry.seq, entry.time, entry.pid, raw,
+        flags=FRAME_FLAG_UTF8 if codepage == CP_UTF8 else 0,
+        name=name[:255] if name is not None else None,
+        mono=entry.mono,
+        repeat=(entry.repeat, entry.first_time) if entry.repeat > 1 else None
+    )
+
+
+class _Segment:
+    """One mapped segment file."""
+
+    def __init__(self, path: Path, size: int):
+        self.path = path
+        self._file = open(path, "w+b")
+        self._file.truncate(size)
+        self.map = mmap.mmap(self._file.fileno(), size)
+        self.size = size
+        self.used = 0
+        self.count = 0
+        self.first_seq: Optional[int] = None
+        self.last_seq: Optional[int] = None
+        # Sparse index: seq and offset of every INDEX_INTERVAL-th frame
+        self.index_seqs = array("Q")
+        self.index_offsets = array("Q")
+        # Reads in progress, and whether the store has let go of it; the
+        # last reader of a retired segment closes it
+        self.readers = 0
+        self.retired = False
+
+    def append(self, seq: int, frame: bytes) -> bool:
+        """Write one frame; False if it doesn't fit."""
+        end = self.used + len(frame)
+        if end > self.size:
+            return False
+        if self.count % INDEX_INTERVAL == 0:
+            self.index_seqs.append(seq)
+            self.index_offsets.append(self.used)
+        self.map[self.used:end] = frame
+        self.used = end
+        self.count += 1
+        if self.first_seq is None:
+            self.first_seq = seq
+        self.last_seq = seq
+        return True
+
+    def seek(self, since_seq: int) -> int:
+        """Offset of an indexed frame at or before the first seq > since_seq."""
+        i = bisect_right(self.index_seqs, since_seq + 1) - 1
+        return self.index_offsets[i] if i >= 0 else 0
+
+    def retire(self):
+        """Close now, or once the reads still using the mapping finish."""
+        self.retired = True
+        if not self.readers:
+            self.close()
+
+    def unpin(self):
+        self.readers -= 1
+        if self.retired and not self.readers:
+            self.close()
+
+    def close(self, delete: bool = True):
+        self.map.close()
+        self._file.close()
+        if delete:
+            try:
+                os.remove(self.path)
+            except OSError:
+                pass
+
+
+class SpillStore:
+    """
+    Byte-bounded on-disk log of every captured entry.
+
+    Thread-safe. Appends from the reader thread take an internal lock;
+    reads from tool calls only take it to pin the segments they need and
+    note how far each was written, then decode and filter without it, so a
+    long scan never holds up capture. Written bytes never change, and a
+    segment deleted while being read is closed when its last read ends.
+    """
+
+    def __init__(
+        self,
+        directory: Path,
+        max_bytes: int = DEFAULT_MAX_BYTES,
+        segment_bytes: int = DEFAULT_SEGMENT_BYTES
+    ):
+        self.directory = Path(directory)
+        self.max_bytes = max_bytes
+        self.segment_bytes = segment_bytes
+        self._segments: list[_Segment] = []
+        self._next_segment = 0
+        self._lock = threading.Lock()
+
+        self.directory.mkdir(parents=True, exist_ok=True)
+        for stale in self.directory.glob(SEGMENT_PATTERN):
+            try:
+                stale.unlink()
+            except OSError:
+                pass
+
+    @property
+    def nbytes(self) -> int:
+        """Bytes of segment files on disk."""
+        return len(self._segments) * self.segment_bytes
+
+    @property
+    def first_seq(self) -> Optional[int]:
+        """Sequence number of the oldest entry on disk."""
+        with self._lock:
+            return self._segments[0].first_seq if self._segments else None
+
+    def _new_segment(self) -> _Segment:
+        path = self.directory / f"dbgcapture-{self._next_segment:08d}.seg"
+        self._next_segment += 1
+        segment = _Segment(path, self.segment_bytes)
+        self._segments.append(segment)
+
+        # Keep at least the segment being written
+        while len(self._segments) > 1 and self.nbytes > self.max_bytes:
+            self._segments.pop(0).retire()
+        return segment
+
+    def extend(self, entries: list[DebugEntry]):
+        """Append entries in seq order."""
+        with self._lock:
+            segment = self._segments[-1] if self._segments else None
+            for entry in entries:
+                frame = encode_entry(entry)
+                # A frame larger than a whole segment can't be stored
+                if len(frame) > self.segment_bytes:
+                    continue
+                if segment is None or not segment.append(entry.seq, frame):
+                    segment = self._new_segment()
+                    segment.append(entry.seq, frame)
+
+    def close(self):
+        """Unmap and delete every segment."""
+        with self._lock:
+            for segment in self._segments:
+                segment.retire()
+            self._segments.clear()
+
+    def read(
+        self,
+        since_seq: int,
+        predicate: Callable[[DebugEntry], bool],
+        limit: int,
+        stop_seq: Optional[int] = None,
+        max_scan: int = 100000
+    ) -> tuple[list[DebugEntry], int]:
+        """
+        Entries with seq > since_seq that satisfy predicate.
+
+        Stops after limit matches, at stop_seq, or after examining max_scan
+        entries. Returns (entries, seq examined up to): every entry up to
+        and including that seq has been looked at. Reaching stop_seq or the
+        end of the log counts as having examined everything before stop_seq.
+        """
+        results: list[DebugEntry] = []
+        scanned_to = since_seq
+        scanned = 0
+        unpack_from = FRAME_HEADER.unpack_from
+
+        # (segment, start offset, bytes written) for every segment to scan
+        pinned: list[tuple[_Segment, int, int]] = []
+        with self._lock:
+            segments = self._segments
+            index = max(bisect_right([s.first_seq for s in segments], since_seq) - 1, 0)
+            for segment in segments[index:]:
+                if segment.last_seq is None or segment.last_seq <= since_seq:
+                    continue
+                segment.readers += 1
+                pinned.append((segment, segment.seek(since_seq), segment.used))
+
+        try:
+            for segment, offset, used in pinned:
+                buf = memoryview(segment.map)
+                try:
+                    while offset < used:
+                        seq, time, pid, length = unpack_from(buf, offset)
+                        payload_len = length & FRAME_LEN_MASK
+                        start = offset + FRAME_HEADER_SIZE
+                        offset = start + payload_len
+                        if seq <= since_seq:
+                            continue
+                        if stop_seq is not None and seq >= stop_seq:
+                            return results, stop_seq - 1
+
+                        flags = length >> FRAME_FLAGS_SHIFT
+                        mono = None
+                        if flags & FRAME_FLAG_MONO:
+                            mono = MONO.unpack_from(buf, start)[0]
+                            start += MONO.size
+                        repeat, first_time = 1, None
+                        if flags & FRAME_FLAG_REPEAT:
+                            repeat, first_time = REPEAT.unpack_from(buf, start)
+                            start += REPEAT.size
+                        name = None
+                        if flags & FRAME_FLAG_NAME:
+                            name_len = buf[start]
+                            name = str(buf[start + 1:start + 1 + name_len], ANSI_ENCODING, "replace")
+                            start += 1 + name_len
+                        entry = DebugEntry(
+                            seq=seq,
+                            time=time,
+                            pid=pid,
+                            process_name=name or None,
+                            mono=mono,
+                            raw=bytes(buf[start:offset]),
+                            codepage=frame_codepage(flags),
+                            repeat=repeat,
+                            first_time=first_time
+                        )
+
+                        scanned_to = seq
+                        scanned += 1
+                        if predicate(entry):
+                            results.append(entry)
+                            if len(results) >= limit:
+                                return results, scanned_to
+                        if scanned >= max_scan:
+                            return results, scanned_to
+                finally:
+                    buf.release()
+        finally:
+            with self._lock:
+                for segment, _, _ in pinned:
+                    segment.unpin()
+
+        if stop_seq is not None:
+            return results, max(scanned_to, stop_seq - 1)
+        return results, scanned_to
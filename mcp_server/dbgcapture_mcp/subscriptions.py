@@ -0,0 +1,125 @@
+"""
+Session subscriptions - Pushes new session output to MCP clients.
+
+Each session is exposed as the resource dbgcapture://sessions/{id}. Reading
+it returns the next batch of unread matching entries, like get_output. A
+client that subscribes gets a resources/updated notification when new
+matching output arrives, then reads the resource to fetch it.
+
+Backpressure comes from the notification protocol itself: at most one
+notification is outstanding per subscription, and the next one is only
+sent after the client has read. A slow client never queues anything
+server-side; its unread entries stay in the shared bounded buffer.
+"""
+
+import asyncio
+from typing import Awaitable, Callable, Optional
+
+from .capture_manager import CaptureManager
+
+RESOURCE_PREFIX = "dbgcapture://sessions/"
+
+# Entries returned by one resource read
+RESOURCE_BATCH = 100
+
+# How long a watcher waits for output before re-checking for cancellation
+WATCH_POLL_MS = 1000
+
+# Delay between seeing new output and notifying, so a burst of lines is
+# announced once
+NOTIFY_COALESCE_MS = 50
+
+
+def session_uri(session_id: str) -> str:
+    """Resource URI for a session."""
+    return RESOURCE_PREFIX + session_id
+
+
+def session_id_of(uri: str) -> Optional[str]:
+    """Session ID from a resource URI, or None if it isn't a session URI."""
+    uri = str(uri)
+    if not uri.startswith(RESOURCE_PREFIX):
+        return None
+    session_id = uri[len(RESOURCE_PREFIX):]
+    return session_id or None
+
+
+class _Subscription:
+    """One subscribed session and the task that watches it."""
+
+    def __init__(self, uri: str, session_id: str):
+        self.uri = uri
+        self.session_id = session_id
+        self.read = asyncio.Event()  # Set once the client has read the last notification
+        self.read.set()
+        self.task: Optional[asyncio.Task] = None
+
+
+class SubscriptionManager:
+    """Tracks subscribed sessions and notifies when they have new output."""
+
+    def __init__(self, manager: CaptureManager, poll_ms: int = WATCH_POLL_MS):
+        self._manager = manager
+        self._poll_ms = poll_ms
+        self._subscriptions: dict[str, _Subscription] = {}
+
+    def subscribe(self, uri: str, send_updated: Callable[[str], Awaitable[None]]) -> bool:
+        """Start watching a session; send_updated(uri) notifies the client."""
+        uri = str(uri)
+        session_id = session_id_of(uri)
+        if session_id is None or self._manager.get_session(session_id) is None:
+            return False
+        if uri in self._subscriptions:
+            return True
+
+        subscription = _Subscription(uri, session_id)
+        subscription.task = asyncio.create_task(self._watch(subscription, send_updated))
+        self._subscriptions[uri] = subscription
+        return True
+
+    def unsubscribe(self, uri: str):
+        """Stop watching a session."""
+        subscription = self._subscriptions.pop(str(uri), None)
+        if subscription and subscription.task:
+            subscription.task.cancel()
+
+    def read(self, uri: str) -> Optional[dict]:
+        """Next batch of unread entries for a session resource."""
+        session_id = session_id_of(uri)
+        if session_id is None or self._manager.get_session(session_id) is None:
+            return None
+
+        entries, next_seq = self._manager.get_output(session_id, limit=RESOURCE_BATCH)
+
+        subscription = self._subscriptions.get(str(uri))
+        if subscription:
+            subscription.read.set()
+        return {"entries": entries, "count": len(entries), "next_seq": next_seq}
+
+    async def _watch(self, subscription: _Subscription, send_updated: Callable[[str], Awaitable[None]]):
+        """Notify each time unread output appears, one notification per read."""
+        try:
+            while True:
+                await subscription.read.wait()
+
+                pending = await asyncio.to_thread(
+                    self._manager.wait_for_output, subscription.session_id, self._poll_ms
+                )
+                if pending is None:
+                    break  # Session destroyed
+                if not pending:
+                    if not self._manager.is_running():
+                        # Nothing will arrive; don't spin until capture restarts
+                        await asyncio.sleep(self._poll_ms / 1000)
+                    continue
+
+                await asyncio.sleep(NOTIFY_COALESCE_MS / 1000)
+                subscription.read.clear()
+                await send_updated(subscription.uri)
+        except asyncio.CancelledError:
+            raise
+        except Exception:
+            pass  # Client went away; drop the subscription
+        finally:
+            if self._subscriptions.get(subscription.uri) is subscription:
+                del self._subscriptions[subscription.uri]
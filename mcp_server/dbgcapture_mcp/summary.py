@@ -0,0 +1,203 @@
+"""
+Summary - Grouped counts, rates and message templates over buffered output.
+
+A message's template is its text with the parts that vary between
+occurrences (GUIDs, hex values, numbers) replaced by placeholders, so
+"retry 3 of 5 after 250ms" and "retry 4 of 5 after 500ms" count as one
+message. Templates are computed from the raw text bytes, without decoding
+it, and cached per buffer block in a TemplateIndex, so each entry is
+normalized once however often the buffer is summarized.
+"""
+
+import re
+import threading
+from array import array
+from typing import Optional
+
+from .protocol import decode_text
+
+# Longest template kept; longer ones are cut here, which also merges
+# messages that only differ past this point
+MAX_TEMPLATE_BYTES = 160
+
+# Distinct templates before the index starts over, in case normalization
+# leaves something unique in every message
+MAX_TEMPLATES = 65536
+
+_GUID = re.compile(rb"[0-9a-fA-F]{8}-[0-9a-fA-F]{4}-[0-9a-fA-F]{4}-[0-9a-fA-F]{4}-[0-9a-fA-F]{12}")
+# 0x prefixed, or a long run of hex digits with at least one decimal digit
+# (addresses, hashes, handles); short runs could just be words
+_HEX = re.compile(rb"\b0[xX][0-9a-fA-F]+\b|\b(?=[a-fA-F]*[0-9])[0-9a-fA-F]{8,}\b")
+# Integers, decimals, versions and IPv4 addresses
+_NUMBER = re.compile(rb"\d+(?:\.\d+)*")
+_SPACE = re.compile(rb"\s+")
+
+# FILETIME ticks per second
+TICKS_PER_SEC = 10_000_000
+
+
+def template_of(raw: bytes) -> bytes:
+    """The template of a message's raw text."""
+    raw = _GUID.sub(b"<guid>", raw)
+    raw = _HEX.sub(b"<hex>", raw)
+    raw = _NUMBER.sub(b"<n>", raw)
+    raw = _SPACE.sub(b" ", raw).strip()
+    return raw[:MAX_TEMPLATE_BYTES]
+
+
+class TemplateIndex:
+    """
+    Template id of every buffered entry, filled in by readers as they need it.
+
+    Ids are per block ordinal, so they survive entries being appended to
+    the block and disappear when prune() is told the block was evicted.
+    Callers hold lock while using it.
+    """
+
+    def __init__(self, max_templates: int = MAX_TEMPLATES):
+        self.lock = threading.Lock()
+        self.max_templates = max_templates
+        self._ids: dict[tuple[bytes, int], int] = {}
+        self._templates: list[tuple[bytes, int]] = []  # (template, code page) by id
+        self._blocks: dict[int, array] = {}  # Block ordinal -> template id per entry
+
+    def __len__(self) -> int:
+        return len(self._templates)
+
+    def prune(self, first_ordinal: int):
+        """Forget blocks older than first_ordinal."""
+        stale = [ordinal for ordinal in self._blocks if ordinal < first_ordinal]
+        for ordinal in stale:
+            del self._blocks[ordinal]
+        if len(self._templates) > self.max_templates:
+            self._ids.clear()
+            self._templates.clear()
+            self._blocks.clear()
+
+    def block_ids(self, block) -> array:
+        """Template ids of a block's published entries."""
+        ids = self._blocks.get(block.ordinal)
+        if ids is None:
+            ids = self._blocks[block.ordinal] = array("I")
+        for i in range(len(ids), block.count):
+            key = (template_of(block.raw_at(i)), block.codepages[i])
+            template_id = self._ids.get(key)
+            if template_id is None:
+                template_id = self._ids[key] = len(self._templates)
+                self._templates.append(key)
+            ids.append(template_id)
+        return ids
+
+    def text(self, template_id: int) -> str:
+        template, codepage = self._templates[template_id]
+        return decode_text(template, codepage)
+
+
+class Summary:
+    """
+    Accumulates entries into totals, groups and template counts.
+
+    group_by is "pid", "name" (process name, across PIDs) or "none".
+    Counts are of messages, so a collapsed entry (--collapse-ms) counts as
+    the number of copies it stands for.
+    """
+
+    def __init__(self, group_by: str = "pid"):
+        if group_by not in ("pid", "name", "none"):
+            raise ValueError(f"Unknown group_by: {group_by}")
+        self.group_by = group_by
+        self.count = 0
+        self.first_time: Optional[int] = None
+        self.last_time: Optional[int] = None
+        # Group key -> [count, pid, name id, first seq, last seq]
+        self._groups: dict[int, list] = {}
+        # Template id -> [count, latest seq]
+        self._templates: dict[int, list] = {}
+        self._seconds: dict[int, int] = {}  # FILETIME second -> entries
+
+    def add(self, seq: int, time: int, pid: int, name_id: int, template_id: int, count: int = 1):
+        self.count += count
+        if self.first_time is None or time < self.first_time:
+            self.first_time = time
+        if self.last_time is None or time > self.last_time:
+            self.last_time = time
+
+        second = time // TICKS_PER_SEC
+        self._seconds[second] = self._seconds.get(second, 0) + count
+
+        if self.group_by != "none":
+            key = pid if self.group_by == "pid" else name_id
+            group = self._groups.get(key)
+            if group is None:
+                self._groups[key] = [count, pid, name_id, seq, seq]
+            else:
+                group[0] += count
+                group[4] = seq
+
+        counts = self._templates.get(template_id)
+        if counts is None:
+            self._templates[template_id] = [count, seq]
+        else:
+            counts[0] += count
+            counts[1] = seq
+
+    def result(
+        self,
+        names: list[Optional[str]],
+        templates: TemplateIndex,
+        top: int = 10,
+        start_time: Optional[int] = None,
+        end_time: Optional[int] = None
+    ) -> dict:
+        """
+        The top groups and templates by count. Rates are per second over
+        the requested time range, or the span of the entries where it is
+        open-ended.
+        """
+        window_start = start_time if start_time is not None else self.first_time
+        window_end = end_time if end_time is not None else self.last_time
+        seconds = None
+        if window_start is not None and window_end is not None and window_end > window_start:
+            seconds = (window_end - window_start) / TICKS_PER_SEC
+
+        def rate(count: int) -> Optional[float]:
+            return round(count / seconds, 3) if seconds else None
+
+        peak_second, peak = max(self._seconds.items(), key=lambda item: item[1], default=(None, 0))
+
+        result = {
+            "entries": self.count,
+            "first_time": self.first_time,
+            "last_time": self.last_time,
+            "seconds": round(seconds, 3) if seconds else None,
+            "per_sec": rate(self.count),
+            "peak_per_sec": peak,
+            "peak_time": peak_second * TICKS_PER_SEC if peak_second is not None else None,
+            "distinct_templates": len(self._templates),
+            "templates": [
+                {
+                    "template": templates.text(template_id),
+                    "count": count,
+                    "per_sec": rate(count),
+                    "example_seq": seq
+                }
+                for template_id, (count, seq) in sorted(
+                    self._templates.items(), key=lambda item: -item[1][0]
+                )[:top]
+            ]
+        }
+
+        if self.group_by != "none":
+            groups = []
+            for count, pid, name_id, first_seq, last_seq in sorted(
+                self._groups.values(), key=lambda group: -group[0]
+            )[:top]:
+                group = {"process_name": names[name_id], "count": count, "per_sec": rate(count),
+                         "first_seq": first_seq, "last_seq": last_seq}
+                if self.group_by == "pid":
+                    group = {"pid": pid, **group}
+                groups.append(group)
+            result["group_by"] = self.group_by
+            result["distinct_groups"] = len(self._groups)
+            result["groups"] = groups
+        return result
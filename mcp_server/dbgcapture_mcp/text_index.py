@@ -0,0 +1,198 @@
+"""
+Text Index - Trigram index over the text of buffered entries.
+
+Entries are grouped into chunks of consecutive entries. Once a chunk is
+complete, the distinct trigrams of the words in its lowercased text are
+added to an inverted index mapping each trigram to the ascending list of
+chunks that contain it. Only trigrams within a word (a run of ASCII
+letters, digits and '_') are kept: that skips most of the per-character
+work, since log text repeats the same words, and a literal's words always
+lie within the text's words. A search intersects the lists for the trigrams its regex
+requires, and only the chunks left over are verified with the regex.
+
+Chunks are numbered in append order, so evicting the oldest entries only
+raises the lowest indexed chunk number; the stale postings are removed in
+one pass once enough have piled up. Memory is capped: when the index grows
+past max_bytes the oldest chunks are dropped from it, and searches scan
+those unindexed chunks instead.
+"""
+
+import re
+from array import array
+from bisect import bisect_left
+from collections import deque
+from typing import Optional
+
+from .patterns import required_literals
+
+DEFAULT_MAX_BYTES = 64 * 1024 * 1024
+
+# Approximate bytes per distinct trigram (dict slot, key, list header) and
+# per posting
+GRAM_OVERHEAD = 120
+POSTING_BYTES = 4
+
+_WORDS = re.compile(rb"[0-9a-z_]{3,}")
+_LITERAL_WORDS = re.compile(r"[0-9a-z_]{3,}")
+
+# Characters that re.IGNORECASE matches against an ASCII letter but that
+# don't lowercase to one
+_FOLD_TO_ASCII = {0x130: "i", 0x131: "i", 0x17F: "s", 0x212A: "k"}
+
+
+def fold(text: bytes) -> bytes:
+    """
+    Lowercase UTF-8 text for trigram extraction.
+
+    ASCII trigrams come out the same whatever their case, and so does any
+    text that re.IGNORECASE would match against an ASCII trigram.
+    """
+    if text.isascii():
+        return text.lower()
+    decoded = text.decode("utf-8", "surrogatepass").translate(_FOLD_TO_ASCII)
+    return decoded.lower().encode("utf-8", "surrogatepass")
+
+
+def trigrams(text: bytes) -> set[int]:
+    """Distinct trigrams of the words in already folded text, packed into ints."""
+    grams: set = set()
+    for word in set(_WORDS.findall(text)):
+        grams.update(zip(word, word[1:], word[2:]))
+    return {a << 16 | b << 8 | c for a, b, c in grams}
+
+
+def required_trigrams(pattern: re.Pattern) -> set[int]:
+    """
+    Trigrams that any text pattern matches must contain once folded.
+
+    Only ASCII words of the pattern's required literals are used, since
+    folding leaves other characters' case variants apart. An empty set
+    means the index can't narrow the search.
+    """
+    grams: set[int] = set()
+    for literal in required_literals(pattern):
+        for word in _LITERAL_WORDS.findall(literal.lower()):
+            grams |= trigrams(word.encode("ascii"))
+    return grams
+
+
+class TextIndex:
+    """
+    Inverted trigram index over chunks numbered consecutively from 0.
+
+    Chunks are added in order and dropped oldest first, so the indexed
+    chunks are always the contiguous range [first_chunk, end_chunk). One
+    writer at a time (EntryStore's callers serialize them); candidates()
+    may run concurrently, since postings are only appended to in place and
+    are replaced, not cut, when compacted.
+    """
+
+    def __init__(self, max_bytes: int = DEFAULT_MAX_BYTES):
+        self.max_bytes = max_bytes
+        self._postings: dict[int, array] = {}  # Trigram -> chunk numbers, ascending
+        self._chunks: deque = deque()  # (chunk, trigram count) of indexed chunks
+        self._first = 0
+        self._end = 0
+        self._live = 0  # Postings of indexed chunks
+        self._stale = 0  # Postings of dropped chunks not yet compacted away
+
+    @property
+    def nbytes(self) -> int:
+        """Approximate bytes held by the index."""
+        return len(self._postings) * GRAM_OVERHEAD + (self._live + self._stale) * POSTING_BYTES
+
+    @property
+    def first_chunk(self) -> int:
+        return self._first
+
+    @property
+    def end_chunk(self) -> int:
+        return self._end
+
+    def covers(self, chunk: int) -> bool:
+        """True if chunk has been indexed and not dropped."""
+        return self._first <= chunk < self._end
+
+    def add(self, chunk: int, text: bytes):
+        """Index a complete chunk; chunk must follow the last one added."""
+        if self.max_bytes <= 0:
+            return
+        if chunk != self._end or not self._chunks:
+            # First chunk, or a gap after clear(); restart the range
+            self.drop_before(chunk)
+            self._first = chunk
+
+        postings = self._postings
+        grams = trigrams(fold(text))
+        for gram in grams:
+            chunks = postings.get(gram)
+            if chunks is None:
+                chunks = postings[gram] = array("I")
+            chunks.append(chunk)
+        self._chunks.append((chunk, len(grams)))
+        self._end = chunk + 1
+        self._live += len(grams)
+
+        if self.nbytes > self.max_bytes:
+            # Shed the oldest quarter, so compaction isn't paid on every chunk
+            target = self._live * 3 // 4
+            while self._chunks and self._live > target:
+                self._drop_oldest()
+            self._compact()
+
+    def _drop_oldest(self):
+        chunk, count = self._chunks.popleft()
+        self._live -= count
+        self._stale += count
+        self._first = chunk + 1
+
+    def drop_before(self, chunk: int):
+        """Drop chunks numbered below chunk, e.g. after their entries are evicted."""
+        while self._chunks and self._chunks[0][0] < chunk:
+            self._drop_oldest()
+        if not self._chunks:
+            self._first = self._end = max(self._end, chunk)
+        if self._stale > self._live:
+            self._compact()
+
+    def _compact(self):
+        """Remove postings of dropped chunks."""
+        first = self._first
+        for gram in list(self._postings):
+            chunks = self._postings[gram]
+            drop = bisect_left(chunks, first)
+            if drop == len(chunks):
+                del self._postings[gram]
+            elif drop:
+                self._postings[gram] = chunks[drop:]
+        self._stale = 0
+
+    def clear(self):
+        self._postings = {}
+        self._chunks.clear()
+        self._first = self._end = 0
+        self._live = self._stale = 0
+
+    def candidates(self, grams: set[int]) -> Optional[set[int]]:
+        """
+        Indexed chunks containing every trigram in grams, or None if grams
+        is empty and nothing can be ruled out.
+        """
+        if not grams:
+            return None
+        postings = self._postings
+        lists = []
+        for gram in grams:
+            chunks = postings.get(gram)
+            if chunks is None:
+                return set()
+            lists.append(chunks)
+        lists.sort(key=len)
+
+        first = self._first
+        result = set(lists[0][bisect_left(lists[0], first):])
+        for chunks in lists[1:]:
+            if not result:
+                break
+            result.intersection_update(chunks[bisect_left(chunks, first):])
+        return result
@@ -6,6 +6,7 @@ import re
 import pytest
 from unittest.mock import Mock, patch, MagicMock
 import threading
+import time
 
 from dbgcapture_mcp.capture_manager import (
     DebugEntry,
@@ -349,6 +350,613 @@ class TestCaptureManager:
         assert "filters" in status
         assert "ERROR" in status["filters"]["include"]
 
+    def test_configure_kernel_capture(self, mock_manager):
+        """Kernel capture adds --etw to the capture command line."""
+        import dbgcapture_mcp.capture_manager as cm
+        mock_manager.configure(kernel_capture=True)
+        mock_manager.start_capture()
+        args = cm.subprocess.Popen.call_args[0][0]
+        assert "--etw" in args
+        assert "--global" not in args
+
+    def test_global_capture_keeps_local_channel(self, mock_manager):
+        """Global capture also listens to the current session in the same process."""
+        import dbgcapture_mcp.capture_manager as cm
+        mock_manager.configure(global_capture=True)
+        mock_manager.start_capture()
+        args = cm.subprocess.Popen.call_args[0][0]
+        assert "--global" in args
+        assert "--local" in args
+
+    def test_read_binary_frames(self, mock_manager):
+        """Binary frames from stdout land in the buffer."""
+        from dbgcapture_mcp.protocol import encode_frame
+        
+        chunk = encode_frame(1, 100, 1234, b"First") + encode_frame(2, 200, 1234, b"Second")
+        process = MagicMock()
+        process.poll.return_value = None
+        
+        def read1(size):
+            mock_manager._running = False
+            return chunk
+        process.stdout.read1.side_effect = read1
+        
+        mock_manager._process = process
+        mock_manager._running = True
+        mock_manager._read_binary()
+        
+        assert [e.text for e in mock_manager._buffer] == ["First", "Second"]
+        assert mock_manager._current_seq == 2
+
+    def test_restarted_capture_continues_seqs(self, mock_manager):
+        """A new dbgcapture.exe numbering from 0 again carries on after the buffer."""
+        from dbgcapture_mcp.protocol import encode_frame
+        
+        def read_process(frames):
+            chunk = b"".join(encode_frame(seq, seq, 1, text.encode()) for seq, text in frames)
+            process = MagicMock()
+            process.poll.return_value = None
+            
+            def read1(size):
+                mock_manager._running = False
+                return chunk
+            process.stdout.read1.side_effect = read1
+            mock_manager._process = process
+            mock_manager._running = True
+            mock_manager._read_binary()
+        
+        session_id = mock_manager.create_session("test")
+        mock_manager.set_filters(session_id, include=["keep"])
+        read_process([(seq, f"keep {seq}" if seq % 2 else f"drop {seq}") for seq in range(1, 11)])
+        entries, next_seq = mock_manager.get_output(session_id, limit=100)
+        assert [e["text"] for e in entries] == ["keep 1", "keep 3", "keep 5", "keep 7", "keep 9"]
+        
+        # Linger expired or the service went away, and capture started over
+        read_process([(seq, f"keep again {seq}" if seq % 2 else f"drop {seq}") for seq in range(0, 5)])
+        assert [e.seq for e in mock_manager._buffer] == list(range(1, 16))
+        assert mock_manager._current_seq == 15
+        entries, _ = mock_manager.get_output(session_id, limit=100)
+        assert [e["text"] for e in entries] == ["keep again 1", "keep again 3"]
+        assert [e.text for e in mock_manager._buffer.iter_from(10)][:2] == ["drop 0", "keep again 1"]
+    
+    def test_read_binary_process_names(self, mock_manager):
+        """Process names come from the frames, not from per-line lookups."""
+        from dbgcapture_mcp.protocol import encode_frame
+        
+        chunk = encode_frame(1, 100, 1234, b"Named", name=b"app.exe") + encode_frame(2, 200, 4, b"Kernel", name=b"")
+        process = MagicMock()
+        process.poll.return_value = None
+        
+        def read1(size):
+            mock_manager._running = False
+            return chunk
+        process.stdout.read1.side_effect = read1
+        
+        mock_manager._process = process
+        mock_manager._running = True
+        with patch('dbgcapture_mcp.capture_manager.psutil') as mock_psutil:
+            mock_manager._read_binary()
+            mock_psutil.Process.assert_not_called()
+        
+        assert [e.process_name for e in mock_manager._buffer] == ["app.exe", None]
+
+    def test_read_binary_code_pages(self, mock_manager):
+        """Frame text is kept raw with its code page and decoded on demand."""
+        from dbgcapture_mcp.protocol import ANSI_ENCODING, FRAME_FLAG_UTF8, encode_frame
+        
+        chunk = (encode_frame(1, 100, 1234, "Grüße".encode(ANSI_ENCODING))
+                 + encode_frame(2, 200, 1234, "Grüße ✓".encode("utf-8"), flags=FRAME_FLAG_UTF8))
+        process = MagicMock()
+        process.poll.return_value = None
+        
+        def read1(size):
+            mock_manager._running = False
+            return chunk
+        process.stdout.read1.side_effect = read1
+        
+        mock_manager._process = process
+        mock_manager._running = True
+        mock_manager._read_binary()
+        
+        session_id = mock_manager.create_session("test")
+        mock_manager.set_filters(session_id, process_pids=[1234])
+        mock_manager._session_matches(mock_manager.get_session(session_id))
+        # A PID-only filter never needs the text
+        assert all(e._text is None for e in mock_manager._buffer.iter_from(None))
+        
+        entries, _ = mock_manager.get_output(session_id, since_seq=0)
+        assert [e["text"] for e in entries] == ["Grüße", "Grüße ✓"]
+    
+    def test_overflow_policy(self, mock_manager):
+        """The configured overflow policy is passed to dbgcapture.exe."""
+        import dbgcapture_mcp.capture_manager as cm
+        mock_manager.configure(overflow="drop-newest")
+        mock_manager.start_capture()
+        args = cm.subprocess.Popen.call_args[0][0]
+        assert args[args.index("--overflow") + 1] == "drop-newest"
+        assert "--collapse-ms" not in args
+    
+    def test_collapsed_runs(self, mock_manager):
+        """Repeat records from --collapse-ms come back with their count."""
+        import dbgcapture_mcp.capture_manager as cm
+        from dbgcapture_mcp.protocol import encode_frame
+        
+        mock_manager.configure(collapse_ms=500)
+        session_id = mock_manager.create_session("test")
+        args = cm.subprocess.Popen.call_args[0][0]
+        assert args[args.index("--collapse-ms") + 1] == "500"
+        
+        process = MagicMock()
+        process.poll.return_value = None
+        
+        def read1(size):
+            mock_manager._running = False
+            return (encode_frame(1, 100, 8, b"spam", mono=1)
+                    + encode_frame(40, 900, 8, b"spam", mono=9, repeat=(39, 200))
+                    + encode_frame(41, 950, 8, b"done", mono=10))
+        process.stdout.read1.side_effect = read1
+        mock_manager._process = process
+        mock_manager._running = True
+        mock_manager._read_binary()
+        
+        entries, _ = mock_manager.get_output(session_id, since_seq=0)
+        assert [(e["seq"], e["text"], e.get("repeat"), e.get("first_time")) for e in entries] == [
+            (1, "spam", None, None), (40, "spam", 39, 200), (41, "done", None, None)]
+        assert mock_manager.summarize(session_id=session_id)["entries"] == 41
+
+    def test_stderr_stats(self, mock_manager):
+        """Stats and error records from stderr show up in session status."""
+        session_id = mock_manager.create_session("test")
+        process = MagicMock()
+        process.stderr = iter([
+            b'{"status": "started"}\n',
+            b'{"stats": {"captured": 10, "dropped": 0, "blocked": 0, "blocked_ms": 0, "overflow": "drop-oldest"}}\n',
+            b'not json\n',
+            b'{"error": "Unknown control command"}\n',
+            b'{"stats": {"captured": 50, "dropped": 7, "blocked": 1, "blocked_ms": 120, "overflow": "drop-oldest"}}\n',
+        ])
+        mock_manager._stderr_loop(process)
+        
+        capture = mock_manager.get_session_status(session_id)["capture"]
+        assert capture["dropped"] == 7
+        assert capture["blocked"] == 1
+        assert capture["blocked_ms"] == 120
+        assert capture["last_error"] == "Unknown control command"
+
+    def test_start_waits_until_started(self, mock_manager):
+        """start_capture returns once dbgcapture.exe reports it is capturing."""
+        import dbgcapture_mcp.capture_manager as cm
+        release = threading.Event()
+        
+        def stderr():
+            release.wait(5)
+            yield b'{"status": "started"}\n'
+            threading.Event().wait(5)
+        cm.subprocess.Popen.return_value.stderr = stderr()
+        
+        starting = threading.Thread(target=mock_manager.create_session)
+        starting.start()
+        starting.join(0.2)
+        assert starting.is_alive()
+        assert not mock_manager._sessions
+        release.set()
+        starting.join(5)
+        assert len(mock_manager._sessions) == 1
+
+    def test_start_failure_reported(self, mock_manager):
+        """A dbgcapture.exe that exits during startup fails create_session with its error."""
+        import dbgcapture_mcp.capture_manager as cm
+        process = cm.subprocess.Popen.return_value
+        process.stderr = iter([b'{"error": "Failed to create local DBWIN_BUFFER: 5"}\n'])
+        process.poll.return_value = 1
+        
+        with pytest.raises(RuntimeError, match="DBWIN_BUFFER"):
+            mock_manager.create_session("test")
+        assert not mock_manager.is_running()
+
+    def test_start_timeout_reported(self, mock_manager):
+        """No handshake within STARTUP_TIMEOUT fails create_session instead of creating it."""
+        import dbgcapture_mcp.capture_manager as cm
+        release = threading.Event()
+        
+        def stderr():
+            release.wait(5)
+            return
+            yield
+        process = cm.subprocess.Popen.return_value
+        process.stderr = stderr()
+        process.terminate.side_effect = release.set  # Its stderr closes
+        
+        with patch.object(cm, "STARTUP_TIMEOUT", 0.1):
+            with pytest.raises(RuntimeError, match="did not report starting"):
+                mock_manager.create_session("test")
+        assert not mock_manager._sessions
+        assert process.terminate.called
+        assert "did not report starting" in mock_manager._last_error
+
+    def test_linger(self, mock_manager):
+        """Capture outlives the last session by linger_ms, unless a new one comes."""
+        import dbgcapture_mcp.capture_manager as cm
+        mock_manager.configure(linger_ms=100)
+        
+        first = mock_manager.create_session("first")
+        mock_manager.destroy_session(first)
+        assert mock_manager.get_capture_stats()["lingering"]
+        mock_manager.create_session("second")
+        assert cm.subprocess.Popen.call_count == 1
+        assert not mock_manager.get_capture_stats()["lingering"]
+        
+        time.sleep(0.3)
+        process = cm.subprocess.Popen.return_value
+        assert not process.terminate.called
+        
+        mock_manager.destroy_session(next(iter(mock_manager._sessions)))
+        deadline = time.monotonic() + 5
+        while not process.terminate.called and time.monotonic() < deadline:
+            time.sleep(0.01)
+        assert process.terminate.called
+        assert not mock_manager.get_capture_stats()["lingering"]
+
+    def test_capture_stats(self, mock_manager):
+        """Parse, lock and filter counters accumulate as output flows."""
+        from dbgcapture_mcp.protocol import encode_frame
+        
+        session_id = mock_manager.create_session("test")
+        mock_manager.set_filters(session_id, include=["Second"])
+        process = MagicMock()
+        process.poll.return_value = None
+        
+        def read1(size):
+            mock_manager._running = False
+            return encode_frame(1, 100, 1234, b"First") + encode_frame(2, 200, 1234, b"Second")
+        process.stdout.read1.side_effect = read1
+        mock_manager._process = process
+        mock_manager._running = True
+        mock_manager._read_binary()
+        mock_manager.get_output(session_id)
+        
+        stats = mock_manager.get_capture_stats()
+        assert stats["reader"]["entries"] == 2
+        assert stats["buffer"]["entries"] == 2
+        assert stats["locks"]["buffer"]["acquisitions"] > 0
+        assert stats["locks"]["sessions"]["acquisitions"] > 0
+        assert stats["sessions"][0]["session_id"] == session_id
+        assert stats["sessions"][0]["evaluated"] == 2
+        assert stats["native"] == {}
+
+    def test_summarize(self, mock_manager):
+        """Summaries use the session's matches and leave its cursor alone."""
+        session_id = mock_manager.create_session("test")
+        mock_manager.set_filters(session_id, include=["error"])
+        for seq in range(1, 11):
+            text = f"error {seq} in worker" if seq % 2 else f"ok {seq}"
+            mock_manager._buffer.append(DebugEntry(seq=seq, time=seq, pid=seq % 3, text=text))
+        cursor = mock_manager.get_session(session_id).cursor
+    
+        result = mock_manager.summarize(session_id=session_id, group_by="none")
+        assert result["entries"] == 5
+        assert result["templates"][0]["template"] == "error <n> in worker"
+        assert mock_manager.summarize(pids=[0])["entries"] == 3
+        assert mock_manager.get_session(session_id).cursor == cursor
+        assert mock_manager.summarize(session_id="nonexistent") is None
+    
+    def test_get_output_during_ingestion(self, mock_manager):
+        """Polling without the buffer lock returns each entry once, in order."""
+        session_id = mock_manager.create_session("test")
+        mock_manager.set_filters(session_id, include=["even"])
+        total = 5000
+        
+        def write():
+            for i in range(1, total + 1):
+                entry = DebugEntry(seq=i, time=i, pid=1, text="even" if i % 2 == 0 else "odd")
+                with mock_manager._buffer_lock:
+                    mock_manager._buffer.append(entry)
+                    mock_manager._current_seq = i
+                with mock_manager._buffer_changed:
+                    mock_manager._buffer_changed.notify_all()
+        
+        writer = threading.Thread(target=write)
+        writer.start()
+        seen = []
+        while writer.is_alive() or len(seen) < total // 2:
+            entries, _ = mock_manager.get_output(session_id, limit=50, wait_ms=10)
+            seen.extend(e["seq"] for e in entries)
+            if not entries and not writer.is_alive():
+                break
+        writer.join()
+        
+        assert seen == list(range(2, total + 1, 2))
+    
+    def test_missed_entries(self, mock_manager):
+        """Entries evicted before a session reads them are counted once."""
+        from dbgcapture_mcp.entry_store import ENTRY_OVERHEAD, EntryStore
+        session_id = mock_manager.create_session("test")
+        mock_manager._buffer = EntryStore(max_bytes=(ENTRY_OVERHEAD + 10) * 40, block_entries=8)
+        for i in range(1, 201):
+            mock_manager._buffer.append(DebugEntry(seq=i, time=0, pid=1, text=f"line {i:05d}"))
+        first = mock_manager._buffer.first_seq
+        
+        status = mock_manager.get_session_status(session_id)
+        assert status["missed"] == first - 1
+        assert status["buffer_evicted"] == first - 1
+        
+        entries, _ = mock_manager.get_output(session_id, limit=5)
+        assert entries[0]["seq"] == first
+        assert mock_manager.get_session_status(session_id)["missed"] == first - 1
+
+    def test_read_binary_mono(self, mock_manager):
+        """Monotonic times from the frames reach get_output."""
+        from dbgcapture_mcp.protocol import encode_frame
+        
+        chunk = encode_frame(1, 100, 1234, b"First", name=b"app.exe", mono=5000) + encode_frame(2, 100, 1234, b"Second", mono=5003)
+        process = MagicMock()
+        process.poll.return_value = None
+        
+        def read1(size):
+            mock_manager._running = False
+            return chunk
+        process.stdout.read1.side_effect = read1
+        
+        mock_manager._process = process
+        mock_manager._running = True
+        mock_manager._read_binary()
+        
+        session_id = mock_manager.create_session("test")
+        entries, _ = mock_manager.get_output(session_id, since_seq=0)
+        assert [(e["mono"], e["process_name"], e["text"]) for e in entries] == [
+            (5000, "app.exe", "First"), (5003, None, "Second")
+        ]
+
+    def test_pending_count(self, mock_manager):
+        """Status reports matching entries after the cursor."""
+        session_id = mock_manager.create_session("test")
+        mock_manager.set_filters(session_id, include=[r"ERROR"])
+        
+        for i in range(10):
+            text = "ERROR here" if i % 2 else "fine"
+            mock_manager._buffer.append(DebugEntry(seq=i + 1, time=0, pid=1, text=text))
+        
+        assert mock_manager.get_session_status(session_id)["pending_count"] == 5
+        mock_manager.get_output(session_id, limit=2)
+        assert mock_manager.get_session_status(session_id)["pending_count"] == 3
+
+    def test_entries_evaluated_once(self, mock_manager):
+        """Repeated polls and status calls don't re-run filters on seen entries."""
+        session_id = mock_manager.create_session("test")
+        mock_manager.set_filters(session_id, include=[r"Message"])
+        session = mock_manager.get_session(session_id)
+        
+        calls = []
+        original = session.filters.matches
+        session.filters.matches = lambda entry: calls.append(entry.seq) or original(entry)
+        
+        for i in range(5):
+            mock_manager._buffer.append(DebugEntry(seq=i + 1, time=0, pid=1, text=f"Message {i + 1}"))
+        
+        mock_manager.get_session_status(session_id)
+        mock_manager.get_output(session_id, limit=2)
+        mock_manager.get_output(session_id, limit=2, since_seq=0)
+        mock_manager.get_session_status(session_id)
+        assert sorted(calls) == [1, 2, 3, 4, 5]
+        
+        mock_manager._buffer.append(DebugEntry(seq=6, time=0, pid=1, text="Message 6"))
+        entries, _ = mock_manager.get_output(session_id, limit=10)
+        assert [e["seq"] for e in entries] == [3, 4, 5, 6]
+        assert sorted(calls) == [1, 2, 3, 4, 5, 6]
+
+    def test_set_filters_invalidates_matches(self, mock_manager):
+        """Changing filters re-evaluates the buffer against the new ones."""
+        session_id = mock_manager.create_session("test")
+        mock_manager._buffer.append(DebugEntry(seq=1, time=0, pid=1, text="alpha"))
+        mock_manager._buffer.append(DebugEntry(seq=2, time=0, pid=1, text="beta"))
+        
+        assert mock_manager.get_session_status(session_id)["pending_count"] == 2
+        mock_manager.set_filters(session_id, include=[r"beta"])
+        assert mock_manager.get_session_status(session_id)["pending_count"] == 1
+        
+        entries, _ = mock_manager.get_output(session_id)
+        assert [e["text"] for e in entries] == ["beta"]
+
+    def test_get_output_waits_for_match(self, mock_manager):
+        """wait_ms returns as soon as a matching entry is appended."""
+        session_id = mock_manager.create_session("test")
+        mock_manager.set_filters(session_id, include=[r"wanted"])
+        
+        def produce():
+            time.sleep(0.05)
+            with mock_manager._buffer_changed:
+                mock_manager._buffer.append(DebugEntry(seq=1, time=0, pid=1, text="noise"))
+                mock_manager._buffer_changed.notify_all()
+            time.sleep(0.05)
+            with mock_manager._buffer_changed:
+                mock_manager._buffer.append(DebugEntry(seq=2, time=0, pid=1, text="wanted"))
+                mock_manager._buffer_changed.notify_all()
+        
+        producer = threading.Thread(target=produce)
+        producer.start()
+        started = time.monotonic()
+        entries, next_seq = mock_manager.get_output(session_id, wait_ms=5000)
+        producer.join()
+        
+        assert [e["seq"] for e in entries] == [2]
+        assert next_seq == 2
+        assert time.monotonic() - started < 2
+
+    def test_get_output_wait_times_out(self, mock_manager):
+        """wait_ms returns empty once the timeout passes."""
+        session_id = mock_manager.create_session("test")
+        started = time.monotonic()
+        entries, _ = mock_manager.get_output(session_id, wait_ms=50)
+        assert entries == []
+        assert time.monotonic() - started >= 0.05
+
+    def test_get_output_reads_spilled_history(self, mock_manager, tmp_path):
+        """An old since_seq is served from the spill log, then continues in memory."""
+        from dbgcapture_mcp.entry_store import EntryStore
+        
+        mock_manager.configure(spill_dir=tmp_path)
+        mock_manager._buffer = EntryStore(max_bytes=2000, block_entries=10)
+        session_id = mock_manager.create_session("test")
+        mock_manager.set_filters(session_id, include=[r"keep"])
+        
+        entries = [
+            DebugEntry(seq=i, time=0, pid=1, text=f"keep {i}" if i % 10 == 0 else f"drop {i}")
+            for i in range(1, 201)
+        ]
+        mock_manager._spill.extend(entries)
+        mock_manager._buffer.extend(entries)
+        first_in_memory = mock_manager._buffer.first_seq
+        assert first_in_memory > 100
+        
+        results, next_seq = mock_manager.get_output(session_id, limit=5, since_seq=0)
+        assert [e["seq"] for e in results] == [10, 20, 30, 40, 50]
+        assert next_seq == 50
+        
+        results, next_seq = mock_manager.get_output(session_id, limit=100, since_seq=next_seq)
+        assert [e["seq"] for e in results] == list(range(60, 201, 10))
+        mock_manager._spill.close()
+
+    def test_export_session(self, mock_manager, tmp_path):
+        """Exports write the session's matches, spilled ones included, as binary frames."""
+        from dbgcapture_mcp.entry_store import EntryStore
+        from dbgcapture_mcp.protocol import ANSI_ENCODING, FrameDecoder, split_payload
+        
+        mock_manager.configure(spill_dir=tmp_path / "spill")
+        mock_manager._buffer = EntryStore(max_bytes=2000, block_entries=10)
+        session_id = mock_manager.create_session("test")
+        mock_manager.set_filters(session_id, include=[r"keep"])
+        
+        entries = [
+            DebugEntry(seq=i, time=i, pid=1, process_name="café.exe",
+                       text=f"keep {i}" if i % 10 == 0 else f"drop {i}")
+            for i in range(1, 201)
+        ]
+        mock_manager._spill.extend(entries)
+        mock_manager._buffer.extend(entries)
+        assert mock_manager._buffer.first_seq > 100
+        cursor = mock_manager.get_session(session_id).cursor
+        
+        path = tmp_path / "out.bin"
+        result = mock_manager.export_session(session_id, str(path))
+        assert result == {"path": str(path), "rows": 20}
+        frames = FrameDecoder().feed(path.read_bytes())
+        assert [frame.seq for frame in frames] == list(range(10, 201, 10))
+        # Names are ANSI, as from dbgcapture.exe, whether spilled or buffered
+        for frame in (frames[0], frames[-1]):
+            _, name, _ = split_payload(frame)
+            assert name.decode(ANSI_ENCODING) == "café.exe"
+        assert split_payload(frames[0])[2] == b"keep 10"
+        assert not (tmp_path / "out.bin.partial").exists()
+        assert mock_manager.get_session(session_id).cursor == cursor
+        
+        with pytest.raises(FileExistsError):
+            mock_manager.export_session(session_id, str(path))
+        assert len(FrameDecoder().feed(path.read_bytes())) == 20
+        
+        result = mock_manager.export_session(session_id, str(tmp_path / "recent.bin"), since_seq=150)
+        assert result["rows"] == 5
+        assert mock_manager.export_session("nonexistent") is None
+        mock_manager._spill.close()
+    
+    def test_export_session_default_path(self, mock_manager, tmp_path):
+        """Without a path the export goes to a new file in the temp directory."""
+        session_id = mock_manager.create_session("test")
+        mock_manager._buffer.extend(DebugEntry(seq=i, time=i, pid=1, text="line") for i in range(1, 4))
+        
+        with patch("dbgcapture_mcp.capture_manager.tempfile.gettempdir", return_value=str(tmp_path)):
+            result = mock_manager.export_session(session_id)
+        assert result["rows"] == 3
+        assert result["path"].startswith(str(tmp_path / f"dbgcapture-{session_id}-"))
+
+    def test_query_by_pid_and_time(self, mock_manager):
+        """query combines the PID and time indexes with session filters."""
+        for i in range(1, 41):
+            mock_manager._buffer.append(DebugEntry(
+                seq=i, time=1000 + i, pid=10 if i % 2 else 20, text="ERROR" if i % 4 == 1 else "ok"
+            ))
+        
+        entries, next_seq = mock_manager.query(pids=[10], start_time=1011, end_time=1020)
+        assert [e["seq"] for e in entries] == [11, 13, 15, 17, 19]
+        assert next_seq == 40
+        
+        entries, next_seq = mock_manager.query(pids=[10], limit=2)
+        assert [e["seq"] for e in entries] == [1, 3]
+        entries, _ = mock_manager.query(pids=[10], limit=2, since_seq=next_seq)
+        assert [e["seq"] for e in entries] == [5, 7]
+        
+        session_id = mock_manager.create_session("test")
+        mock_manager.set_filters(session_id, include=[r"ERROR"])
+        entries, _ = mock_manager.query(pids=[10], end_time=1020, session_id=session_id)
+        assert [e["seq"] for e in entries] == [1, 5, 9, 13, 17]
+        assert mock_manager.query(session_id="nonexistent") is None
+
+    def test_search(self, mock_manager):
+        """search finds text anywhere in the buffer and pages like query."""
+        for i in range(1, 41):
+            mock_manager._buffer.append(DebugEntry(
+                seq=i, time=1000 + i, pid=10 if i % 2 else 20, text=f"Request {i} TIMEOUT" if i % 5 == 0 else f"ok {i}"
+            ))
+        
+        entries, next_seq = mock_manager.search("timeout")
+        assert [e["seq"] for e in entries] == [5, 10, 15, 20, 25, 30, 35, 40]
+        assert next_seq == 40
+        entries, _ = mock_manager.search("timeout", case_sensitive=True)
+        assert entries == []
+        
+        entries, next_seq = mock_manager.search(r"request \d+ timeout", pids=[10], limit=2)
+        assert [e["seq"] for e in entries] == [5, 15]
+        entries, _ = mock_manager.search(r"request \d+ timeout", pids=[10], since_seq=next_seq)
+        assert [e["seq"] for e in entries] == [25, 35]
+        
+        session_id = mock_manager.create_session("test")
+        mock_manager.set_filters(session_id, exclude=[r"Request 1\d"])
+        entries, _ = mock_manager.search("timeout", session_id=session_id)
+        assert [e["seq"] for e in entries] == [5, 20, 25, 30, 35, 40]
+        assert mock_manager.search("x", session_id="nonexistent") is None
+
+    def test_native_filter_union(self, mock_manager):
+        """Each session's filter is pushed, widened to what dbgcapture.exe can check."""
+        first = mock_manager.create_session("first")
+        mock_manager.set_filters(
+            first,
+            include=[r"\[ERROR\]", r"warn"],
+            exclude=[r"NOISE", r"^debug"],
+            process_pids=[1234]
+        )
+        second = mock_manager.create_session("second")
+        mock_manager.set_filters(second, include=[r"ERR\d+"], process_names=[r"notepad"])
+        
+        assert mock_manager._native_filter() == [
+            "filter begin",
+            "session", "pid 1234", "include [ERROR]", "include warn", "exclude NOISE",
+            "session", "name notepad",
+            "filter end",
+        ]
+
+    def test_set_filters_pushes_native_filter(self, mock_manager):
+        """Filter changes are written to the control channel."""
+        import dbgcapture_mcp.capture_manager as cm
+        
+        mock_manager.configure(native_filter=True)
+        session_id = mock_manager.create_session("test")
+        stdin = mock_manager._process.stdin
+        stdin.write.reset_mock()
+        
+        mock_manager.set_filters(session_id, include=[r"ERROR"])
+        payload = stdin.write.call_args[0][0]
+        assert payload == b"filter begin\nsession\ninclude ERROR\nfilter end\n"
+        
+        assert "--control" in cm.subprocess.Popen.call_args[0][0]
+
+    def test_native_filter_off_by_default(self, mock_manager):
+        """Without native_filter everything is captured, for query, search and summarize."""
+        import dbgcapture_mcp.capture_manager as cm
+        
+        session_id = mock_manager.create_session("test")
+        mock_manager.set_filters(session_id, include=[r"ERROR"])
+        assert "--control" not in cm.subprocess.Popen.call_args[0][0]
+        mock_manager._process.stdin.write.assert_not_called()
+
     def test_list_processes(self, mock_manager):
         """Test process listing."""
         with patch('dbgcapture_mcp.capture_manager.psutil') as mock_psutil:
@@ -377,6 +985,100 @@ class TestCaptureManager:
             assert processes[0]["name"] == "python.exe"
 
 
+class TestSharedCapture:
+    """Tests for reading from a shared capture service."""
+
+    @pytest.fixture
+    def manager(self, tmp_path):
+        CaptureManager._instance = None
+        address = str(tmp_path / "service")
+        
+        with patch('dbgcapture_mcp.capture_manager.subprocess') as mock_subprocess, \
+                patch.object(CaptureManager, '_service_address', lambda self: address):
+            mock_subprocess.CREATE_NO_WINDOW = 0
+            manager = CaptureManager()
+            manager._capture_exe = MagicMock()
+            manager._capture_exe.exists.return_value = True
+            manager._capture_exe.__str__ = lambda x: "dbgcapture.exe"
+            manager.configure(shared="test")
+            self.address = address
+            self.popen = mock_subprocess.Popen
+            
+            yield manager
+            
+            manager.stop_capture()
+            CaptureManager._instance = None
+
+    def serve(self):
+        """A one-reader service sending what is put on the returned queue; None hangs up."""
+        import queue
+        from multiprocessing.connection import Listener
+        listener = Listener(self.address)
+        messages = queue.Queue()
+        
+        def run():
+            with listener.accept() as conn:
+                for message in iter(messages.get, None):
+                    conn.send_bytes(message)
+            listener.close()
+        
+        thread = threading.Thread(target=run, daemon=True)
+        thread.start()
+        return messages, thread
+
+    def test_attach_to_running_service(self, manager):
+        from dbgcapture_mcp.protocol import encode_frame
+        
+        messages, thread = self.serve()
+        session_id = manager.create_session("test")
+        assert not self.popen.called
+        messages.put(encode_frame(7, 100, 8, b"first", name=b"app.exe") + encode_frame(8, 110, 8, b"second"))
+        messages.put(encode_frame(9, 120, 9, b"third"))
+        
+        seen = []
+        while len(seen) < 3:
+            entries, _ = manager.get_output(session_id, wait_ms=5000)
+            assert entries
+            seen.extend((e["seq"], e["text"]) for e in entries)
+        assert seen == [(7, "first"), (8, "second"), (9, "third")]
+        assert manager.is_running()
+        assert manager.get_capture_stats()["shared"] == "test"
+        
+        # Leaving disconnects without stopping the service
+        manager.destroy_session(session_id)
+        assert manager._service is None
+        assert not manager.is_running()
+        messages.put(None)
+        thread.join(5)
+
+    def test_starts_service(self, manager):
+        def start(args, **kwargs):
+            self.serve()
+            return MagicMock()
+        self.popen.side_effect = start
+        
+        manager.create_session("test")
+        args = self.popen.call_args[0][0]
+        assert args[args.index("--serve") + 1] == "test"
+        assert "--binary" in args
+        assert "--control" not in args
+        assert manager.is_running()
+
+    def test_service_gone(self, manager):
+        from dbgcapture_mcp.protocol import encode_frame
+        
+        messages, thread = self.serve()
+        session_id = manager.create_session("test")
+        messages.put(encode_frame(1, 100, 8, b"last"))
+        messages.put(None)
+        manager._reader_thread.join(5)
+        
+        assert not manager.is_running()
+        assert "disconnected" in manager.get_session_status(session_id)["capture"]["last_error"]
+        entries, _ = manager.get_output(session_id)
+        assert [e["text"] for e in entries] == ["last"]
+
+
 class TestGetManager:
     """Tests for get_manager function."""
 
@@ -0,0 +1,381 @@
+"""
+Unit tests for the columnar EntryStore ring buffer.
+"""
+
+import re
+import sys
+import threading
+from unittest.mock import patch
+
+from dbgcapture_mcp.entry_store import ENTRY_OVERHEAD, DebugEntry, EntryStore
+from dbgcapture_mcp.protocol import ANSI_ENCODING, CP_ACP, CP_UTF8
+
+
+def make_entry(seq, text="Message", pid=1234, name="test.exe"):
+    return DebugEntry(seq=seq, time=1000 + seq, pid=pid, text=text, process_name=name)
+
+
+class TestEntryStore:
+    """Tests for EntryStore."""
+
+    def test_empty(self):
+        """A new store has no entries."""
+        store = EntryStore()
+        assert len(store) == 0
+        assert list(store) == []
+        assert store.first_seq is None
+        assert store.last_seq is None
+        assert store.nbytes == 0
+
+    def test_round_trip(self):
+        """Entries come back with every field intact."""
+        store = EntryStore()
+        store.append(make_entry(1, "Hello", pid=42, name="app.exe"))
+        store.append(make_entry(2, "Ünïcode ✓", pid=43, name=None))
+        store.append(DebugEntry(seq=3, time=1003, pid=42, text="Timed", mono=0))
+        
+        entries = list(store)
+        assert entries[0] == DebugEntry(seq=1, time=1001, pid=42, text="Hello", process_name="app.exe")
+        assert entries[0].mono is None
+        assert entries[1].text == "Ünïcode ✓"
+        assert entries[1].process_name is None
+        assert entries[2].mono == 0
+
+    def test_spans_blocks(self):
+        """Iteration crosses block boundaries in order."""
+        store = EntryStore(block_entries=4)
+        store.extend(make_entry(i, f"Message {i}") for i in range(1, 11))
+        
+        assert len(store) == 10
+        assert [e.seq for e in store] == list(range(1, 11))
+        assert store.first_seq == 1
+        assert store.last_seq == 10
+
+    def test_process_names_interned(self):
+        """Repeated process names share one stored string."""
+        store = EntryStore()
+        store.extend(make_entry(i, name="same.exe") for i in range(100))
+        assert len(store._names) == 2
+
+    def test_bounded_by_bytes(self):
+        """Oldest blocks are evicted once max_bytes is exceeded."""
+        per_entry = ENTRY_OVERHEAD + len("x" * 100)
+        store = EntryStore(max_bytes=per_entry * 20, block_entries=5)
+        store.extend(make_entry(i, "x" * 100) for i in range(1, 101))
+        
+        assert store.nbytes <= per_entry * 20
+        assert store.last_seq == 100
+        assert store.first_seq > 1
+        assert store.evicted == 100 - len(store)
+        assert [e.seq for e in store] == list(range(store.first_seq, 101))
+
+    def test_newest_block_always_kept(self):
+        """A limit smaller than one block still keeps the newest entries."""
+        store = EntryStore(max_bytes=1, block_entries=8)
+        store.extend(make_entry(i) for i in range(1, 20))
+        assert len(store) > 0
+        assert store.last_seq == 19
+
+    def test_clear(self):
+        """Clear removes everything."""
+        store = EntryStore()
+        store.extend(make_entry(i) for i in range(5))
+        store.clear()
+        assert len(store) == 0
+        assert list(store) == []
+
+    def test_iter_from_contiguous(self):
+        """iter_from seeks directly to entries after since_seq."""
+        store = EntryStore(block_entries=4)
+        store.extend(make_entry(i) for i in range(1, 21))
+        
+        assert [e.seq for e in store.iter_from(0)] == list(range(1, 21))
+        assert [e.seq for e in store.iter_from(7)] == list(range(8, 21))
+        assert [e.seq for e in store.iter_from(8)] == list(range(9, 21))
+        assert list(store.iter_from(20)) == []
+        assert list(store.iter_from(100)) == []
+
+    def test_iter_from_with_gaps(self):
+        """Gaps in sequence numbers fall back to binary search."""
+        store = EntryStore(block_entries=3)
+        seqs = [2, 3, 7, 10, 11, 12, 40, 41, 50]
+        store.extend(make_entry(s) for s in seqs)
+        
+        for since in range(0, 55):
+            expected = [s for s in seqs if s > since]
+            assert [e.seq for e in store.iter_from(since)] == expected, since
+
+    def test_iter_from_after_eviction(self):
+        """A since_seq older than the ring starts at the oldest entry."""
+        store = EntryStore(max_bytes=(ENTRY_OVERHEAD + 7) * 8, block_entries=4)
+        store.extend(make_entry(i) for i in range(1, 41))
+        
+        first = store.first_seq
+        assert first > 1
+        assert [e.seq for e in store.iter_from(0)][0] == first
+
+    def test_query_by_pid(self):
+        """PID queries follow the posting list across blocks."""
+        store = EntryStore(block_entries=4)
+        store.extend(make_entry(i, pid=100 + i % 3) for i in range(1, 31))
+        assert [e.seq for e in store.query(pids=[101])] == list(range(1, 31, 3))
+        assert [e.seq for e in store.query(pids=[101, 102])] == [i for i in range(1, 31) if i % 3 != 0]
+        assert [e.seq for e in store.query(pids=[101], since_seq=20)] == [22, 25, 28]
+        assert list(store.query(pids=[999])) == []
+
+    def test_query_by_time(self):
+        """Time ranges are inclusive and skip blocks outside them."""
+        store = EntryStore(block_entries=4)
+        store.extend(make_entry(i) for i in range(1, 31))  # time = 1000 + seq
+        assert [e.seq for e in store.query(start_time=1010, end_time=1013)] == [10, 11, 12, 13]
+        assert [e.seq for e in store.query(start_time=1028)] == [28, 29, 30]
+        assert [e.seq for e in store.query(pids=[1234], end_time=1002)] == [1, 2]
+
+    def test_query_unsorted_times(self):
+        """Blocks whose times go backwards are checked entry by entry."""
+        store = EntryStore(block_entries=4)
+        times = [5, 3, 9, 1, 7, 2, 8, 4]
+        store.extend(DebugEntry(seq=i + 1, time=t, pid=1, text="x") for i, t in enumerate(times))
+        assert [e.time for e in store.query(start_time=3, end_time=7)] == [5, 3, 7, 4]
+
+    def test_query_after_eviction(self):
+        """Evicted entries leave the posting lists."""
+        store = EntryStore(max_bytes=ENTRY_OVERHEAD * 20, block_entries=4)
+        store.extend(make_entry(i, text="", pid=i % 2) for i in range(1, 101))
+        first = store.first_seq
+        assert [e.seq for e in store.query(pids=[0])] == [i for i in range(first, 101) if i % 2 == 0]
+        assert sum(len(p) for p in store._postings.values()) == len(store)
+
+    def test_search_matches_full_scan(self):
+        """Indexed search returns exactly what a regex scan would."""
+        store = EntryStore(block_entries=8)
+        words = ["timeout", "deadlock", "Connection reset", "ok", "TIMEOUT retry", "größe"]
+        store.extend(make_entry(i, text=f"{words[i % len(words)]} #{i}", pid=i % 3) for i in range(1, 201))
+        
+        for pattern in ["timeout", "connection RESET", r"dead\w+ #1\d", "GRÖSSE", "time|dead", "missing"]:
+            regex = re.compile(pattern, re.IGNORECASE)
+            expected = [e.seq for e in store if regex.search(e.text)]
+            assert [e.seq for e in store.search(regex)] == expected, pattern
+        
+        regex = re.compile("timeout", re.IGNORECASE)
+        assert [e.seq for e in store.search(regex, pids=[0], since_seq=100)] == [
+            e.seq for e in store.iter_from(100) if e.pid == 0 and regex.search(e.text)
+        ]
+
+    def test_search_skips_chunks(self):
+        """Chunks without the required trigrams are never verified."""
+        store = EntryStore(block_entries=8)
+        store.extend(make_entry(i, text="needle" if i == 50 else "hay") for i in range(1, 101))
+        
+        checked = []
+        
+        class Spy:
+            flags = re.IGNORECASE
+            pattern = "needle"
+            
+            def search(self, text):
+                checked.append(text)
+                return "needle" in text
+        
+        assert [e.seq for e in store.search(Spy())] == [50]
+        # The chunk holding the match, plus the unindexed partial chunk
+        assert len(checked) <= 8 + 4
+
+    def test_search_after_eviction(self):
+        """Evicted chunks leave the index, and their entries aren't returned."""
+        store = EntryStore(max_bytes=(ENTRY_OVERHEAD + 12) * 40, block_entries=8)
+        store.extend(make_entry(i, text=f"line {i:07d}") for i in range(1, 1001))
+        first = store.first_seq
+        assert first > 1
+        
+        regex = re.compile("line")
+        assert [e.seq for e in store.search(regex)] == list(range(first, 1001))
+        assert store._index.first_chunk >= (first - 1) // 8
+        index = store._index
+        assert min(index.candidates({ord("l") << 16 | ord("i") << 8 | ord("n")})) == index.first_chunk
+        # Dropped chunks' postings are compacted away once they outnumber live ones
+        assert index._stale <= index._live
+
+    def test_search_index_capped(self):
+        """Past the cap the oldest chunks are unindexed but still searched."""
+        store = EntryStore(block_entries=8, index_bytes=20000)
+        store.extend(make_entry(i, text=f"unique {i * 7919:08d}") for i in range(1, 2001))
+        assert 0 < store.index_nbytes <= 20000
+        assert store._index.first_chunk > 0
+        
+        regex = re.compile(f"unique {5 * 7919:08d}")
+        assert [e.seq for e in store.search(regex)] == [5]
+        regex = re.compile(f"unique {1999 * 7919:08d}")
+        assert [e.seq for e in store.search(regex)] == [1999]
+
+    def test_raw_text_decoded_lazily(self):
+        """Raw entries are stored undecoded and decode on first .text read."""
+        store = EntryStore(block_entries=4)
+        store.append(DebugEntry(seq=1, time=0, pid=7, raw="Grüße".encode(ANSI_ENCODING), codepage=CP_ACP))
+        store.append(DebugEntry(seq=2, time=0, pid=8, raw="Grüße ✓".encode("utf-8"), codepage=CP_UTF8))
+        store.append(make_entry(3, text="Decoded ✓"))
+
+        first = next(store.query(pids=[7]))
+        assert first._text is None
+        assert first.text == "Grüße"
+        assert [e.text for e in store] == ["Grüße", "Grüße ✓", "Decoded ✓"]
+
+    def test_search_ansi_text(self):
+        """Chunks holding non-ASCII ANSI text are still indexed and searched."""
+        store = EntryStore(block_entries=8)
+        for i in range(1, 17):
+            text = f"Gerät {i} Fehler" if i % 4 else f"Gerät {i} bereit"
+            store.append(DebugEntry(seq=i, time=0, pid=1, raw=text.encode(ANSI_ENCODING), codepage=CP_ACP))
+        assert store._index.end_chunk == 2
+        assert [e.seq for e in store.search(re.compile("bereit"))] == [4, 8, 12, 16]
+        assert [e.text for e in store.search(re.compile("Gerät 5 "))] == ["Gerät 5 Fehler"]
+
+
+    def test_repeat_fields(self):
+        """Collapsed entries keep their repeat count; others read back as single."""
+        store = EntryStore(block_entries=4)
+        store.extend([make_entry(1), DebugEntry(seq=2, time=9, pid=1, text="spam", repeat=50, first_time=3),
+                      make_entry(3)])
+        entries = list(store)
+        assert [(e.repeat, e.first_time) for e in entries] == [(1, None), (50, 3), (1, None)]
+        assert store.get(2) == DebugEntry(seq=2, time=9, pid=1, text="spam", repeat=50, first_time=3)
+        assert store.nbytes > EntryStore(block_entries=4).nbytes
+
+
+class TestColdBlocks:
+    """Tests for compressing the text of older blocks."""
+
+    def make_store(self, count=64, **kwargs):
+        store = EntryStore(block_entries=8, hot_blocks=2, **kwargs)
+        store.extend(make_entry(i, text=f"request {i % 5} handled in {i % 3} ms", pid=100 + i // 16)
+                     for i in range(1, count + 1))
+        return store
+
+    def test_older_blocks_compressed(self):
+        store = self.make_store()
+        plain = EntryStore(block_entries=8)
+        plain.extend(store)
+
+        # 8 blocks: the growing one, the 2 newest full ones and 5 cold ones
+        assert store.cold_blocks == 5
+        assert [b.packed is not None for b in store._blocks] == [True] * 5 + [False] * 3
+        assert store.nbytes < plain.nbytes
+        assert 0 < store.cold_ratio < 1
+        assert list(store) == list(plain)
+        assert store.get(3) == plain.get(3)
+
+    def test_lookups_on_cold_blocks(self):
+        store = self.make_store()
+        pattern = re.compile(r"request 4 handled in 2")
+
+        assert [e.seq for e in store.query(pids=[101], start_time=1000 + 20)] == list(range(20, 32))
+        assert [e.seq for e in store.search(pattern)] == [i for i in range(1, 65) if i % 5 == 4 and i % 3 == 2]
+        assert store.summarize()["distinct_templates"] == 1
+
+    def test_search_by_pid_skips_cold_blocks(self):
+        store = self.make_store()
+        with patch("dbgcapture_mcp.entry_store.zlib.decompress", wraps=__import__("zlib").decompress) as unpack:
+            entries = list(store.search(re.compile("handled"), pids=[103]))
+        assert [e.seq for e in entries] == list(range(48, 64))
+        # The cold blocks only hold PIDs 100-102, so none was opened
+        assert not unpack.called
+
+    def test_incompressible_blocks_stay_hot(self):
+        store = EntryStore(block_entries=2, hot_blocks=1)
+        store.extend(make_entry(i, text=chr(0x41 + i)) for i in range(1, 9))
+        assert store.cold_blocks == 0
+        assert [e.text for e in store] == [chr(0x41 + i) for i in range(1, 9)]
+
+    def test_eviction_and_clear(self):
+        store = self.make_store(count=400, max_bytes=4000)
+        assert store.evicted > 0
+        assert store.cold_blocks == sum(b.packed is not None for b in store._blocks)
+        assert [e.seq for e in store] == list(range(store.first_seq, 401))
+        store.clear()
+        assert store.cold_blocks == 0
+        assert store.cold_ratio is None
+
+    def test_turned_on_later(self):
+        store = EntryStore(block_entries=8)
+        store.extend(make_entry(i) for i in range(1, 41))
+        assert store.cold_blocks == 0
+        store.hot_blocks = 1
+        store.append(make_entry(41))
+        assert store.cold_blocks == 4
+
+
+class TestConcurrentReaders:
+    """Readers take no lock while a single writer appends and evicts."""
+
+    def test_readers_see_consistent_entries(self):
+        self.check_readers(hot_blocks=0)
+
+    def test_readers_with_cold_blocks(self):
+        """Blocks are swapped for compressed copies under the readers."""
+        self.check_readers(hot_blocks=2)
+
+    def check_readers(self, hot_blocks):
+        store = EntryStore(max_bytes=(ENTRY_OVERHEAD + 16) * 400, block_entries=16, index_bytes=4096,
+                           hot_blocks=hot_blocks)
+        total = 20000
+        errors = []
+        done = threading.Event()
+
+        def check(entry):
+            if entry.text != f"entry {entry.seq:08d}" or entry.pid != entry.seq % 7 or entry.time != 1000 + entry.seq:
+                errors.append(entry)
+
+        def write():
+            for i in range(1, total + 1):
+                store.append(make_entry(i, text=f"entry {i:08d}", pid=i % 7))
+            done.set()
+
+        def scan():
+            while not done.is_set():
+                head = store.last_seq
+                seqs = []
+                for entry in store.iter_from(None, head):
+                    check(entry)
+                    seqs.append(entry.seq)
+                if seqs != sorted(set(seqs)) or (seqs and seqs[-1] > head):
+                    errors.append(("iter", seqs[:3], head))
+                for entry in store.query(pids=[3]):
+                    check(entry)
+                    if entry.pid != 3:
+                        errors.append(entry)
+                for entry in store.search(re.compile(r"entry 000\d{2}50")):
+                    check(entry)
+                if head is not None:
+                    # None only once the writer has evicted it
+                    entry = store.get(head)
+                    if entry is None:
+                        if store.first_seq <= head:
+                            errors.append(("get", head))
+                    elif entry.seq != head:
+                        errors.append(("get", head))
+                    else:
+                        check(entry)
+
+        interval = sys.getswitchinterval()
+        sys.setswitchinterval(1e-6)
+        try:
+            readers = [threading.Thread(target=scan) for _ in range(3)]
+            writer = threading.Thread(target=write)
+            for t in readers + [writer]:
+                t.start()
+            for t in readers + [writer]:
+                t.join()
+        finally:
+            sys.setswitchinterval(interval)
+
+        assert not errors, errors[:5]
+        assert store.last_seq == total
+        assert store.evicted > 0
+        assert (store.cold_blocks > 0) == (hot_blocks > 0)
+
+    def test_get_evicted_returns_none(self):
+        """An evicted seq is detected by validation, not an exception."""
+        store = EntryStore(max_bytes=(ENTRY_OVERHEAD + 7) * 8, block_entries=4)
+        store.extend(make_entry(i) for i in range(1, 41))
+        assert store.get(1) is None
+        assert store.get(40).seq == 40
@@ -0,0 +1,241 @@
+"""
+Unit tests for FilterPool and pooled session filtering in CaptureManager.
+"""
+
+import threading
+import time
+from unittest.mock import MagicMock, patch
+
+import pytest
+
+from dbgcapture_mcp.capture_manager import CaptureManager, DebugEntry, FilterSet
+from dbgcapture_mcp.filter_pool import FilterPool
+
+
+def make_entries(first_seq, count, pid=100, text="line {seq}"):
+    return [
+        DebugEntry(seq=seq, time=seq, pid=pid, text=text.format(seq=seq), process_name="app.exe")
+        for seq in range(first_seq, first_seq + count)
+    ]
+
+
+class Target:
+    generation = 0
+    handoff = -1
+
+
+class TestFilterPool:
+    """Tests for FilterPool on its own."""
+
+    @pytest.fixture
+    def pool(self):
+        self.results = []
+        self.arrived = threading.Event()
+        self.failures = 0
+
+        def on_matches(session_id, generation, last_seq, seqs, evaluated, ns):
+            self.results.append((session_id, generation, last_seq, list(seqs), evaluated))
+            self.arrived.set()
+
+        def on_failure():
+            self.failures += 1
+
+        pool = FilterPool(2, on_matches, on_failure)
+        yield pool
+        pool.close()
+
+    def wait_for(self, count, timeout=10):
+        deadline = time.monotonic() + timeout
+        while len(self.results) < count and time.monotonic() < deadline:
+            self.arrived.wait(0.05)
+            self.arrived.clear()
+        return self.results
+
+    def test_sessions_evaluated_per_batch(self, pool):
+        a, b = Target(), Target()
+        pool.set_filters("a", FilterSet.compile(include=[r"[02468]$"]).spec(), a)
+        pool.set_filters("b", FilterSet.compile(process_pids=[200]).spec(), b)
+        assert a.handoff == b.handoff == -1
+        assert a.generation != b.generation
+
+        pool.feed(make_entries(1, 10))
+        results = {r[0]: r for r in self.wait_for(2)}
+
+        assert results["a"] == ("a", a.generation, 10, [2, 4, 6, 8, 10], 10)
+        assert results["b"] == ("b", b.generation, 10, [], 10)
+
+    def test_sessions_sharded(self, pool):
+        for name in "abcd":
+            pool.set_filters(name, FilterSet().spec(), Target())
+        assert sorted(pool._loads) == [2, 2]
+
+        pool.remove("a")
+        pool.remove("b")
+        assert sum(pool._loads) == 2
+
+    def test_handoff_is_last_fed(self, pool):
+        pool.feed(make_entries(1, 5))  # No sessions yet
+        target = Target()
+        pool.set_filters("a", FilterSet().spec(), target)
+        assert target.handoff == 5
+
+        pool.feed(make_entries(6, 3))
+        assert self.wait_for(1)[0][2:4] == (8, [6, 7, 8])
+        assert pool.batches == 1
+        assert pool.entries == 3
+
+    def test_ansi_text_decoded_in_worker(self, pool):
+        target = Target()
+        pool.set_filters("a", FilterSet.compile(include=["café"]).spec(), target)
+        pool.feed([
+            DebugEntry(seq=1, time=1, pid=1, raw="café".encode("cp1252"), codepage=0),
+            DebugEntry(seq=2, time=2, pid=1, raw=b"cafe", codepage=0),
+        ])
+        assert self.wait_for(1)[0][3] == [1]
+
+    def test_worker_exit_reported(self, pool):
+        pool.set_filters("a", FilterSet().spec(), Target())
+        for process in pool._processes:
+            process.terminate()
+            process.join()
+
+        deadline = time.monotonic() + 10
+        while not pool.failed and time.monotonic() < deadline:
+            time.sleep(0.01)
+        assert pool.failed
+        assert self.failures == 1
+        pool.feed(make_entries(1, 1))  # Ignored from now on
+
+
+class TestPooledSessions:
+    """Tests for CaptureManager with filter_workers."""
+
+    @pytest.fixture
+    def manager(self):
+        CaptureManager._instance = None
+
+        with patch('dbgcapture_mcp.capture_manager.subprocess') as mock_subprocess:
+            mock_process = MagicMock()
+            mock_process.poll.return_value = None
+            mock_process.stdout.readline.return_value = ""
+            mock_subprocess.Popen.return_value = mock_process
+            mock_subprocess.CREATE_NO_WINDOW = 0
+
+            manager = CaptureManager()
+            manager._capture_exe = MagicMock()
+            manager._capture_exe.exists.return_value = True
+            manager._running = True
+            manager.configure(filter_workers=2)
+
+            yield manager
+
+            manager.configure(filter_workers=0)
+            manager._running = False
+            CaptureManager._instance = None
+
+    def read_all(self, manager, session_id, expected):
+        """get_output until expected entries arrive or it stops returning any."""
+        seen = []
+        while len(seen) < expected:
+            entries, _ = manager.get_output(session_id, limit=1000, wait_ms=5000)
+            if not entries:
+                break
+            seen.extend(entry["seq"] for entry in entries)
+        return seen
+
+    def test_sessions_pooled(self, manager):
+        even = manager.create_session("even")
+        manager.set_filters(even, include=[r"[02468]$"])
+        other = manager.create_session("pid")
+        manager.set_filters(other, process_pids=[200])
+
+        manager._ingest(make_entries(1, 50))
+        manager._ingest(make_entries(51, 50, pid=200))
+
+        assert self.read_all(manager, even, 50) == list(range(2, 101, 2))
+        assert self.read_all(manager, other, 50) == list(range(51, 101))
+
+        stats = manager.get_capture_stats()
+        assert stats["filter_pool"]["workers"] == 2
+        assert stats["filter_pool"]["entries"] == 100
+        assert all(s["pooled"] for s in stats["sessions"])
+        assert all(s["evaluated"] == 100 for s in stats["sessions"])
+
+    def test_filter_change_mid_stream(self, manager):
+        session_id = manager.create_session("test")
+        manager._ingest(make_entries(1, 20))
+        # Entries already fed are evaluated in-process, later ones by a worker
+        manager.set_filters(session_id, include=[r"5$"])
+        manager._ingest(make_entries(21, 20))
+
+        entries, _ = manager.get_output(session_id, limit=100, since_seq=0)
+        seen = [entry["seq"] for entry in entries]
+        if len(seen) < 4:
+            seen += self.read_all(manager, session_id, 4 - len(seen))
+        assert seen == [5, 15, 25, 35]
+
+    def test_status_counts_pooled_matches(self, manager):
+        session_id = manager.create_session("test")
+        manager.set_filters(session_id, include=["keep"])
+        manager._ingest(make_entries(1, 10, text="keep {seq}") + make_entries(11, 10, text="drop {seq}"))
+
+        assert manager.wait_for_output(session_id, 5000)
+        deadline = time.monotonic() + 10
+        while (manager.get_session_status(session_id)["pending_count"] < 10
+               and time.monotonic() < deadline):
+            time.sleep(0.01)
+        assert manager.get_session_status(session_id)["pending_count"] == 10
+
+    def test_destroyed_session_leaves_pool(self, manager):
+        keep = manager.create_session("keep")
+        gone = manager.create_session("gone")
+        manager.destroy_session(gone)
+        assert sum(manager._pool._loads) == 1
+
+        manager._ingest(make_entries(1, 5))
+        assert self.read_all(manager, keep, 5) == [1, 2, 3, 4, 5]
+
+    def test_last_session_leaves_pool(self, manager):
+        """Destroying the last session unshards it and wakes its waiters, even while lingering."""
+        manager.configure(linger_ms=60000)
+        session_id = manager.create_session("only")
+        assert sum(manager._pool._loads) == 1
+        
+        waiter = threading.Thread(target=manager.get_output, args=(session_id, 10, None, 10000))
+        waiter.start()
+        time.sleep(0.1)
+        started = time.monotonic()
+        manager.destroy_session(session_id)
+        waiter.join(5)
+        
+        assert not waiter.is_alive()
+        assert time.monotonic() - started < 5
+        assert sum(manager._pool._loads) == 0
+        assert manager._running  # Still lingering
+        manager._linger_timer.cancel()
+    
+    def test_worker_exit_falls_back(self, manager):
+        session_id = manager.create_session("test")
+        manager.set_filters(session_id, include=[r"[02468]$"])
+        for process in manager._pool._processes:
+            process.terminate()
+            process.join()
+        deadline = time.monotonic() + 10
+        while manager._pool is not None and time.monotonic() < deadline:
+            time.sleep(0.01)
+        assert manager._pool is None
+
+        manager._ingest(make_entries(1, 10))
+        entries, _ = manager.get_output(session_id, limit=100)
+        assert [entry["seq"] for entry in entries] == [2, 4, 6, 8, 10]
+        assert manager.get_session_status(session_id)["capture"]["last_error"]
+
+    def test_pool_turned_off(self, manager):
+        session_id = manager.create_session("test")
+        manager.set_filters(session_id, include=["b"])
+        manager.configure(filter_workers=0)
+
+        manager._ingest(make_entries(1, 3, text="a") + make_entries(4, 3, text="b"))
+        entries, _ = manager.get_output(session_id, limit=100)
+        assert [entry["seq"] for entry in entries] == [4, 5, 6]
+        assert manager.get_capture_stats()["filter_pool"] is None
@@ -0,0 +1,85 @@
+"""
+Unit tests for the lock timers and native stats aggregation.
+"""
+
+import threading
+import time
+
+from dbgcapture_mcp.instrumentation import NativeStats, TimedLock
+
+
+class TestTimedLock:
+    """TimedLock counts acquisitions and accumulates wait and hold time."""
+
+    def test_counts_holds(self):
+        lock = TimedLock()
+        for _ in range(3):
+            with lock:
+                time.sleep(0.002)
+        stats = lock.snapshot()
+        assert stats["acquisitions"] == 3
+        assert stats["hold_ms"] >= 6
+        assert stats["hold_max_us"] >= 2000
+        assert not lock.locked()
+
+    def test_counts_waits(self):
+        lock = TimedLock()
+        lock.acquire()
+        waiter = threading.Thread(target=lambda: (lock.acquire(), lock.release()))
+        waiter.start()
+        time.sleep(0.02)
+        lock.release()
+        waiter.join()
+        assert lock.snapshot()["wait_ms"] >= 10
+
+    def test_failed_acquire_not_counted(self):
+        lock = TimedLock()
+        lock.acquire()
+        assert not lock.acquire(blocking=False)
+        lock.release()
+        assert lock.snapshot()["acquisitions"] == 1
+
+    def test_works_under_condition(self):
+        lock = TimedLock()
+        changed = threading.Condition(lock)
+        woke = []
+
+        def wait():
+            with lock:
+                woke.append(changed.wait(5))
+        waiter = threading.Thread(target=wait)
+        waiter.start()
+        time.sleep(0.02)
+        with lock:
+            changed.notify_all()
+        waiter.join()
+        assert woke == [True]
+
+
+class TestNativeStats:
+    """NativeStats derives rates and averages from dbgcapture.exe records."""
+
+    def test_empty(self):
+        stats = NativeStats()
+        assert stats.snapshot() == {}
+        assert stats.get("dropped") == 0
+
+    def test_averages_without_rates(self):
+        stats = NativeStats()
+        stats.update({"uptime_ms": 1000, "captured": 14, "handoffs": 10, "handoff_us": 50,
+                      "format_us": 20, "formatted": 10, "writes": 0, "write_us": 0})
+        snap = stats.snapshot()
+        assert snap["handoff_avg_us"] == 5
+        assert snap["format_avg_us"] == 2
+        assert snap["write_avg_us"] is None
+        assert "messages_per_sec" not in snap
+
+    def test_rates_over_last_interval(self):
+        stats = NativeStats()
+        stats.update({"uptime_ms": 1000, "captured": 100, "bytes": 4000, "dropped": 0})
+        stats.update({"uptime_ms": 1500, "captured": 600, "bytes": 24000, "dropped": 5})
+        snap = stats.snapshot()
+        assert snap["messages_per_sec"] == 1000
+        assert snap["bytes_per_sec"] == 40000
+        assert snap["dropped_per_sec"] == 10
+        assert stats.get("captured") == 600
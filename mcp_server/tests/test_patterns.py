@@ -0,0 +1,119 @@
+"""
+Unit tests for the combined pattern matcher.
+"""
+
+import re
+
+from dbgcapture_mcp.patterns import PatternMatcher, literal_of, literals_of, required_literals
+
+
+def compile_all(patterns, flags=re.IGNORECASE):
+    return [re.compile(p, flags) for p in patterns]
+
+
+class TestLiteralOf:
+    """Tests for recognizing plain-substring patterns."""
+
+    def test_plain_keyword(self):
+        assert literal_of("timeout") == "timeout"
+
+    def test_escaped_punctuation(self):
+        assert literal_of(r"\[ERROR\]") == "[ERROR]"
+        assert literal_of(r"C:\\Windows") == "C:\\Windows"
+
+    def test_regex_syntax_is_not_literal(self):
+        for pattern in [r"ERR\d+", "^start", "a|b", "x.y", r"\bword", "(group)", "trailing\\"]:
+            assert literal_of(pattern) is None
+
+    def test_non_ascii_is_not_literal(self):
+        assert literal_of("größe") is None
+
+    def test_literals_of_requires_all(self):
+        assert literals_of(compile_all(["a", "b"])) == ["a", "b"]
+        assert literals_of(compile_all(["a", "b+"])) is None
+
+
+class TestRequiredLiterals:
+    """Tests for extracting the text every match must contain."""
+
+    def required(self, pattern):
+        return required_literals(re.compile(pattern, re.IGNORECASE))
+
+    def test_plain_keyword(self):
+        assert self.required(r"\[ERROR\] disk") == ["[ERROR] disk"]
+
+    def test_runs_split_at_syntax(self):
+        assert self.required(r"ERR\d+ failed") == ["ERR", " failed"]
+        assert self.required(r"abc.def[0-9]ghi(jk|lm)nopq") == ["abc", "def", "ghi", "nopq"]
+
+    def test_optional_characters_dropped(self):
+        assert self.required("timeouts?") == ["timeout"]
+        assert self.required("abcx*") == ["abc"]
+        assert self.required("ab{2,3}cdef") == ["cdef"]
+        assert self.required("abcd+") == ["abcd"]
+
+    def test_top_level_alternation_yields_nothing(self):
+        assert self.required("timeout|deadlock") == []
+
+    def test_verbose_yields_nothing(self):
+        assert self.required("(?x) dead lock") == []
+
+    def test_every_match_contains_them(self):
+        texts = TestPatternMatcher.TEXTS
+        for pattern in [r"Connection timeout", r"ERR\d+", r"disk (almost )?full", r"worker \d"]:
+            regex = re.compile(pattern, re.IGNORECASE)
+            for text in texts:
+                if regex.search(text):
+                    for literal in required_literals(regex):
+                        assert literal.lower() in text.lower()
+
+
+class TestPatternMatcher:
+    """PatternMatcher must agree with searching each pattern in turn."""
+
+    TEXTS = [
+        "[ERROR] Connection timeout after 30s",
+        "[INFO] all good",
+        "Straße closed: ERR42",
+        "WARNING: disk almost full",
+        "deadlock detected in worker 7",
+        "",
+    ]
+
+    def check(self, patterns):
+        matcher = PatternMatcher(patterns)
+        for text in self.TEXTS:
+            expected = any(p.search(text) for p in patterns)
+            assert matcher.search(text) is expected, (text, [p.pattern for p in patterns])
+
+    def test_empty(self):
+        matcher = PatternMatcher([])
+        assert not matcher
+        assert matcher.search("anything") is False
+
+    def test_keywords(self):
+        self.check(compile_all(["error", "warn", "deadlock", "dead", "nothing-here"]))
+
+    def test_regexes(self):
+        self.check(compile_all([r"ERR\d+", r"^\[INFO\]", r"full$"]))
+
+    def test_mixed(self):
+        self.check(compile_all(["timeout", r"ERR\d+", "straße"]))
+
+    def test_case_sensitive_pattern(self):
+        self.check(compile_all(["error", "warning"], flags=0))
+
+    def test_non_ascii_text(self):
+        # Kelvin sign folds to 'k' only under real case folding
+        matcher = PatternMatcher(compile_all(["kelvin"]))
+        assert matcher.search("\u212aelvin") is True
+
+    def test_backreferences_kept_separate(self):
+        self.check(compile_all([r"(\w)\1", r"(a)(b)\2", "xyz"]))
+
+    def test_inline_flags_fall_back(self):
+        self.check(compile_all(["(?s)dead.lock", "(?x) ERR 4 2", "nothing"]))
+
+    def test_many_keywords(self):
+        words = [f"keyword{i}" for i in range(50)] + ["timeout"]
+        self.check(compile_all(words))
@@ -0,0 +1,134 @@
+"""
+Unit tests for the binary framing protocol.
+"""
+
+from dbgcapture_mcp.protocol import (
+    ANSI_ENCODING,
+    CP_ACP,
+    CP_UTF8,
+    FRAME_FLAG_MONO,
+    FRAME_FLAG_NAME,
+    FRAME_FLAG_REPEAT,
+    FRAME_FLAG_UTF8,
+    FRAME_HEADER_SIZE,
+    Frame,
+    FrameDecoder,
+    decode_text,
+    encode_frame,
+    frame_codepage,
+    frame_repeat,
+    split_payload,
+)
+
+
+class TestFrameDecoder:
+    """Tests for FrameDecoder."""
+
+    def test_header_size(self):
+        """Header is seq u64, time u64, pid u32, len u32."""
+        assert FRAME_HEADER_SIZE == 24
+
+    def test_decode_single_frame(self):
+        """A complete frame decodes to its fields."""
+        decoder = FrameDecoder()
+        frames = decoder.feed(encode_frame(7, 132500000000000000, 1234, b"Hello"))
+        assert frames == [Frame(7, 132500000000000000, 1234, 0, b"Hello")]
+
+    def test_decode_many_frames_in_one_chunk(self):
+        """All frames in a chunk are returned at once."""
+        decoder = FrameDecoder()
+        chunk = b"".join(encode_frame(i, 0, 42, f"Message {i}".encode()) for i in range(100))
+        frames = decoder.feed(chunk)
+        assert [f.seq for f in frames] == list(range(100))
+        assert frames[99].payload == b"Message 99"
+
+    def test_partial_frames_carry_over(self):
+        """Frames split across reads are reassembled."""
+        decoder = FrameDecoder()
+        data = encode_frame(1, 0, 1, b"first") + encode_frame(2, 0, 2, b"second")
+        
+        decoded = []
+        for i in range(len(data)):
+            decoded.extend(decoder.feed(data[i:i + 1]))
+        
+        assert [f.payload for f in decoded] == [b"first", b"second"]
+
+    def test_empty_payload(self):
+        """A zero-length payload is a valid frame."""
+        decoder = FrameDecoder()
+        frames = decoder.feed(encode_frame(3, 0, 1, b""))
+        assert frames[0].payload == b""
+
+    def test_flags_are_masked_from_length(self):
+        """The top byte of len carries flags, not length."""
+        decoder = FrameDecoder()
+        frames = decoder.feed(encode_frame(1, 0, 1, b"abc", flags=0x81) + encode_frame(2, 0, 1, b"d"))
+        assert frames[0].flags == 0x81
+        assert frames[0].payload == b"abc"
+        assert frames[1].payload == b"d"
+
+    def test_raw_bytes_preserved(self):
+        """Control and high bytes pass through untouched."""
+        decoder = FrameDecoder()
+        payload = bytes(range(1, 256))
+        frames = decoder.feed(encode_frame(1, 0, 1, payload))
+        assert frames[0].payload == payload
+
+    def test_process_name(self):
+        """A name-flagged payload splits into name and text."""
+        decoder = FrameDecoder()
+        frame = decoder.feed(encode_frame(1, 0, 42, b"Hello", name=b"app.exe"))[0]
+        assert frame.flags & FRAME_FLAG_NAME
+        assert split_payload(frame) == (None, b"app.exe", b"Hello")
+
+    def test_no_process_name(self):
+        """Frames without the name flag are all text."""
+        frame = FrameDecoder().feed(encode_frame(1, 0, 42, b"\x05Hello"))[0]
+        assert split_payload(frame) == (None, None, b"\x05Hello")
+
+    def test_mono_and_name(self):
+        """The monotonic time comes first, then the name, then the text."""
+        frame = FrameDecoder().feed(encode_frame(1, 0, 42, b"Hello", name=b"app.exe", mono=123456789))[0]
+        assert frame.flags & FRAME_FLAG_MONO and frame.flags & FRAME_FLAG_NAME
+        assert frame.payload[:8] == (123456789).to_bytes(8, "little")
+        assert split_payload(frame) == (123456789, b"app.exe", b"Hello")
+
+    def test_mono_without_name(self):
+        frame = FrameDecoder().feed(encode_frame(1, 0, 42, b"\x01x", mono=0))[0]
+        assert split_payload(frame) == (0, None, b"\x01x")
+        assert frame_repeat(frame) is None
+
+    def test_repeat(self):
+        """Repeat fields sit between the monotonic time and the name."""
+        frame = FrameDecoder().feed(encode_frame(
+            9, 500, 42, b"Spam", name=b"drv.sys", mono=77, repeat=(1000, 100)))[0]
+        assert frame.flags & FRAME_FLAG_REPEAT
+        assert frame.payload[8:20] == (1000).to_bytes(4, "little") + (100).to_bytes(8, "little")
+        assert frame_repeat(frame) == (1000, 100)
+        assert split_payload(frame) == (77, b"drv.sys", b"Spam")
+
+        frame = FrameDecoder().feed(encode_frame(9, 500, 42, b"Spam", repeat=(2, 400)))[0]
+        assert frame_repeat(frame) == (2, 400)
+        assert split_payload(frame) == (None, None, b"Spam")
+
+
+class TestDecodeText:
+    """Raw text decodes according to its code page tag."""
+
+    def test_ascii_ignores_code_page(self):
+        assert decode_text(b"plain", CP_ACP) == "plain"
+        assert decode_text(b"plain", CP_UTF8) == "plain"
+
+    def test_utf8(self):
+        assert decode_text("Grüße ✓".encode("utf-8"), CP_UTF8) == "Grüße ✓"
+
+    def test_ansi(self):
+        text = "Grüße"
+        assert decode_text(text.encode(ANSI_ENCODING), CP_ACP) == text
+
+    def test_explicit_code_page(self):
+        assert decode_text("Привет".encode("cp1251"), 1251) == "Привет"
+
+    def test_frame_flag(self):
+        assert frame_codepage(FRAME_FLAG_UTF8 | FRAME_FLAG_NAME) == CP_UTF8
+        assert frame_codepage(FRAME_FLAG_NAME) == CP_ACP
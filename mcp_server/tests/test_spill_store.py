@@ -0,0 +1,132 @@
+"""
+Unit tests for the memory-mapped spill log.
+"""
+
+import threading
+
+import pytest
+
+from dbgcapture_mcp.entry_store import DebugEntry
+from dbgcapture_mcp.protocol import ANSI_ENCODING, CP_ACP, FRAME_FLAG_UTF8, FrameDecoder
+from dbgcapture_mcp.spill_store import INDEX_INTERVAL, SpillStore
+
+
+def make_entry(seq, text=None, pid=1234, name="test.exe"):
+    return DebugEntry(seq=seq, time=1000 + seq, pid=pid, text=text or f"Message {seq}", process_name=name)
+
+
+def everything(entry):
+    return True
+
+
+@pytest.fixture
+def store(tmp_path):
+    spill = SpillStore(tmp_path, max_bytes=64 * 1024, segment_bytes=16 * 1024)
+    yield spill
+    spill.close()
+
+
+class TestSpillStore:
+    """Tests for SpillStore."""
+
+    def test_round_trip(self, store):
+        """Entries read back with every field intact."""
+        timed = make_entry(3, "Timed")
+        timed.mono = 987654321
+        store.extend([make_entry(1, "Hello"), make_entry(2, "Ünïcode ✓", name=None), timed])
+        entries, scanned_to = store.read(0, everything, 10)
+        assert entries == [make_entry(1, "Hello"), make_entry(2, "Ünïcode ✓", name=None), timed]
+        assert scanned_to == 3
+
+    def test_read_from_middle(self, store):
+        """since_seq seeks through the sparse index across segments."""
+        store.extend([make_entry(i) for i in range(1, INDEX_INTERVAL * 3)])
+        entries, _ = store.read(INDEX_INTERVAL + 5, everything, 3)
+        assert [e.seq for e in entries] == [INDEX_INTERVAL + 6, INDEX_INTERVAL + 7, INDEX_INTERVAL + 8]
+
+    def test_gaps_in_seqs(self, store):
+        """Filtered-out seqs leave gaps that reads step over."""
+        store.extend([make_entry(i) for i in range(0, 2000, 7)])
+        entries, _ = store.read(700, everything, 2)
+        assert [e.seq for e in entries] == [707, 714]
+
+    def test_predicate_and_stop(self, store):
+        """Only matching entries before stop_seq are returned."""
+        store.extend([make_entry(i, "even" if i % 2 == 0 else "odd") for i in range(1, 101)])
+        entries, scanned_to = store.read(0, lambda e: e.text == "even", 100, stop_seq=11)
+        assert [e.seq for e in entries] == [2, 4, 6, 8, 10]
+        assert scanned_to == 10
+
+    def test_scan_budget(self, store):
+        """max_scan bounds the work per call and reports where it stopped."""
+        store.extend([make_entry(i) for i in range(1, 101)])
+        entries, scanned_to = store.read(0, lambda e: False, 10, max_scan=30)
+        assert entries == []
+        assert scanned_to == 30
+
+    def test_retention_by_bytes(self, store):
+        """Oldest segments are deleted once the files exceed max_bytes."""
+        store.extend([make_entry(i, "x" * 200) for i in range(1, 2001)])
+        assert store.nbytes <= 64 * 1024
+        assert len(list(store.directory.glob("*.seg"))) == store.nbytes // (16 * 1024)
+        assert store.first_seq > 1
+        entries, _ = store.read(0, everything, 1)
+        assert entries[0].seq == store.first_seq
+
+    def test_appends_during_read(self, store):
+        """A read doesn't hold up appends, even ones that delete the segment it is in."""
+        store.extend([make_entry(i, "x" * 200) for i in range(1, 51)])
+        first_file = sorted(store.directory.glob("*.seg"))[0]
+        appended = []
+        
+        def predicate(entry):
+            if entry.seq == 1:
+                # Enough to push every segment being read out of max_bytes
+                writer = threading.Thread(
+                    target=store.extend, args=([make_entry(i, "x" * 200) for i in range(51, 1001)],))
+                writer.start()
+                writer.join(5)
+                appended.append(not writer.is_alive())
+            return True
+        
+        entries, scanned_to = store.read(0, predicate, 1000)
+        assert appended == [True]
+        # The scan only covers what was written when it started
+        assert [e.seq for e in entries] == list(range(1, 51))
+        assert entries[0].text == "x" * 200
+        assert scanned_to == 50
+        assert store.first_seq > 50
+        assert not first_file.exists()
+    
+    def test_segments_use_binary_framing(self, store):
+        """Segment files decode with the pipe's FrameDecoder."""
+        store.extend([make_entry(1, "Hello")])
+        data = sorted(store.directory.glob("*.seg"))[0].read_bytes()
+        frame = FrameDecoder().feed(data[:24 + 1 + 8 + 5])[0]
+        assert frame.seq == 1
+        assert frame.flags & FRAME_FLAG_UTF8
+
+    def test_raw_text_kept(self, store):
+        """ANSI text is stored as is and read back with its code page."""
+        raw = "Grüße".encode(ANSI_ENCODING)
+        store.extend([DebugEntry(seq=1, time=0, pid=1, raw=raw, codepage=CP_ACP), make_entry(2, "✓ done")])
+        entries, _ = store.read(0, everything, 10)
+        assert entries[0].raw == raw
+        assert entries[0].codepage == CP_ACP
+        assert [e.text for e in entries] == ["Grüße", "✓ done"]
+
+    def test_repeat_kept(self, store):
+        """Collapsed entries keep their repeat count and first time."""
+        store.extend([DebugEntry(seq=1, time=50, pid=1, text="spam", mono=5, repeat=300, first_time=10),
+                      make_entry(2, "once")])
+        entries, _ = store.read(0, everything, 10)
+        assert (entries[0].repeat, entries[0].first_time, entries[0].mono) == (300, 10, 5)
+        assert entries[0].text == "spam"
+        assert (entries[1].repeat, entries[1].first_time) == (1, None)
+
+    def test_stale_segments_removed(self, tmp_path):
+        """Segments from a previous run are cleared on open."""
+        (tmp_path / "dbgcapture-00000007.seg").write_bytes(b"old")
+        (tmp_path / "keep.txt").write_bytes(b"mine")
+        SpillStore(tmp_path).close()
+        assert [p.name for p in tmp_path.iterdir()] == ["keep.txt"]
@@ -0,0 +1,105 @@
+"""
+Unit tests for session resource subscriptions.
+"""
+
+import asyncio
+import threading
+
+from dbgcapture_mcp.subscriptions import SubscriptionManager, session_id_of, session_uri
+
+
+class FakeManager:
+    """Just enough of CaptureManager for the subscription logic."""
+
+    def __init__(self):
+        self.sessions = {"abc": True}
+        self.pending = []
+        self.changed = threading.Condition()
+
+    def get_session(self, session_id):
+        return self.sessions.get(session_id)
+
+    def is_running(self):
+        return True
+
+    def add(self, text):
+        with self.changed:
+            self.pending.append(text)
+            self.changed.notify_all()
+
+    def wait_for_output(self, session_id, wait_ms):
+        if session_id not in self.sessions:
+            return None
+        with self.changed:
+            self.changed.wait_for(lambda: self.pending, timeout=wait_ms / 1000)
+            return bool(self.pending)
+
+    def get_output(self, session_id, limit=100, since_seq=None):
+        with self.changed:
+            batch, self.pending = self.pending[:limit], self.pending[limit:]
+        return [{"text": t} for t in batch], 0
+
+
+def test_session_uri_round_trip():
+    assert session_id_of(session_uri("abc")) == "abc"
+    assert session_id_of("file:///etc/passwd") is None
+    assert session_id_of("dbgcapture://sessions/") is None
+
+
+def test_unknown_session_rejected():
+    async def run():
+        subs = SubscriptionManager(FakeManager())
+        assert subs.subscribe(session_uri("nope"), None) is False
+        assert subs.read(session_uri("nope")) is None
+    asyncio.run(run())
+
+
+def test_one_notification_until_read():
+    """A burst of output yields a single notification until the client reads."""
+    manager = FakeManager()
+    sent = []
+
+    async def send(uri):
+        sent.append(uri)
+
+    async def run():
+        subs = SubscriptionManager(manager, poll_ms=50)
+        uri = session_uri("abc")
+        assert subs.subscribe(uri, send)
+
+        for i in range(10):
+            manager.add(f"line {i}")
+        await asyncio.sleep(0.3)
+        assert sent == [uri]
+
+        # More output while unread doesn't notify again
+        manager.add("line 10")
+        await asyncio.sleep(0.2)
+        assert sent == [uri]
+
+        batch = subs.read(uri)
+        assert batch["count"] == 11
+        assert sent == [uri]
+
+        manager.add("after read")
+        await asyncio.sleep(0.3)
+        assert sent == [uri, uri]
+
+        subs.unsubscribe(uri)
+        await asyncio.sleep(0.1)
+
+    asyncio.run(run())
+
+
+def test_destroyed_session_ends_watch():
+    manager = FakeManager()
+
+    async def run():
+        subs = SubscriptionManager(manager, poll_ms=50)
+        uri = session_uri("abc")
+        subs.subscribe(uri, lambda u: asyncio.sleep(0))
+        del manager.sessions["abc"]
+        await asyncio.sleep(0.2)
+        assert uri not in subs._subscriptions
+
+    asyncio.run(run())
@@ -0,0 +1,159 @@
+"""
+Unit tests for message templates and buffer summaries.
+"""
+
+from array import array
+
+import pytest
+
+from dbgcapture_mcp.entry_store import ENTRY_OVERHEAD, DebugEntry, EntryStore
+from dbgcapture_mcp.protocol import ANSI_ENCODING, CP_ACP
+from dbgcapture_mcp.summary import TICKS_PER_SEC, Summary, TemplateIndex, template_of
+
+
+def make_entry(seq, text, pid=1234, name="test.exe", time=None):
+    return DebugEntry(seq=seq, time=seq * TICKS_PER_SEC if time is None else time,
+                      pid=pid, text=text, process_name=name)
+
+
+class TestTemplateOf:
+    """Tests for template_of."""
+
+    def test_numbers(self):
+        assert template_of(b"retry 3 of 5 after 250ms") == b"retry <n> of <n> after <n>ms"
+        assert template_of(b"version 10.0.19045 from 192.168.1.20") == b"version <n> from <n>"
+
+    def test_hex(self):
+        assert template_of(b"handle 0x1F4 at 00007FF6A1B2C3D4") == b"handle <hex> at <hex>"
+        # Words made of hex letters stay
+        assert template_of(b"added cafe feed") == b"added cafe feed"
+
+    def test_guid(self):
+        text = b"device {6B29FC40-CA47-1067-B31D-00DD010662DA} ready"
+        assert template_of(text) == b"device {<guid>} ready"
+
+    def test_whitespace_and_length(self):
+        assert template_of(b"  two   spaces\r\n") == b"two spaces"
+        assert len(template_of(b"x" * 1000)) == 160
+
+
+class TestSummary:
+    """Tests for Summary accumulation."""
+
+    def test_group_by_rejected(self):
+        with pytest.raises(ValueError):
+            Summary("thread")
+
+    def test_rates_over_requested_window(self):
+        store = EntryStore()
+        store.extend(make_entry(i, "tick") for i in range(1, 11))
+        result = store.summarize(start_time=0, end_time=20 * TICKS_PER_SEC)
+        assert result["seconds"] == 20
+        assert result["per_sec"] == 0.5
+
+
+class TestEntryStoreSummarize:
+    """Tests for EntryStore.summarize."""
+
+    def make_store(self):
+        store = EntryStore(block_entries=4)
+        entries = []
+        for i in range(1, 31):
+            if i % 3 == 0:
+                entries.append(make_entry(i, f"error {i}: code 0x{i:x}", pid=7, name="svc.exe"))
+            else:
+                entries.append(make_entry(i, f"tick {i}", pid=8, name="app.exe"))
+        store.extend(entries)
+        return store
+
+    def test_groups_and_templates(self):
+        result = self.make_store().summarize()
+
+        assert result["entries"] == 30
+        assert result["distinct_templates"] == 2
+        assert result["templates"][0] == {"template": "tick <n>", "count": 20,
+                                          "per_sec": round(20 / 29, 3), "example_seq": 29}
+        assert result["templates"][1]["template"] == "error <n>: code <hex>"
+        assert [(g["pid"], g["process_name"], g["count"]) for g in result["groups"]] == [
+            (8, "app.exe", 20), (7, "svc.exe", 10)]
+        assert result["groups"][1]["first_seq"] == 3
+        assert result["groups"][1]["last_seq"] == 30
+        assert result["peak_per_sec"] == 1
+
+    def test_selection(self):
+        store = self.make_store()
+        assert store.summarize(pids=[7])["entries"] == 10
+        assert store.summarize(start_time=5 * TICKS_PER_SEC, end_time=9 * TICKS_PER_SEC)["entries"] == 5
+        result = store.summarize(seqs=array("Q", [3, 4, 6, 99]), pids=[7])
+        assert result["entries"] == 2
+
+    def test_group_by_name_and_none(self):
+        store = EntryStore()
+        store.extend([make_entry(1, "a", pid=1, name="x.exe"), make_entry(2, "a", pid=2, name="x.exe")])
+        result = store.summarize(group_by="name")
+        assert result["groups"] == [{"process_name": "x.exe", "count": 2, "per_sec": 2.0,
+                                     "first_seq": 1, "last_seq": 2}]
+        assert "groups" not in store.summarize(group_by="none")
+
+    def test_top(self):
+        store = EntryStore()
+        store.extend(make_entry(i, f"message{'s' * i}") for i in range(1, 21))
+        result = store.summarize(top=3)
+        assert len(result["templates"]) == 3
+        assert result["distinct_templates"] == 20
+
+    def test_templates_computed_once(self):
+        store = self.make_store()
+        store.summarize()
+        cached = dict(store._templates._blocks)
+        store.append(make_entry(31, "tick 31", pid=8))
+        result = store.summarize()
+
+        assert result["entries"] == 31
+        # Earlier blocks kept their ids; only the new entry was added
+        for ordinal, ids in cached.items():
+            assert store._templates._blocks[ordinal] is ids
+        assert sum(len(ids) for ids in store._templates._blocks.values()) == 31
+
+    def test_evicted_blocks_pruned(self):
+        store = EntryStore(max_bytes=(ENTRY_OVERHEAD + 8) * 12, block_entries=4)
+        store.extend(make_entry(i, "ticktock") for i in range(1, 9))
+        store.summarize()
+        store.extend(make_entry(i, "ticktock") for i in range(9, 41))
+        result = store.summarize()
+
+        assert result["entries"] == len(store)
+        assert min(store._templates._blocks) == store._blocks[0].ordinal
+
+    def test_ansi_template(self):
+        store = EntryStore()
+        store.append(DebugEntry(seq=1, time=1, pid=1, raw="café 12".encode(ANSI_ENCODING), codepage=CP_ACP))
+        assert store.summarize()["templates"][0]["template"] == "café <n>"
+
+    def test_too_many_templates_start_over(self):
+        templates = TemplateIndex(max_templates=5)
+        store = EntryStore()
+        store._templates = templates
+        store.extend(make_entry(i, f"unique{'x' * i}") for i in range(1, 11))
+        assert store.summarize()["distinct_templates"] == 10
+        assert store.summarize()["distinct_templates"] == 10
+        assert len(templates) == 10
+
+    def test_collapsed_entries_weighted(self):
+        store = EntryStore()
+        store.extend([make_entry(1, "spam 1", pid=4),
+                      DebugEntry(seq=2, time=2 * TICKS_PER_SEC, pid=4, text="spam 1", repeat=99,
+                                 first_time=TICKS_PER_SEC),
+                      make_entry(3, "other", pid=8)])
+        result = store.summarize()
+        assert result["entries"] == 101
+        assert result["templates"][0]["count"] == 100
+        assert result["groups"][0] == {"pid": 4, "process_name": "test.exe", "count": 100,
+                                       "per_sec": 50.0, "first_seq": 1, "last_seq": 2}
+
+    def test_empty(self):
+        result = EntryStore().summarize()
+        assert result["entries"] == 0
+        assert result["per_sec"] is None
+        assert result["templates"] == []
+        assert result["groups"] == []
@@ -0,0 +1,65 @@
+"""
+Unit tests for the trigram text index.
+"""
+
+import re
+
+from dbgcapture_mcp.text_index import TextIndex, fold, required_trigrams, trigrams
+
+
+class TestFolding:
+    """Folded text must keep every trigram an IGNORECASE match relies on."""
+
+    def test_ascii_lowercased(self):
+        assert fold(b"Disk FULL") == b"disk full"
+
+    def test_ignorecase_variants_fold_to_ascii(self):
+        # Long s, dotless i and the Kelvin sign all match ASCII letters under re.IGNORECASE
+        text = "ſystem dısk Kernel".encode("utf-8")
+        assert trigrams(b"system disk kernel") <= trigrams(fold(text))
+
+    def test_required_trigrams(self):
+        grams = required_trigrams(re.compile(r"Disk\d+ full", re.IGNORECASE))
+        assert grams == trigrams(b"disk") | trigrams(b" full")
+        assert required_trigrams(re.compile("disk|full")) == set()
+        # Non-ASCII characters split runs
+        assert required_trigrams(re.compile("größe")) == set()
+
+
+class TestTextIndex:
+    """Tests for TextIndex."""
+
+    def test_candidates(self):
+        index = TextIndex()
+        index.add(0, b"connection timeout")
+        index.add(1, b"deadlock detected")
+        index.add(2, b"TIMEOUT again")
+        assert index.candidates(trigrams(b"timeout")) == {0, 2}
+        assert index.candidates(trigrams(b"timeout") | trigrams(b"again")) == {2}
+        assert index.candidates(trigrams(b"missing")) == set()
+        assert index.candidates(set()) is None
+
+    def test_drop_before(self):
+        index = TextIndex()
+        for chunk in range(10):
+            index.add(chunk, b"same text")
+        index.drop_before(7)
+        assert index.first_chunk == 7
+        assert index.candidates(trigrams(b"same")) == {7, 8, 9}
+        assert not index.covers(6)
+        assert index.covers(9)
+
+    def test_cap_drops_oldest(self):
+        index = TextIndex(max_bytes=5000)
+        for chunk in range(100):
+            index.add(chunk, f"entry {chunk:05d}".encode())
+        assert index.nbytes <= 5000
+        assert index.first_chunk > 0
+        assert index.end_chunk == 100
+        assert index.candidates(trigrams(b"00099")) == {99}
+
+    def test_disabled(self):
+        index = TextIndex(max_bytes=0)
+        index.add(0, b"anything")
+        assert not index.covers(0)
+        assert index.nbytes == 0